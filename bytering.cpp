@@ -0,0 +1,55 @@
+#include "bytering.h"
+#include <cstring>
+
+ByteRing::ByteRing(int capacityBits)
+    : buffer(new char[size_t(1) << capacityBits])
+    , mask((size_t(1) << capacityBits) - 1)
+    , head(0)
+    , tail(0)
+{
+}
+
+qsizetype ByteRing::size() const
+{
+    return static_cast<qsizetype>(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+}
+
+qsizetype ByteRing::write(const char *data, qsizetype size)
+{
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t t = tail.load(std::memory_order_acquire);
+    const size_t free = (mask + 1) - (h - t);
+    const size_t n = qMin(free, static_cast<size_t>(size));
+    if (n == 0) return 0;
+
+    const size_t offset = h & mask;
+    const size_t first = qMin(n, (mask + 1) - offset);
+    std::memcpy(buffer.get() + offset, data, first);
+    std::memcpy(buffer.get(), data + first, n - first);
+
+    // Publish the bytes before the index
+    head.store(h + n, std::memory_order_release);
+    return static_cast<qsizetype>(n);
+}
+
+qsizetype ByteRing::read(char *data, qsizetype maxSize)
+{
+    const size_t t = tail.load(std::memory_order_relaxed);
+    const size_t h = head.load(std::memory_order_acquire);
+    const size_t n = qMin(h - t, static_cast<size_t>(maxSize));
+    if (n == 0) return 0;
+
+    const size_t offset = t & mask;
+    const size_t first = qMin(n, (mask + 1) - offset);
+    std::memcpy(data, buffer.get() + offset, first);
+    std::memcpy(data + first, buffer.get(), n - first);
+
+    tail.store(t + n, std::memory_order_release);
+    return static_cast<qsizetype>(n);
+}
+
+void ByteRing::clear()
+{
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,36 @@
+#ifndef BYTERING_H
+#define BYTERING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+// Byte queue between exactly one producer thread and one consumer thread,
+// without locks: the producer only moves `head`, the consumer only moves
+// `tail`. Both indexes grow forever and are masked into a power-of-two buffer.
+class ByteRing
+{
+public:
+    explicit ByteRing(int capacityBits = 22);
+
+    qsizetype capacity() const { return static_cast<qsizetype>(mask + 1); }
+    qsizetype size() const;
+    bool isEmpty() const { return size() == 0; }
+
+    // Producer side: copies what fits, returns the number of bytes queued
+    qsizetype write(const char *data, qsizetype size);
+    // Consumer side: copies at most maxSize bytes out, returns the number read
+    qsizetype read(char *data, qsizetype maxSize);
+
+    // Only while neither side is running
+    void clear();
+
+private:
+    std::unique_ptr<char[]> buffer;
+    size_t mask;
+    // Separate cache lines: each side writes its own index
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif // BYTERING_H
@@ -0,0 +1,356 @@
+#include "chatbackend.h"
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QDebug>
+
+static const char *GeminiModel = "gemini-2.0-flash-001";
+// llama.cpp's server; Ollama is at http://localhost:11434/v1
+static const char *DefaultOpenAiBaseUrl = "http://localhost:8080/v1";
+// Mock answers: size, and pace of the stream (ms)
+static const int MockParagraphs = 4;
+static const int MockParagraphWords = 60;
+static const int MockChunkWords = 4;
+static const int MockFirstTokenDelay = 200;
+static const int MockChunkInterval = 20;
+
+double ChatBackendMetrics::tokensPerSecond() const
+{
+    const qint64 generationMs = totalMs - firstTokenMs;
+    if (firstTokenMs < 0 || generationMs <= 0) return 0.0;
+    return tokens * 1000.0 / generationMs;
+}
+
+ChatBackend *ChatBackend::create(ChatRequestManager *requests, QObject *parent)
+{
+    const QString kind = qEnvironmentVariable("CHAT_BACKEND").trimmed().toLower();
+    if (kind == QLatin1String("openai")) return new OpenAiChatBackend(requests, parent);
+    if (kind == QLatin1String("mock")) return new MockChatBackend(parent);
+    if (!kind.isEmpty() && kind != QLatin1String("gemini")) {
+        qWarning() << "Unknown CHAT_BACKEND" << kind << "- using gemini";
+    }
+    return new GeminiChatBackend(requests, parent);
+}
+
+void ChatBackend::started(int id)
+{
+    Timing timing;
+    timing.clock.start();
+    timings.insert(id, timing);
+}
+
+void ChatBackend::emitText(int id, const QString &text)
+{
+    if (text.isEmpty()) return;
+    auto it = timings.find(id);
+    if (it != timings.end()) {
+        if (it->firstTokenMs < 0) it->firstTokenMs = it->clock.elapsed();
+        it->chars += text.size();
+    }
+    emit textReceived(id, text);
+}
+
+void ChatBackend::setTokenCount(int id, int tokens)
+{
+    auto it = timings.find(id);
+    if (it != timings.end()) it->tokens = tokens;
+}
+
+void ChatBackend::emitFinished(int id, const ChatRequestResult &result)
+{
+    const Timing timing = timings.take(id);
+    ChatBackendMetrics metrics;
+    metrics.firstTokenMs = timing.firstTokenMs;
+    metrics.totalMs = timing.clock.isValid() ? timing.clock.elapsed() : 0;
+    metrics.tokensEstimated = timing.tokens < 0;
+    // Same estimate as ChatContextBuilder::estimateTokens()
+    metrics.tokens = metrics.tokensEstimated ? int((timing.chars + 3) / 4) : timing.tokens;
+
+    if (result.outcome == ChatRequestResult::Success && metrics.firstTokenMs >= 0) {
+        ++totals.answers;
+        totals.firstTokenMs += metrics.firstTokenMs;
+        totals.totalMs += metrics.totalMs;
+        totals.tokens += metrics.tokens;
+        totals.generationMs += metrics.totalMs - metrics.firstTokenMs;
+    }
+    emit finished(id, result, metrics);
+}
+
+// HTTP backends
+
+HttpChatBackend::HttpChatBackend(ChatRequestManager *requests, QObject *parent)
+    : ChatBackend(parent)
+    , requests(requests)
+{
+    connect(requests, &ChatRequestManager::data, this, &HttpChatBackend::onData);
+    connect(requests, &ChatRequestManager::retrying, this, &HttpChatBackend::onRetrying);
+    connect(requests, &ChatRequestManager::finished, this, &HttpChatBackend::onFinished);
+}
+
+int HttpChatBackend::send(const QJsonArray &contents)
+{
+    const int id = requests->post(request(), body(contents));
+    streams.insert(id, Stream());
+    started(id);
+    return id;
+}
+
+void HttpChatBackend::cancel(int id)
+{
+    if (streams.contains(id)) requests->cancel(id);
+}
+
+// Text of the events completed by `bytes`
+QString HttpChatBackend::process(int id, Stream &stream, const QByteArray &bytes)
+{
+    QVector<SseEvent> events;
+    stream.parser.feed(bytes, events);
+
+    QString text;
+    for (const SseEvent &event : std::as_const(events)) {
+        // End marker of the OpenAI streams
+        if (event.data == "[DONE]") continue;
+        int tokens = -1;
+        text += parseEvent(event.data, stream.error, tokens);
+        if (tokens >= 0) setTokenCount(id, tokens);
+    }
+    return text;
+}
+
+void HttpChatBackend::onData(int id, const QByteArray &bytes)
+{
+    auto it = streams.find(id);
+    if (it == streams.end()) return;
+    emitText(id, process(id, *it, bytes));
+}
+
+void HttpChatBackend::onRetrying(int id, int attempt, int delayMs, const QString &reason)
+{
+    if (streams.contains(id)) emit retrying(id, attempt, delayMs, reason);
+}
+
+void HttpChatBackend::onFinished(int id, const ChatRequestResult &result)
+{
+    auto it = streams.find(id);
+    if (it == streams.end()) return;
+    if (result.outcome == ChatRequestResult::Success) {
+        // Last event, possibly without its blank line
+        const QString rest = process(id, *it, "\n\n");
+        emitText(id, rest);
+    }
+
+    const QString error = streams.take(id).error;
+    ChatRequestResult outcome = result;
+    // An error reported inside the stream (the status was 200)
+    if (outcome.outcome == ChatRequestResult::Success && !error.isEmpty()) {
+        outcome.outcome = ChatRequestResult::Failed;
+        outcome.errorString = error;
+    }
+    emitFinished(id, outcome);
+}
+
+// Gemini
+
+QString GeminiChatBackend::model() const
+{
+    return QLatin1String(GeminiModel);
+}
+
+QString GeminiChatBackend::configurationError() const
+{
+    if (qgetenv("GEMINI_API_KEY").isEmpty()) return tr("GEMINI_API_KEY not set in environment. Set it and retry.");
+    return QString();
+}
+
+QNetworkRequest GeminiChatBackend::request() const
+{
+    // Streaming variant: the answer comes as server-sent events, one JSON chunk each
+    // GEMINI_API_BASE_URL points the chat to another server (a proxy, a local test server)
+    const QString baseUrl = qEnvironmentVariable("GEMINI_API_BASE_URL",
+                                                 QStringLiteral("https://generativelanguage.googleapis.com"));
+    QUrl url(QString("%1/v1beta/models/%2:streamGenerateContent").arg(baseUrl, model()));
+    QUrlQuery query;
+    query.addQueryItem("alt", "sse");
+    url.setQuery(query);
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    request.setRawHeader("x-goog-api-key", qgetenv("GEMINI_API_KEY"));
+    return request;
+}
+
+QByteArray GeminiChatBackend::body(const QJsonArray &contents) const
+{
+    QJsonObject root;
+    root["contents"] = contents;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QString GeminiChatBackend::parseEvent(const QByteArray &data, QString &error, int &tokens) const
+{
+    const QJsonObject obj = QJsonDocument::fromJson(data).object();
+    if (obj.contains("error")) {
+        error = obj.value("error").toObject().value("message").toString();
+        return QString();
+    }
+    // Running total, the last chunk has the answer's
+    const QJsonValue count = obj.value("usageMetadata").toObject().value("candidatesTokenCount");
+    if (count.isDouble()) tokens = count.toInt();
+
+    // Structure: { "candidates": [{ "content": { "parts": [{ "text": "..." }] } }] }
+    QString text;
+    const QJsonArray candidates = obj.value("candidates").toArray();
+    if (candidates.isEmpty()) return text;
+    const QJsonArray parts = candidates.at(0).toObject().value("content").toObject().value("parts").toArray();
+    for (const QJsonValue &part : parts) {
+        text += part.toObject().value("text").toString();
+    }
+    return text;
+}
+
+// OpenAI-compatible
+
+QString OpenAiChatBackend::model() const
+{
+    // llama.cpp serves the model it was started with, whatever the name
+    return qEnvironmentVariable("OPENAI_MODEL", QStringLiteral("local"));
+}
+
+QNetworkRequest OpenAiChatBackend::request() const
+{
+    QString baseUrl = qEnvironmentVariable("OPENAI_BASE_URL", QLatin1String(DefaultOpenAiBaseUrl));
+    while (baseUrl.endsWith(QLatin1Char('/'))) baseUrl.chop(1);
+    QNetworkRequest request(QUrl(baseUrl + QLatin1String("/chat/completions")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    const QByteArray apiKey = qgetenv("OPENAI_API_KEY");
+    if (!apiKey.isEmpty()) request.setRawHeader("Authorization", "Bearer " + apiKey);
+    return request;
+}
+
+QByteArray OpenAiChatBackend::body(const QJsonArray &contents) const
+{
+    // Gemini contents to chat messages: "model" is "assistant", parts are joined
+    QJsonArray messages;
+    for (const QJsonValue &value : contents) {
+        const QJsonObject entry = value.toObject();
+        QStringList texts;
+        const QJsonArray parts = entry.value("parts").toArray();
+        for (const QJsonValue &part : parts) texts << part.toObject().value("text").toString();
+        QJsonObject message;
+        message["role"] = entry.value("role").toString() == QLatin1String("model") ? "assistant" : "user";
+        message["content"] = texts.join(QLatin1String("\n\n"));
+        messages.append(message);
+    }
+    QJsonObject root;
+    root["model"] = model();
+    root["messages"] = messages;
+    root["stream"] = true;
+    // Last chunk with the token counts
+    root["stream_options"] = QJsonObject{{"include_usage", true}};
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QString OpenAiChatBackend::parseEvent(const QByteArray &data, QString &error, int &tokens) const
+{
+    const QJsonObject obj = QJsonDocument::fromJson(data).object();
+    if (obj.contains("error")) {
+        const QJsonValue value = obj.value("error");
+        error = value.isObject() ? value.toObject().value("message").toString() : value.toString();
+        return QString();
+    }
+    const QJsonValue count = obj.value("usage").toObject().value("completion_tokens");
+    if (count.isDouble()) tokens = count.toInt();
+
+    // Structure: { "choices": [{ "delta": { "content": "..." } }] }
+    const QJsonArray choices = obj.value("choices").toArray();
+    if (choices.isEmpty()) return QString();
+    return choices.at(0).toObject().value("delta").toObject().value("content").toString();
+}
+
+// Mock
+
+MockChatBackend::MockChatBackend(QObject *parent)
+    : ChatBackend(parent)
+    , nextId(1)
+{
+}
+
+QString MockChatBackend::answer(const QJsonArray &contents)
+{
+    static const char *const words[] = {
+        "the", "editor", "buffer", "index", "token", "request", "stream", "layout", "cache", "line",
+        "model", "project", "file", "thread", "query", "view", "block", "parser", "answer", "budget",
+        "a", "of", "in", "and", "with", "for", "each", "every", "then", "when"
+    };
+    const int wordCount = int(sizeof(words) / sizeof(words[0]));
+
+    // Same request, same answer: the generator is seeded with its digest
+    const QByteArray digest = QCryptographicHash::hash(QJsonDocument(contents).toJson(QJsonDocument::Compact),
+                                                       QCryptographicHash::Md5);
+    QRandomGenerator random(qFromLittleEndian<quint32>(digest.constData()));
+
+    // The prompt is the end of the last entry
+    QString prompt;
+    const QJsonArray parts = contents.isEmpty() ? QJsonArray() : contents.last().toObject().value("parts").toArray();
+    if (!parts.isEmpty()) prompt = parts.last().toObject().value("text").toString().section(QLatin1Char('\n'), -1);
+
+    QString text = QStringLiteral("Mock answer to \"%1\".\n\n").arg(prompt.simplified().left(60));
+    for (int p = 0; p < MockParagraphs; ++p) {
+        QStringList sentence;
+        for (int w = 0; w < MockParagraphWords; ++w) sentence << QLatin1String(words[random.bounded(wordCount)]);
+        text += sentence.join(QLatin1Char(' ')) + QLatin1String(".\n\n");
+        // Some code too, for the renderer
+        if (p == 1) text += QStringLiteral("```cpp\nint answer(int x)\n{\n    return x * %1;\n}\n```\n\n").arg(random.bounded(2, 10));
+    }
+    return text.trimmed();
+}
+
+int MockChatBackend::send(const QJsonArray &contents)
+{
+    const int id = nextId++;
+    const QStringList words = answer(contents).split(QLatin1Char(' '));
+
+    Stream stream;
+    for (int i = 0; i < words.size(); i += MockChunkWords) {
+        QString chunk = words.mid(i, MockChunkWords).join(QLatin1Char(' '));
+        if (i + MockChunkWords < words.size()) chunk += QLatin1Char(' ');
+        stream.chunks << chunk;
+    }
+    stream.timer = new QTimer(this);
+    stream.timer->setSingleShot(true);
+    connect(stream.timer, &QTimer::timeout, this, [this, id]() { step(id); });
+    stream.timer->start(MockFirstTokenDelay);
+    streams.insert(id, stream);
+
+    started(id);
+    setTokenCount(id, int(words.size()));
+    return id;
+}
+
+void MockChatBackend::step(int id)
+{
+    auto it = streams.find(id);
+    if (it == streams.end()) return;
+    if (it->next < it->chunks.size()) {
+        it->timer->start(MockChunkInterval);
+        emitText(id, it->chunks.at(it->next++));
+        return;
+    }
+    streams.take(id).timer->deleteLater();
+    emitFinished(id, ChatRequestResult());
+}
+
+void MockChatBackend::cancel(int id)
+{
+    auto it = streams.find(id);
+    if (it == streams.end()) return;
+    streams.take(id).timer->deleteLater();
+    ChatRequestResult result;
+    result.outcome = ChatRequestResult::Canceled;
+    emitFinished(id, result);
+}
@@ -0,0 +1,184 @@
+#ifndef CHATBACKEND_H
+#define CHATBACKEND_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QNetworkRequest>
+#include "chatrequestmanager.h"
+#include "sseparser.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+// Measures of one answer
+struct ChatBackendMetrics
+{
+    qint64 firstTokenMs = -1;   // time to first token, -1 if no text came
+    qint64 totalMs = 0;
+    int tokens = 0;             // as counted by the server, else estimated
+    bool tokensEstimated = true;
+
+    // Generation speed, from the first token on
+    double tokensPerSecond() const;
+};
+
+// Sums over the answers of a backend, for averages
+struct ChatBackendStats
+{
+    int answers = 0;
+    qint64 firstTokenMs = 0;
+    qint64 totalMs = 0;
+    qint64 tokens = 0;
+    qint64 generationMs = 0;
+};
+
+// A model the chat can talk to. Requests are conversations in the Gemini
+// `contents` format (role "user" or "model", parts[].text), as built by
+// ChatContextBuilder; answers are streamed as text. The base class measures
+// every answer (time to first token, latency, tokens per second).
+class ChatBackend : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+
+    virtual QString name() const = 0;
+    virtual QString model() const = 0;
+    // Why requests cannot be sent (a missing API key...), empty if they can
+    virtual QString configurationError() const { return QString(); }
+    // Whether answers may be served again from the response cache
+    virtual bool cacheable() const { return true; }
+
+    // Returns the request id; textReceived() then finished() follow
+    virtual int send(const QJsonArray &contents) = 0;
+    // finished() (Canceled) is emitted before it returns
+    virtual void cancel(int id) = 0;
+
+    ChatBackendStats stats() const { return totals; }
+
+    // The backend chosen by CHAT_BACKEND: "gemini" (default), "openai" or "mock"
+    static ChatBackend *create(ChatRequestManager *requests, QObject *parent = nullptr);
+
+signals:
+    void textReceived(int id, const QString &text);
+    void retrying(int id, int attempt, int delayMs, const QString &reason);
+    void finished(int id, const ChatRequestResult &result, const ChatBackendMetrics &metrics);
+
+protected:
+    // For the implementations: they report, the base class measures
+    void started(int id);
+    void emitText(int id, const QString &text);
+    void setTokenCount(int id, int tokens);
+    void emitFinished(int id, const ChatRequestResult &result);
+
+private:
+    struct Timing {
+        QElapsedTimer clock;
+        qint64 firstTokenMs = -1;
+        qsizetype chars = 0;
+        int tokens = -1;
+    };
+    QHash<int, Timing> timings;
+    ChatBackendStats totals;
+};
+
+// Backends answering over HTTP with server-sent events, through the
+// ChatRequestManager (deadlines, retries, concurrency limit)
+class HttpChatBackend : public ChatBackend
+{
+    Q_OBJECT
+public:
+    HttpChatBackend(ChatRequestManager *requests, QObject *parent = nullptr);
+
+    int send(const QJsonArray &contents) override;
+    void cancel(int id) override;
+
+protected:
+    virtual QNetworkRequest request() const = 0;
+    virtual QByteArray body(const QJsonArray &contents) const = 0;
+    // Text of one event of the stream; may set `error`, or `tokens` when the server counts them
+    virtual QString parseEvent(const QByteArray &data, QString &error, int &tokens) const = 0;
+
+private:
+    struct Stream {
+        SseParser parser;
+        QString error;
+    };
+    ChatRequestManager *requests;
+    QHash<int, Stream> streams;
+
+    void onData(int id, const QByteArray &bytes);
+    void onRetrying(int id, int attempt, int delayMs, const QString &reason);
+    void onFinished(int id, const ChatRequestResult &result);
+    QString process(int id, Stream &stream, const QByteArray &bytes);
+};
+
+// Google Gemini, streamGenerateContent (GEMINI_API_KEY, GEMINI_API_BASE_URL)
+class GeminiChatBackend : public HttpChatBackend
+{
+    Q_OBJECT
+public:
+    using HttpChatBackend::HttpChatBackend;
+
+    QString name() const override { return QStringLiteral("gemini"); }
+    QString model() const override;
+    QString configurationError() const override;
+
+protected:
+    QNetworkRequest request() const override;
+    QByteArray body(const QJsonArray &contents) const override;
+    QString parseEvent(const QByteArray &data, QString &error, int &tokens) const override;
+};
+
+// OpenAI chat completions API, as served by llama.cpp, Ollama, vLLM...
+// (OPENAI_BASE_URL, OPENAI_MODEL, OPENAI_API_KEY if the server wants one)
+class OpenAiChatBackend : public HttpChatBackend
+{
+    Q_OBJECT
+public:
+    using HttpChatBackend::HttpChatBackend;
+
+    QString name() const override { return QStringLiteral("openai"); }
+    QString model() const override;
+
+protected:
+    QNetworkRequest request() const override;
+    QByteArray body(const QJsonArray &contents) const override;
+    QString parseEvent(const QByteArray &data, QString &error, int &tokens) const override;
+};
+
+// No network: a fixed answer derived from the request, streamed at a fixed
+// pace, the same on every run. For benchmarks of the chat itself.
+class MockChatBackend : public ChatBackend
+{
+    Q_OBJECT
+public:
+    explicit MockChatBackend(QObject *parent = nullptr);
+
+    QString name() const override { return QStringLiteral("mock"); }
+    QString model() const override { return QStringLiteral("mock"); }
+    bool cacheable() const override { return false; }
+
+    int send(const QJsonArray &contents) override;
+    void cancel(int id) override;
+
+    static QString answer(const QJsonArray &contents);
+
+private:
+    struct Stream {
+        QStringList chunks;
+        int next = 0;
+        QTimer *timer = nullptr;
+    };
+    QHash<int, Stream> streams;
+    int nextId;
+
+    void step(int id);
+};
+
+#endif // CHATBACKEND_H
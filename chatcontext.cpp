@@ -0,0 +1,176 @@
+#include "chatcontext.h"
+#include "projectindex.h"
+#include <QThread>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// Tokens of a request at most; the prompt is always sent whole
+static const int ContextTokenBudget = 12000;
+// Shares of the budget the selection and the conversation may take
+static const double SelectionShare = 0.4;
+static const double TurnsShare = 0.3;
+static const int MaxSnippets = 6;
+// The project files are compared with the index at most this often (ms)
+static const int RescanInterval = 30000;
+
+// Worker side: the index and its indexing steps
+struct ChatContextBuilder::IndexState
+{
+    ProjectIndex index;
+    QElapsedTimer sinceScan;
+    bool stepQueued = false;
+
+    // One step at a time in the worker's queue, so requests come between two steps
+    void schedule(QObject *worker)
+    {
+        if (stepQueued) return;
+        stepQueued = true;
+        QMetaObject::invokeMethod(worker, [this, worker]() {
+            stepQueued = false;
+            if (index.indexStep()) schedule(worker);
+        }, Qt::QueuedConnection);
+    }
+};
+
+int ChatContextBuilder::estimateTokens(const QString &text)
+{
+    return int((text.size() + 3) / 4);
+}
+
+static QString fenced(const QString &header, const QString &code)
+{
+    return header + QLatin1String("\n```\n") + code + QLatin1String("\n```");
+}
+
+// Runs on the worker thread
+QJsonArray ChatContextBuilder::assemble(const ChatContextRequest &request, ProjectIndex &index)
+{
+    int budget = ContextTokenBudget - estimateTokens(request.prompt);
+    QStringList blocks;
+
+    // Selection of the editor, cut to its share
+    const int selectionLastLine = request.selectionFirstLine + int(request.selectionText.count(QLatin1Char('\n')));
+    if (!request.selectionText.isEmpty() && budget > 0) {
+        const int maxChars = int(ContextTokenBudget * SelectionShare) * 4;
+        QString code = request.selectionText.left(qMin(maxChars, budget * 4));
+        const QString where = request.selectionPath.isEmpty()
+                                  ? QStringLiteral("Selected in the editor:")
+                                  : QStringLiteral("Selected in the editor (%1, from line %2):")
+                                        .arg(request.selectionPath).arg(request.selectionFirstLine);
+        const QString block = fenced(where, code);
+        budget -= estimateTokens(block);
+        blocks << block;
+    }
+
+    // Recent turns, newest first until their share is used
+    QVector<ChatMessage> turns;
+    int turnsBudget = qMin(budget, int(ContextTokenBudget * TurnsShare));
+    for (int i = request.turns.size() - 1; i >= 0 && turnsBudget > 0; --i) {
+        const int tokens = estimateTokens(request.turns.at(i).text);
+        if (tokens > turnsBudget) break;
+        turnsBudget -= tokens;
+        budget -= tokens;
+        turns.prepend(request.turns.at(i));
+    }
+
+    // Project code related to the prompt (and to the selection), best first
+    if (budget > 0) {
+        const QString query = request.prompt + QLatin1Char('\n') + request.selectionText.left(2000);
+        const QVector<ProjectSnippet> snippets = index.search(query, MaxSnippets);
+        QStringList found;
+        for (const ProjectSnippet &snippet : snippets) {
+            // Already there as the selection
+            if (snippet.path == request.selectionPath && snippet.firstLine <= selectionLastLine
+                && snippet.lastLine >= request.selectionFirstLine) {
+                continue;
+            }
+            const QString block = fenced(QStringLiteral("%1, lines %2-%3:")
+                                             .arg(snippet.path).arg(snippet.firstLine).arg(snippet.lastLine),
+                                         snippet.text);
+            const int tokens = estimateTokens(block);
+            if (tokens > budget) continue;
+            budget -= tokens;
+            found << block;
+        }
+        if (!found.isEmpty()) blocks << QStringLiteral("Code from the project that may be relevant:") << found;
+    }
+
+    // Gemini contents: consecutive messages of one role go in one entry
+    QJsonArray contents;
+    QString lastRole;
+    QJsonArray parts;
+    auto flush = [&]() {
+        if (parts.isEmpty()) return;
+        QJsonObject entry;
+        entry["role"] = lastRole;
+        entry["parts"] = parts;
+        contents.append(entry);
+        parts = QJsonArray();
+    };
+    auto add = [&](const QString &role, const QString &text) {
+        if (role != lastRole) flush();
+        lastRole = role;
+        QJsonObject part;
+        part["text"] = text;
+        parts.append(part);
+    };
+    for (const ChatMessage &turn : std::as_const(turns)) add(turn.sender, turn.text);
+    blocks << request.prompt;
+    add(QStringLiteral("user"), blocks.join(QLatin1String("\n\n")));
+    flush();
+    return contents;
+}
+
+// GUI thread
+
+ChatContextBuilder::ChatContextBuilder(QObject *parent)
+    : QObject(parent)
+    , thread(new QThread(this))
+    , worker(new QObject)
+    , state(new IndexState)
+    , nextTicket(1)
+{
+    thread->setObjectName("ChatContextBuilder");
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start();
+}
+
+ChatContextBuilder::~ChatContextBuilder()
+{
+    thread->quit();
+    thread->wait();
+    delete state;
+}
+
+void ChatContextBuilder::setProjectDirectory(const QString &path)
+{
+    IndexState *s = state;
+    QObject *w = worker;
+    QMetaObject::invokeMethod(worker, [s, w, path]() {
+        s->index.setRoot(path);
+        s->sinceScan.start();
+        s->schedule(w);
+    }, Qt::QueuedConnection);
+}
+
+quint64 ChatContextBuilder::build(const ChatContextRequest &request)
+{
+    const quint64 ticket = nextTicket++;
+    IndexState *s = state;
+    QObject *w = worker;
+    QMetaObject::invokeMethod(worker, [this, s, w, ticket, request]() {
+        const QJsonArray contents = assemble(request, s->index);
+        QMetaObject::invokeMethod(this, [this, ticket, contents]() {
+            emit contextReady(ticket, contents);
+        }, Qt::QueuedConnection);
+
+        // The files may have changed since the last scan; only the changed ones are read again
+        if (s->index.isComplete() && s->sinceScan.isValid() && s->sinceScan.elapsed() > RescanInterval) {
+            s->index.rescan();
+            s->sinceScan.restart();
+            s->schedule(w);
+        }
+    }, Qt::QueuedConnection);
+    return ticket;
+}
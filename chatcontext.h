@@ -0,0 +1,62 @@
+#ifndef CHATCONTEXT_H
+#define CHATCONTEXT_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QJsonArray>
+#include "chattranscript.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class ProjectIndex;
+
+struct ChatContextRequest
+{
+    QString prompt;
+    QVector<ChatMessage> turns;     // conversation before the prompt, oldest first; sender is "user" or "model"
+    QString selectionPath;          // file of the editor selection, may be empty
+    int selectionFirstLine = 0;
+    QString selectionText;
+};
+
+// Assembles the `contents` of a chat request: recent turns of the
+// conversation, the selection of the active editor and the project code most
+// relevant to the prompt, packed to a token budget (the prompt always fits,
+// then the selection, the recent turns, the project snippets).
+//
+// The project index lives on a worker thread: it is built in small steps
+// when the project is set, refreshed (changed files only) after requests,
+// and serves queries between two steps, from a cache when the prompt terms
+// repeat. GUI thread only.
+class ChatContextBuilder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatContextBuilder(QObject *parent = nullptr);
+    ~ChatContextBuilder();
+
+    void setProjectDirectory(const QString &path);
+    // Returns a ticket; contextReady() follows
+    quint64 build(const ChatContextRequest &request);
+
+    // Rough token count of a text (about four characters per token)
+    static int estimateTokens(const QString &text);
+
+signals:
+    void contextReady(quint64 ticket, const QJsonArray &contents);
+
+private:
+    struct IndexState;
+
+    QThread *thread;
+    QObject *worker;            // lives on `thread`
+    IndexState *state;          // used on `thread` only
+    quint64 nextTicket;
+
+    static QJsonArray assemble(const ChatContextRequest &request, ProjectIndex &index);
+};
+
+#endif // CHATCONTEXT_H
@@ -0,0 +1,207 @@
+#include "chatrenderer.h"
+#include "syntaxhighlighter.h"
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QColor>
+#include <QRegularExpression>
+
+// Cache budgets, in characters of HTML
+static const int MessageCacheSize = 4 * 1024 * 1024;
+static const int BlockCacheSize = 2 * 1024 * 1024;
+
+ChatRenderer &ChatRenderer::instance()
+{
+    static ChatRenderer renderer;
+    return renderer;
+}
+
+ChatRenderer::ChatRenderer()
+    : messages(MessageCacheSize)
+    , blocks(BlockCacheSize)
+{
+}
+
+QString ChatRenderer::render(qint64 id, const QString &markdown)
+{
+    const QPair<qint64, size_t> key(id, qHash(markdown));
+    if (id != 0) {
+        if (const Rendered *hit = messages.object(key)) {
+            if (hit->source == markdown) return hit->html;
+        }
+    }
+
+    QString html;
+    for (const QString &block : splitBlocks(markdown)) {
+        html += renderBlock(block);
+    }
+
+    if (id != 0) {
+        messages.insert(key, new Rendered{ markdown, html }, qMax<qsizetype>(1, html.size()));
+    }
+    return html;
+}
+
+QString ChatRenderer::renderBlock(const QString &block)
+{
+    const size_t key = qHash(block);
+    if (const Rendered *hit = blocks.object(key)) {
+        if (hit->source == block) return hit->html;
+    }
+
+    QString html;
+    if (isFenced(block)) {
+        const ChatCodeBlock code = fencedCode(block);
+        html = renderCode(code.language, code.code);
+    } else {
+        html = renderMarkdown(block);
+    }
+
+    blocks.insert(key, new Rendered{ block, html }, qMax<qsizetype>(1, html.size()));
+    return html;
+}
+
+QVector<ChatCodeBlock> ChatRenderer::codeBlocks(const QString &markdown)
+{
+    QVector<ChatCodeBlock> result;
+    for (const QString &block : splitBlocks(markdown)) {
+        if (isFenced(block)) result.append(fencedCode(block));
+    }
+    return result;
+}
+
+bool ChatRenderer::isFenced(const QString &block)
+{
+    return block.startsWith(QLatin1String("```")) || block.startsWith(QLatin1String("~~~"));
+}
+
+// Fence line with its info string, then the code (the closing fence may not be in yet)
+ChatCodeBlock ChatRenderer::fencedCode(const QString &block)
+{
+    ChatCodeBlock result;
+    const int firstNewline = block.indexOf(QLatin1Char('\n'));
+    result.language = (firstNewline < 0 ? block : block.left(firstNewline)).mid(3).trimmed().toLower();
+    result.code = firstNewline < 0 ? QString() : block.mid(firstNewline + 1);
+    const int lastNewline = result.code.lastIndexOf(QLatin1Char('\n'));
+    const QString lastLine = result.code.mid(lastNewline + 1).trimmed();
+    if (lastLine.startsWith(block.left(3))) result.code.truncate(qMax(0, lastNewline));
+    return result;
+}
+
+// List item marker at the start of `line`: "- ", "* ", "+ ", "1. ", "1) "
+static bool isListItem(const QString &line)
+{
+    static const QRegularExpression marker(QStringLiteral("^([-*+]|\\d{1,9}[.)])(\\s|$)"));
+    return marker.match(line).hasMatch();
+}
+
+// Top-level blocks, each rendered as its own document. A blank line ends a
+// block only when the next line starts at column 0 and does not continue a
+// list, so indented continuations, loose lists and indented code stay with
+// their block. A fence at column 0 is a block of its own (blank lines
+// included); an indented one belongs to its list item.
+QStringList ChatRenderer::splitBlocks(const QString &markdown)
+{
+    QStringList result;
+    QString current;
+    QString fence;
+    int blankLines = 0;         // seen after `current`, not yet added to it
+    bool inList = false;        // the last column 0 line of `current` is a list item
+
+    const QStringList lines = markdown.split(QLatin1Char('\n'));
+    for (const QString &line : lines) {
+        const QString trimmed = line.trimmed();
+        if (!fence.isEmpty()) {
+            current += QLatin1Char('\n') + line;
+            if (trimmed.startsWith(fence)) {
+                result.append(current);
+                current.clear();
+                fence.clear();
+            }
+            continue;
+        }
+        if (trimmed.isEmpty()) {
+            if (!current.isEmpty()) ++blankLines;
+            continue;
+        }
+
+        const bool atColumnZero = !line.at(0).isSpace();
+        if (atColumnZero && (line.startsWith(QLatin1String("```")) || line.startsWith(QLatin1String("~~~")))) {
+            if (!current.isEmpty()) result.append(current);
+            current = trimmed;
+            fence = trimmed.left(3);
+            blankLines = 0;
+            inList = false;
+            continue;
+        }
+
+        const bool listItem = atColumnZero && isListItem(line);
+        if (blankLines > 0 && atColumnZero && !(listItem && inList)) {
+            result.append(current);
+            current.clear();
+        }
+        if (!current.isEmpty()) current += QString(blankLines + 1, QLatin1Char('\n'));
+        current += line;
+        blankLines = 0;
+        if (atColumnZero) inList = listItem;
+    }
+    if (!current.isEmpty()) result.append(current);
+    return result;
+}
+
+QString ChatRenderer::renderMarkdown(const QString &block)
+{
+    QTextDocument doc;
+    doc.setMarkdown(block);
+    // Only the body: the fragments of a message are concatenated
+    const QString html = doc.toHtml();
+    const int bodyStart = html.indexOf(QLatin1String("<body"));
+    const int contentStart = bodyStart < 0 ? -1 : html.indexOf(QLatin1Char('>'), bodyStart) + 1;
+    const int contentEnd = html.lastIndexOf(QLatin1String("</body>"));
+    if (contentStart <= 0 || contentEnd < contentStart) return html;
+    return html.mid(contentStart, contentEnd - contentStart);
+}
+
+static QString colorName(const QBrush &brush)
+{
+    return brush.color().name(QColor::HexRgb);
+}
+
+QString ChatRenderer::renderCode(const QString &language, const QString &code)
+{
+    QString html = QStringLiteral(
+        "<pre style='background-color: #1e1e1e; color: #d4d4d4; padding: 8px;"
+        " font-family: Consolas, Menlo, monospace; font-size: 12px;'>");
+
+    const bool isCpp = language == "cpp" || language == "c++" || language == "c" || language == "cc"
+                       || language == "cxx" || language == "h" || language == "hpp";
+    const bool isHtml = language == "html" || language == "htm" || language == "xml";
+    if (!isCpp && !isHtml) {
+        return html + code.toHtmlEscaped() + QStringLiteral("</pre>");
+    }
+
+    QTextDocument doc;
+    doc.setPlainText(code);
+    SyntaxHighlighter highlighter(&doc, isCpp ? SyntaxHighlighter::CPP : SyntaxHighlighter::HTML);
+    highlighter.rehighlight();
+
+    // The highlighter leaves its formats in the layout of each line
+    for (QTextBlock line = doc.begin(); line.isValid(); line = line.next()) {
+        const QString text = line.text();
+        int pos = 0;
+        const QList<QTextLayout::FormatRange> ranges = line.layout()->formats();
+        for (const QTextLayout::FormatRange &range : ranges) {
+            if (range.start < pos || range.start >= text.size()) continue;
+            html += text.mid(pos, range.start - pos).toHtmlEscaped();
+            QString style = QStringLiteral("color: %1;").arg(colorName(range.format.foreground()));
+            if (range.format.fontWeight() >= QFont::Bold) style += QStringLiteral(" font-weight: bold;");
+            if (range.format.fontItalic()) style += QStringLiteral(" font-style: italic;");
+            html += QStringLiteral("<span style='%1'>").arg(style)
+                    + text.mid(range.start, range.length).toHtmlEscaped() + QStringLiteral("</span>");
+            pos = range.start + range.length;
+        }
+        html += text.mid(pos).toHtmlEscaped();
+        if (line.next().isValid()) html += QLatin1Char('\n');
+    }
+    return html + QStringLiteral("</pre>");
+}
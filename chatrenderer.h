@@ -0,0 +1,52 @@
+#ifndef CHATRENDERER_H
+#define CHATRENDERER_H
+
+#include <QString>
+#include <QStringList>
+#include <QCache>
+#include <QPair>
+#include <QVector>
+
+// A fenced code block of a chat message
+struct ChatCodeBlock
+{
+    QString language;           // info string of the fence, lower case, may be empty
+    QString code;
+};
+
+// Markdown of the chat answers to HTML fragments.
+//
+// A message is rendered block by block (top-level paragraphs and lists, fenced code);
+// each block's HTML is cached by its text, so while an answer streams in
+// only its last block is rendered again. Finished messages are cached whole
+// by database id and text hash. Fenced C++ and HTML code goes through the
+// editor's tree-sitter SyntaxHighlighter, once per block. GUI thread only.
+class ChatRenderer
+{
+public:
+    static ChatRenderer &instance();
+
+    // `id` is the database id of the message, 0 while it is not saved (streaming)
+    QString render(qint64 id, const QString &markdown);
+    // The fenced code blocks of a message, in order
+    static QVector<ChatCodeBlock> codeBlocks(const QString &markdown);
+
+private:
+    ChatRenderer();
+
+    struct Rendered {
+        QString source;         // checked on a hit: the keys are hashes
+        QString html;
+    };
+    QCache<QPair<qint64, size_t>, Rendered> messages;
+    QCache<size_t, Rendered> blocks;
+
+    QString renderBlock(const QString &block);
+    static QStringList splitBlocks(const QString &markdown);
+    static bool isFenced(const QString &block);
+    static ChatCodeBlock fencedCode(const QString &block);
+    static QString renderMarkdown(const QString &block);
+    static QString renderCode(const QString &language, const QString &code);
+};
+
+#endif // CHATRENDERER_H
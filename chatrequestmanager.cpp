@@ -0,0 +1,217 @@
+#include "chatrequestmanager.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+// Requests on the network at once; the next ones wait for a slot
+static const int MaxConcurrentRequests = 2;
+// Whole request, retries included, and silence allowed in a stream (ms)
+static const int RequestDeadline = 180000;
+static const int IdleTimeout = 30000;
+// Attempts per request, and the backoff between them (ms)
+static const int MaxAttempts = 4;
+static const int BackoffBase = 1000;
+static const int BackoffMax = 30000;
+
+ChatRequestManager::ChatRequestManager(QNetworkAccessManager *network, QObject *parent)
+    : QObject(parent)
+    , network(network)
+    , runningCount(0)
+    , nextId(1)
+{
+}
+
+ChatRequestManager::~ChatRequestManager()
+{
+    // No signal from here: the receivers may be going away too
+    blockSignals(true);
+    const QList<int> ids = requests.keys();
+    for (int id : ids) cancel(id);
+}
+
+int ChatRequestManager::post(const QNetworkRequest &request, const QByteArray &body)
+{
+    const int id = nextId++;
+    Request r;
+    r.request = request;
+    r.body = body;
+    r.deadline = QDeadlineTimer(RequestDeadline);
+    requests.insert(id, r);
+    waiting.enqueue(id);
+    startNext();
+    return id;
+}
+
+void ChatRequestManager::cancel(int id)
+{
+    if (!requests.contains(id)) return;
+    waiting.removeAll(id);
+    ChatRequestResult result;
+    result.outcome = ChatRequestResult::Canceled;
+    finish(id, result);
+}
+
+void ChatRequestManager::startNext()
+{
+    while (runningCount < MaxConcurrentRequests && !waiting.isEmpty()) {
+        const int id = waiting.dequeue();
+        Request &r = requests[id];
+        r.running = true;
+        ++runningCount;
+        send(id);
+    }
+}
+
+void ChatRequestManager::send(int id)
+{
+    Request &r = requests[id];
+    ++r.attempts;
+    r.timedOut = false;
+    r.reply = network->post(r.request, r.body);
+    if (!r.watchdog) {
+        r.watchdog = new QTimer(this);
+        r.watchdog->setSingleShot(true);
+        connect(r.watchdog, &QTimer::timeout, this, [this, id]() {
+            auto it = requests.find(id);
+            if (it == requests.end() || !it->reply) return;
+            it->timedOut = true;
+            it->deadlineExpired = it->deadline.hasExpired();
+            it->reply->abort();
+        });
+    }
+    armWatchdog(r);
+
+    QNetworkReply *reply = r.reply;
+    connect(reply, &QNetworkReply::readyRead, this, [this, id]() { onReadyRead(id); });
+    connect(reply, &QNetworkReply::finished, this, [this, id]() { onReplyFinished(id); });
+}
+
+void ChatRequestManager::armWatchdog(Request &request)
+{
+    const qint64 remaining = qMax<qint64>(0, request.deadline.remainingTime());
+    request.watchdog->start(int(qMin<qint64>(IdleTimeout, remaining)));
+}
+
+void ChatRequestManager::onReadyRead(int id)
+{
+    auto it = requests.find(id);
+    if (it == requests.end() || !it->reply) return;
+    armWatchdog(*it);
+    // An error body is read when the reply is finished
+    const int status = it->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status >= 300) return;
+    const QByteArray bytes = it->reply->readAll();
+    if (bytes.isEmpty()) return;
+    it->delivered = true;
+    emit data(id, bytes);
+}
+
+void ChatRequestManager::onReplyFinished(int id)
+{
+    auto it = requests.find(id);
+    if (it == requests.end()) return;
+    QNetworkReply *reply = it->reply;
+    if (!reply) return;
+    it->reply = nullptr;
+    it->watchdog->stop();
+    reply->deleteLater();
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QNetworkReply::NetworkError error = reply->error();
+    const QByteArray rest = reply->readAll();
+
+    if (error == QNetworkReply::NoError && status < 300) {
+        if (!rest.isEmpty()) {
+            it->delivered = true;
+            emit data(id, rest);
+            it = requests.find(id); // a receiver may have canceled it
+            if (it == requests.end()) return;
+        }
+        ChatRequestResult result;
+        result.httpStatus = status;
+        result.attempts = it->attempts;
+        finish(id, result);
+        return;
+    }
+
+    // Worth another attempt: rate limiting, server side failures, a dropped
+    // or silent connection; never once part of the answer was shown
+    const bool retryableStatus = status == 429 || status == 500 || status == 502 || status == 503 || status == 504;
+    const bool retryableError = status == 0
+                                && (it->timedOut || error == QNetworkReply::RemoteHostClosedError
+                                    || error == QNetworkReply::TemporaryNetworkFailureError
+                                    || error == QNetworkReply::NetworkSessionFailedError
+                                    || error == QNetworkReply::ConnectionRefusedError
+                                    || error == QNetworkReply::TimeoutError);
+    const QString reason = !it->timedOut ? describeError(reply, status, rest)
+                           : it->deadlineExpired ? tr("no complete answer within %1 s").arg(RequestDeadline / 1000)
+                                                 : tr("no data for %1 s").arg(IdleTimeout / 1000);
+    const int delay = retryDelay(it->attempts, reply);
+    if ((retryableStatus || retryableError) && !it->delivered && !it->deadlineExpired
+        && it->attempts < MaxAttempts && delay < it->deadline.remainingTime()) {
+        QTimer::singleShot(delay, this, [this, id]() {
+            if (requests.contains(id)) send(id);
+        });
+        emit retrying(id, it->attempts + 1, delay, reason);
+        return;
+    }
+
+    ChatRequestResult result;
+    result.outcome = it->timedOut ? ChatRequestResult::TimedOut : ChatRequestResult::Failed;
+    result.httpStatus = status;
+    result.attempts = it->attempts;
+    result.errorString = reason;
+    finish(id, result);
+}
+
+void ChatRequestManager::finish(int id, ChatRequestResult result)
+{
+    Request r = requests.take(id);
+    if (r.watchdog) r.watchdog->deleteLater();
+    if (r.reply) {
+        r.reply->disconnect(this);
+        r.reply->abort();
+        r.reply->deleteLater();
+    }
+    if (result.attempts == 0) result.attempts = r.attempts;
+    if (r.running) {
+        --runningCount;
+        // Not from inside the caller's stack (cancel() from a slot of finished())
+        QMetaObject::invokeMethod(this, &ChatRequestManager::startNext, Qt::QueuedConnection);
+    }
+    emit finished(id, result);
+}
+
+// Exponential backoff with jitter (half fixed, half random), unless the server said when
+int ChatRequestManager::retryDelay(int attempts, const QNetworkReply *reply)
+{
+    bool ok = false;
+    const int retryAfter = reply->rawHeader("Retry-After").trimmed().toInt(&ok);
+    if (ok && retryAfter >= 0) return qMin(retryAfter * 1000, BackoffMax);
+
+    const int exponential = qMin(BackoffMax, BackoffBase << qMin(attempts - 1, 5));
+    return exponential / 2 + int(QRandomGenerator::global()->bounded(exponential / 2 + 1));
+}
+
+// The message of a Google API error body ({"error": {"message": ...}}), else Qt's
+QString ChatRequestManager::describeError(QNetworkReply *reply, int status, const QByteArray &body)
+{
+    QString message = QJsonDocument::fromJson(body).object().value("error").toObject().value("message").toString();
+    if (message.isEmpty()) message = reply->errorString();
+    switch (status) {
+    case 0:
+        return message;
+    case 429:
+        return tr("rate limit reached (HTTP 429): %1").arg(message);
+    case 500:
+    case 502:
+    case 503:
+    case 504:
+        return tr("service unavailable (HTTP %1): %2").arg(status).arg(message);
+    default:
+        return tr("HTTP %1: %2").arg(status).arg(message);
+    }
+}
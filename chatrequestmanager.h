@@ -0,0 +1,86 @@
+#ifndef CHATREQUESTMANAGER_H
+#define CHATREQUESTMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QByteArray>
+#include <QString>
+#include <QNetworkRequest>
+#include <QDeadlineTimer>
+
+QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+QT_END_NAMESPACE
+
+struct ChatRequestResult
+{
+    enum Outcome { Success, Failed, TimedOut, Canceled };
+    Outcome outcome = Success;
+    int httpStatus = 0;         // of the last attempt, 0 if no response
+    int attempts = 0;
+    QString errorString;        // readable: the API's message when it sent one
+};
+
+// POST requests of the chat, streamed, with the failure handling a remote
+// model needs:
+// - a deadline per request and an idle timeout (no byte for a while);
+// - cancellation, which aborts the reply;
+// - retries with exponential backoff and jitter (or the server's
+//   Retry-After) for 429, 5xx and transient network errors, as long as
+//   nothing of the answer was delivered;
+// - at most a few requests on the network at once, the others wait.
+// GUI thread only.
+class ChatRequestManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatRequestManager(QNetworkAccessManager *network, QObject *parent = nullptr);
+    ~ChatRequestManager();
+
+    // Returns the request id; data() then finished() follow
+    int post(const QNetworkRequest &request, const QByteArray &body);
+    // finished() (Canceled) is emitted before it returns
+    void cancel(int id);
+    bool isActive(int id) const { return requests.contains(id); }
+
+signals:
+    // Body bytes of a successful response, as they arrive
+    void data(int id, const QByteArray &bytes);
+    // Attempt `attempt` starts in `delayMs`; `reason`: why the previous one failed
+    void retrying(int id, int attempt, int delayMs, const QString &reason);
+    void finished(int id, const ChatRequestResult &result);
+
+private:
+    struct Request {
+        QNetworkRequest request;
+        QByteArray body;
+        QNetworkReply *reply = nullptr;
+        QTimer *watchdog = nullptr;     // deadline and idle timeout of the current attempt
+        QDeadlineTimer deadline;
+        int attempts = 0;
+        bool running = false;           // holds a network slot
+        bool delivered = false;         // data() was emitted: no retry any more
+        bool timedOut = false;
+        bool deadlineExpired = false;
+    };
+
+    QNetworkAccessManager *network;
+    QHash<int, Request> requests;
+    QQueue<int> waiting;
+    int runningCount;
+    int nextId;
+
+    void startNext();
+    void send(int id);
+    void onReadyRead(int id);
+    void onReplyFinished(int id);
+    void armWatchdog(Request &request);
+    void finish(int id, ChatRequestResult result);
+    static int retryDelay(int attempts, const QNetworkReply *reply);
+    static QString describeError(QNetworkReply *reply, int status, const QByteArray &body);
+};
+
+#endif // CHATREQUESTMANAGER_H
@@ -0,0 +1,510 @@
+#include "chatstore.h"
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QUuid>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QRegularExpression>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+// Messages wait this long for the ones that follow (a streamed answer right after the question)
+static const int CommitDelay = 250;
+// Ids indexed per step when an existing database gets its search index
+static const qint64 BackfillBatch = 2000;
+// Context kept around the match in a LIKE snippet, in characters
+static const int SnippetContext = 60;
+// Cached answers: lifetime (s) and total size kept (bytes of text)
+static const qint64 ResponseCacheTtl = 7 * 24 * 3600;
+static const qint64 ResponseCacheMaxSize = 16 * 1024 * 1024;
+
+// Worker side: the connection and its prepared statements
+struct ChatStore::Connection
+{
+    QString name;
+    QObject *worker;
+    QSqlDatabase db;
+    std::unique_ptr<QSqlQuery> insert;
+    std::unique_ptr<QSqlQuery> page;
+    std::unique_ptr<QSqlQuery> search;
+    std::unique_ptr<QSqlQuery> cacheLookup;
+    std::unique_ptr<QSqlQuery> cacheTouch;
+    std::unique_ptr<QSqlQuery> cacheStore;
+    bool fts = false;
+    // Messages older than the index still to index: ids in (backfillNext, backfillEnd]
+    qint64 backfillNext = 0;
+    qint64 backfillEnd = 0;
+
+    bool open(const QString &path);
+    void close();
+    void setupSearch();
+    void setupResponseCache();
+    void pruneResponseCache();
+    void backfill();
+    QVector<ChatSearchHit> find(const QString &text, int limit);
+};
+
+// Everything below runs on the worker thread
+
+bool ChatStore::Connection::open(const QString &path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(path);
+    if (!db.open()) {
+        qWarning() << "Failed to open chat history database:" << db.lastError().text();
+        close();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    // A commit is one append to the log, synced at checkpoints only
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+    query.exec(
+        "CREATE TABLE IF NOT EXISTS chat_messages ("
+        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  sender TEXT NOT NULL,"
+        "  message TEXT NOT NULL,"
+        "  timestamp DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ")"
+    );
+
+    insert = std::make_unique<QSqlQuery>(db);
+    insert->prepare("INSERT INTO chat_messages (sender, message) VALUES (?, ?)");
+    page = std::make_unique<QSqlQuery>(db);
+    page->setForwardOnly(true);
+    page->prepare("SELECT id, sender, message FROM chat_messages WHERE id < ? ORDER BY id DESC LIMIT ?");
+
+    setupSearch();
+    setupResponseCache();
+    return true;
+}
+
+void ChatStore::Connection::setupResponseCache()
+{
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE IF NOT EXISTS response_cache ("
+               "  key TEXT PRIMARY KEY,"
+               "  response TEXT NOT NULL,"
+               "  created INTEGER NOT NULL,"
+               "  last_used INTEGER NOT NULL,"
+               "  size INTEGER NOT NULL"
+               ") WITHOUT ROWID");
+    query.exec("CREATE INDEX IF NOT EXISTS response_cache_last_used ON response_cache (last_used)");
+
+    cacheLookup = std::make_unique<QSqlQuery>(db);
+    cacheLookup->setForwardOnly(true);
+    cacheLookup->prepare("SELECT response FROM response_cache WHERE key = ? AND created >= ?");
+    cacheTouch = std::make_unique<QSqlQuery>(db);
+    cacheTouch->prepare("UPDATE response_cache SET last_used = ? WHERE key = ?");
+    cacheStore = std::make_unique<QSqlQuery>(db);
+    cacheStore->prepare("INSERT OR REPLACE INTO response_cache (key, response, created, last_used, size)"
+                        " VALUES (?, ?, ?, ?, ?)");
+}
+
+// Expired entries, then the least recently used ones beyond the size limit
+void ChatStore::Connection::pruneResponseCache()
+{
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM response_cache WHERE created < ?");
+    query.addBindValue(QDateTime::currentSecsSinceEpoch() - ResponseCacheTtl);
+    query.exec();
+    query.prepare("DELETE FROM response_cache WHERE key IN ("
+                  "  SELECT key FROM ("
+                  "    SELECT key, SUM(size) OVER (ORDER BY last_used DESC) AS total FROM response_cache"
+                  "  ) WHERE total > ?"
+                  ")");
+    query.addBindValue(ResponseCacheMaxSize);
+    query.exec();
+}
+
+void ChatStore::Connection::setupSearch()
+{
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE IF NOT EXISTS chat_meta ("
+               "  key TEXT PRIMARY KEY,"
+               "  value INTEGER NOT NULL"
+               ") WITHOUT ROWID");
+
+    query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'chat_messages_fts'");
+    fts = query.next();
+    if (!fts) {
+        // The messages already there are indexed by backfill(), the next ones by the triggers
+        db.transaction();
+        fts = query.exec("CREATE VIRTUAL TABLE chat_messages_fts USING fts5("
+                         "  message, content='chat_messages', content_rowid='id',"
+                         "  tokenize='unicode61 remove_diacritics 2'"
+                         ")")
+              && query.exec("CREATE TRIGGER chat_messages_ai AFTER INSERT ON chat_messages BEGIN"
+                            "  INSERT INTO chat_messages_fts (rowid, message) VALUES (new.id, new.message);"
+                            " END")
+              && query.exec("CREATE TRIGGER chat_messages_ad AFTER DELETE ON chat_messages BEGIN"
+                            "  INSERT INTO chat_messages_fts (chat_messages_fts, rowid, message)"
+                            "  VALUES ('delete', old.id, old.message);"
+                            " END")
+              && query.exec("CREATE TRIGGER chat_messages_au AFTER UPDATE OF message ON chat_messages BEGIN"
+                            "  INSERT INTO chat_messages_fts (chat_messages_fts, rowid, message)"
+                            "  VALUES ('delete', old.id, old.message);"
+                            "  INSERT INTO chat_messages_fts (rowid, message) VALUES (new.id, new.message);"
+                            " END")
+              && query.exec("INSERT OR REPLACE INTO chat_meta (key, value) VALUES"
+                            " ('fts_backfill_next', 0),"
+                            " ('fts_backfill_end', (SELECT IFNULL(MAX(id), 0) FROM chat_messages))");
+        if (fts) {
+            db.commit();
+        } else {
+            qWarning() << "Chat history search without FTS5:" << query.lastError().text();
+            db.rollback();
+        }
+    }
+
+    search = std::make_unique<QSqlQuery>(db);
+    search->setForwardOnly(true);
+    if (fts) {
+        query.exec("SELECT key, value FROM chat_meta WHERE key IN ('fts_backfill_next', 'fts_backfill_end')");
+        while (query.next()) {
+            if (query.value(0).toString() == "fts_backfill_next") backfillNext = query.value(1).toLongLong();
+            else backfillEnd = query.value(1).toLongLong();
+        }
+        // \x01 and \x02 around the matched terms, turned into tags once escaped
+        search->prepare("SELECT m.id, m.sender, m.timestamp,"
+                        "  snippet(chat_messages_fts, 0, char(1), char(2), '…', 16)"
+                        " FROM chat_messages_fts JOIN chat_messages m ON m.id = chat_messages_fts.rowid"
+                        " WHERE chat_messages_fts MATCH ? ORDER BY rank LIMIT ?");
+        if (backfillNext < backfillEnd) {
+            QMetaObject::invokeMethod(worker, [this]() { backfill(); }, Qt::QueuedConnection);
+        }
+    } else {
+        search->prepare("SELECT id, sender, timestamp, message FROM chat_messages"
+                        " WHERE message LIKE ? ESCAPE '\\' ORDER BY id DESC LIMIT ?");
+    }
+}
+
+// One batch, then the next one is queued behind the requests waiting meanwhile
+void ChatStore::Connection::backfill()
+{
+    if (!fts || !db.isOpen() || backfillNext >= backfillEnd) return;
+
+    const qint64 upTo = qMin(backfillNext + BackfillBatch, backfillEnd);
+    QSqlQuery query(db);
+    db.transaction();
+    query.prepare("INSERT INTO chat_messages_fts (rowid, message)"
+                  " SELECT id, message FROM chat_messages WHERE id > ? AND id <= ?");
+    query.addBindValue(backfillNext);
+    query.addBindValue(upTo);
+    query.exec();
+    query.prepare("UPDATE chat_meta SET value = ? WHERE key = 'fts_backfill_next'");
+    query.addBindValue(upTo);
+    query.exec();
+    if (!db.commit()) {
+        qWarning() << "Failed to index the chat history:" << db.lastError().text();
+        db.rollback();
+        return;
+    }
+
+    backfillNext = upTo;
+    if (backfillNext < backfillEnd) {
+        QMetaObject::invokeMethod(worker, [this]() { backfill(); }, Qt::QueuedConnection);
+    }
+}
+
+// Words of the query, all required, the last one as a prefix (as typed)
+static QString ftsQuery(const QString &text)
+{
+    const QStringList words = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    QStringList terms;
+    for (const QString &word : words) {
+        QString term = word;
+        terms << QLatin1Char('"') + term.replace(QLatin1Char('"'), QLatin1String("\"\"")) + QLatin1Char('"');
+    }
+    if (!terms.isEmpty() && !text.back().isSpace()) terms.last() += QLatin1Char('*');
+    return terms.join(QLatin1Char(' '));
+}
+
+static QString snippetHtml(const QString &marked)
+{
+    QString html = marked.toHtmlEscaped();
+    html.replace(QChar(1), QLatin1String("<b style='color: #e5c07b;'>"));
+    html.replace(QChar(2), QLatin1String("</b>"));
+    html.replace(QLatin1Char('\n'), QLatin1Char(' '));
+    return html;
+}
+
+// LIKE fallback: the text around the first occurrence
+static QString likeSnippet(const QString &message, const QString &text)
+{
+    const int at = message.indexOf(text, 0, Qt::CaseInsensitive);
+    if (at < 0) return snippetHtml(message.left(2 * SnippetContext));
+    const int from = qMax(0, at - SnippetContext);
+    const int to = qMin<int>(message.size(), at + text.size() + SnippetContext);
+    QString marked = message.mid(from, at - from) + QChar(1) + message.mid(at, text.size()) + QChar(2)
+                     + message.mid(at + text.size(), to - at - text.size());
+    if (from > 0) marked.prepend(QStringLiteral("…"));
+    if (to < message.size()) marked += QStringLiteral("…");
+    return snippetHtml(marked);
+}
+
+QVector<ChatSearchHit> ChatStore::Connection::find(const QString &text, int limit)
+{
+    QVector<ChatSearchHit> hits;
+    if (!search) return hits;
+
+    if (fts) {
+        const QString match = ftsQuery(text);
+        if (match.isEmpty()) return hits;
+        search->addBindValue(match);
+    } else {
+        QString pattern = text.trimmed();
+        pattern.replace(QLatin1String("\\"), QLatin1String("\\\\"));
+        pattern.replace(QLatin1String("%"), QLatin1String("\\%"));
+        pattern.replace(QLatin1String("_"), QLatin1String("\\_"));
+        search->addBindValue(QLatin1Char('%') + pattern + QLatin1Char('%'));
+    }
+    search->addBindValue(limit);
+    if (!search->exec()) {
+        qWarning() << "Chat history search failed:" << search->lastError().text();
+        return hits;
+    }
+    while (search->next()) {
+        ChatSearchHit hit;
+        hit.id = search->value(0).toLongLong();
+        hit.sender = search->value(1).toString();
+        hit.timestamp = search->value(2).toString();
+        hit.snippet = fts ? snippetHtml(search->value(3).toString())
+                          : likeSnippet(search->value(3).toString(), text.trimmed());
+        hits.append(hit);
+    }
+    search->finish();
+    return hits;
+}
+
+void ChatStore::Connection::close()
+{
+    insert.reset();
+    page.reset();
+    search.reset();
+    cacheLookup.reset();
+    cacheTouch.reset();
+    cacheStore.reset();
+    fts = false;
+    backfillNext = backfillEnd = 0;
+    if (db.isOpen()) db.close();
+    db = QSqlDatabase();
+    if (QSqlDatabase::contains(name)) QSqlDatabase::removeDatabase(name);
+}
+
+// GUI thread
+
+ChatStore::ChatStore(QObject *parent)
+    : QObject(parent)
+    , thread(new QThread(this))
+    , worker(new QObject)
+    , connection(new Connection)
+    , committer(this, CommitDelay, [this]() { commit(); })
+    , generation(0)
+    , nextTicket(1)
+{
+    connection->name = QUuid::createUuid().toString();
+    connection->worker = worker;
+
+    thread->setObjectName("ChatStore");
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start();
+}
+
+ChatStore::~ChatStore()
+{
+    close();
+    // The close is queued behind the last commit
+    QMetaObject::invokeMethod(worker, []() {}, Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+    delete connection;
+}
+
+void ChatStore::open(const QString &path)
+{
+    close();
+    if (path.isEmpty()) return;
+    databasePath = path;
+    Connection *c = connection;
+    QMetaObject::invokeMethod(worker, [c, path]() { c->open(path); }, Qt::QueuedConnection);
+}
+
+void ChatStore::close()
+{
+    if (!isOpen()) return;
+    committer.flush();
+    databasePath.clear();
+    ++generation;
+    Connection *c = connection;
+    QMetaObject::invokeMethod(worker, [c]() { c->close(); }, Qt::QueuedConnection);
+}
+
+quint64 ChatStore::saveMessage(const QString &sender, const QString &text)
+{
+    if (!isOpen()) return 0;
+    const quint64 ticket = nextTicket++;
+    pending.append({ ticket, sender, text });
+    committer.schedule();
+    return ticket;
+}
+
+void ChatStore::storeResponse(const QByteArray &key, const QString &response)
+{
+    if (!isOpen()) return;
+    pendingResponses.append({ key, response });
+    committer.schedule();
+}
+
+void ChatStore::flush()
+{
+    committer.flush();
+}
+
+void ChatStore::commit()
+{
+    if ((pending.isEmpty() && pendingResponses.isEmpty()) || !isOpen()) return;
+    QVector<PendingMessage> writes;
+    writes.swap(pending);
+    QVector<PendingResponse> responses;
+    responses.swap(pendingResponses);
+
+    Connection *c = connection;
+    const quint64 gen = generation;
+    QMetaObject::invokeMethod(worker, [this, c, gen, writes, responses]() {
+        if (!c->insert) return;
+        QVector<QPair<quint64, qint64>> ids;
+        c->db.transaction();
+        for (const PendingMessage &message : writes) {
+            c->insert->addBindValue(message.sender);
+            c->insert->addBindValue(message.text);
+            if (!c->insert->exec()) {
+                qWarning() << "Failed to save chat message:" << c->insert->lastError().text();
+                continue;
+            }
+            ids.append({ message.ticket, c->insert->lastInsertId().toLongLong() });
+        }
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        for (const PendingResponse &response : responses) {
+            c->cacheStore->addBindValue(QString::fromLatin1(response.key));
+            c->cacheStore->addBindValue(response.response);
+            c->cacheStore->addBindValue(now);
+            c->cacheStore->addBindValue(now);
+            c->cacheStore->addBindValue(response.response.size());
+            if (!c->cacheStore->exec()) {
+                qWarning() << "Failed to cache chat answer:" << c->cacheStore->lastError().text();
+            }
+        }
+        if (!responses.isEmpty()) c->pruneResponseCache();
+        if (!c->db.commit()) {
+            qWarning() << "Failed to save chat messages:" << c->db.lastError().text();
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, gen, ids]() {
+            if (gen != generation) return;
+            for (const auto &saved : ids) emit messageSaved(saved.first, saved.second);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void ChatStore::fetchPage(qint64 beforeId, int limit)
+{
+    if (!isOpen()) return;
+    Connection *c = connection;
+    const quint64 gen = generation;
+    QMetaObject::invokeMethod(worker, [this, c, gen, beforeId, limit]() {
+        QVector<ChatMessage> page;
+        int rows = 0;
+        if (c->page) {
+            c->page->addBindValue(beforeId > 0 ? beforeId : std::numeric_limits<qint64>::max());
+            c->page->addBindValue(limit);
+            if (c->page->exec()) {
+                while (c->page->next()) {
+                    ++rows;
+                    ChatMessage message;
+                    message.id = c->page->value(0).toLongLong();
+                    message.sender = c->page->value(1).toString();
+                    message.text = c->page->value(2).toString();
+                    if (!message.sender.isEmpty() && !message.text.isEmpty()) page.append(message);
+                }
+                c->page->finish();
+            } else {
+                qWarning() << "Failed to load chat history:" << c->page->lastError().text();
+            }
+        }
+        std::reverse(page.begin(), page.end());
+        const bool hasMore = rows == limit;
+        QMetaObject::invokeMethod(this, [this, gen, beforeId, page, hasMore]() {
+            if (gen != generation) return;
+            emit pageLoaded(beforeId, page, hasMore);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void ChatStore::search(const QString &text, int limit)
+{
+    if (!isOpen()) return;
+    // The messages still queued are searchable too
+    flush();
+    Connection *c = connection;
+    const quint64 gen = generation;
+    QMetaObject::invokeMethod(worker, [this, c, gen, text, limit]() {
+        const QVector<ChatSearchHit> hits = c->find(text, limit);
+        QMetaObject::invokeMethod(this, [this, gen, text, hits]() {
+            if (gen != generation) return;
+            emit searchFinished(text, hits);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void ChatStore::lookupResponse(const QByteArray &key)
+{
+    if (!isOpen()) {
+        emit responseLookedUp(key, QString(), false);
+        return;
+    }
+    // Not committed yet: the answer is still in the queue
+    for (const PendingResponse &response : std::as_const(pendingResponses)) {
+        if (response.key == key) {
+            emit responseLookedUp(key, response.response, true);
+            return;
+        }
+    }
+
+    Connection *c = connection;
+    const quint64 gen = generation;
+    QMetaObject::invokeMethod(worker, [this, c, gen, key]() {
+        QString response;
+        bool found = false;
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        if (c->cacheLookup) {
+            c->cacheLookup->addBindValue(QString::fromLatin1(key));
+            c->cacheLookup->addBindValue(now - ResponseCacheTtl);
+            if (c->cacheLookup->exec() && c->cacheLookup->next()) {
+                response = c->cacheLookup->value(0).toString();
+                found = true;
+            }
+            c->cacheLookup->finish();
+        }
+        if (found) {
+            c->cacheTouch->addBindValue(now);
+            c->cacheTouch->addBindValue(QString::fromLatin1(key));
+            c->cacheTouch->exec();
+        }
+        QMetaObject::invokeMethod(this, [this, gen, key, response, found]() {
+            if (gen != generation) {
+                emit responseLookedUp(key, QString(), false);
+                return;
+            }
+            emit responseLookedUp(key, response, found);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
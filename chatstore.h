@@ -0,0 +1,95 @@
+#ifndef CHATSTORE_H
+#define CHATSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "groupcommit.h"
+#include "chattranscript.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+struct ChatSearchHit
+{
+    qint64 id;
+    QString sender;
+    QString timestamp;
+    QString snippet;            // HTML, matched terms in <b>
+};
+
+// Chat history of a project (.editerako/chat_history.db), on a worker thread.
+//
+// The worker owns the SQLite connection (WAL mode, synchronous=NORMAL) and
+// its prepared statements, reused for every insert and every page. Opening
+// the database, reading and writing never block the GUI thread: saved
+// messages are queued and committed together, in one transaction, shortly
+// after the first of them; results come back as signals.
+//
+// Messages are indexed for search by an FTS5 table kept in sync by
+// triggers, ranked with bm25. A database created before the index is
+// indexed on the worker in small batches, between the other requests. If
+// SQLite has no FTS5, the search falls back to a LIKE scan.
+//
+// The database also caches model answers by request key, for a week and
+// up to a total size (least recently used first out). GUI thread only.
+class ChatStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatStore(QObject *parent = nullptr);
+    ~ChatStore();
+
+    // Closes the current database first; results still on their way from it are dropped
+    void open(const QString &path);
+    void close();
+    bool isOpen() const { return !databasePath.isEmpty(); }
+
+    // Returns a ticket; messageSaved() gives the id of the row once committed
+    quint64 saveMessage(const QString &sender, const QString &text);
+    // Messages older than `beforeId` (0: the last ones), oldest first, through pageLoaded()
+    void fetchPage(qint64 beforeId, int limit);
+    // Commits the queued messages now
+    void flush();
+    // Best matches first, through searchFinished()
+    void search(const QString &text, int limit);
+
+    // Answer cached under `key`, through responseLookedUp()
+    void lookupResponse(const QByteArray &key);
+    // Queued and committed like the messages
+    void storeResponse(const QByteArray &key, const QString &response);
+
+signals:
+    void messageSaved(quint64 ticket, qint64 id);
+    void pageLoaded(qint64 beforeId, const QVector<ChatMessage> &messages, bool hasMore);
+    void searchFinished(const QString &text, const QVector<ChatSearchHit> &hits);
+    // `found` is false on a miss (or an expired entry)
+    void responseLookedUp(const QByteArray &key, const QString &response, bool found);
+
+private:
+    struct PendingMessage {
+        quint64 ticket;
+        QString sender;
+        QString text;
+    };
+    struct PendingResponse {
+        QByteArray key;
+        QString response;
+    };
+    struct Connection;
+
+    QThread *thread;
+    QObject *worker;            // lives on `thread`
+    Connection *connection;     // used on `thread` only
+    GroupCommit committer;
+    QVector<PendingMessage> pending;
+    QVector<PendingResponse> pendingResponses;
+    QString databasePath;
+    quint64 generation;         // of the open database, checked by the results
+    quint64 nextTicket;
+
+    void commit();
+};
+
+#endif // CHATSTORE_H
@@ -0,0 +1,285 @@
+#include "chattranscript.h"
+#include "chatrenderer.h"
+#include <QCoreApplication>
+#include <QAbstractItemView>
+#include <QAbstractTextDocumentLayout>
+#include <QTextDocument>
+#include <QPainter>
+#include <QPainterPath>
+#include <QFontMetrics>
+#include <cmath>
+
+// Laid out bubbles kept for painting (a few screens of rows)
+static const int BubbleCacheSize = 128;
+
+// Geometry of a bubble, in pixels
+static const int PaddingX = 18;
+static const int PaddingY = 12;
+static const int RowMargin = 6;
+static const int SideMargin = 8;
+static const int Radius = 14;
+static const int HeaderSpacing = 6;
+
+ChatTranscriptModel::ChatTranscriptModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , nextRevision(1)
+{
+}
+
+int ChatTranscriptModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : messages.size();
+}
+
+QVariant ChatTranscriptModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= messages.size()) return QVariant();
+    const ChatMessage &message = messages.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return message.text;
+    case SenderRole:
+        return message.sender;
+    case IdRole:
+        return message.id;
+    case RevisionRole:
+        return message.revision;
+    default:
+        return QVariant();
+    }
+}
+
+int ChatTranscriptModel::append(qint64 id, const QString &sender, const QString &text)
+{
+    const int row = messages.size();
+    beginInsertRows(QModelIndex(), row, row);
+    messages.append({ id, sender, text, nextRevision++ });
+    endInsertRows();
+    return row;
+}
+
+void ChatTranscriptModel::prepend(QVector<ChatMessage> older)
+{
+    if (older.isEmpty()) return;
+    for (ChatMessage &message : older) message.revision = nextRevision++;
+    beginInsertRows(QModelIndex(), 0, older.size() - 1);
+    older.append(messages);
+    messages.swap(older);
+    endInsertRows();
+}
+
+void ChatTranscriptModel::setText(int row, const QString &text)
+{
+    if (row < 0 || row >= messages.size()) return;
+    messages[row].text = text;
+    messages[row].revision = nextRevision++;
+    emit dataChanged(index(row), index(row));
+}
+
+void ChatTranscriptModel::setId(int row, qint64 id)
+{
+    if (row < 0 || row >= messages.size()) return;
+    messages[row].id = id;
+    emit dataChanged(index(row), index(row), { IdRole });
+}
+
+void ChatTranscriptModel::clear()
+{
+    beginResetModel();
+    messages.clear();
+    endResetModel();
+}
+
+qint64 ChatTranscriptModel::oldestId() const
+{
+    for (const ChatMessage &message : messages) {
+        if (message.id > 0) return message.id;
+    }
+    return 0;
+}
+
+ChatBubbleDelegate::Bubble::~Bubble()
+{
+    delete document;
+}
+
+ChatBubbleDelegate::ChatBubbleDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+    , bubbles(BubbleCacheSize)
+    , layoutWidth(-1)
+{
+}
+
+enum class BubbleKind { User, Model, System };
+
+static BubbleKind bubbleKind(const QString &sender)
+{
+    // The senders are stored translated, as ChatWidget shows them
+    if (sender == QCoreApplication::translate("ChatWidget", "You")) return BubbleKind::User;
+    if (sender == QCoreApplication::translate("ChatWidget", "Gemini")) return BubbleKind::Model;
+    return BubbleKind::System;
+}
+
+static QFont contentFont(const QFont &base)
+{
+    QFont font = base;
+    font.setPixelSize(14);
+    return font;
+}
+
+static QFont headerFont(const QFont &base)
+{
+    QFont font = base;
+    font.setPixelSize(11);
+    font.setBold(true);
+    font.setLetterSpacing(QFont::AbsoluteSpacing, 0.5);
+    return font;
+}
+
+static int viewWidth(const QStyleOptionViewItem &option)
+{
+    if (const QAbstractItemView *view = qobject_cast<const QAbstractItemView *>(option.widget)) {
+        return view->viewport()->width();
+    }
+    return option.rect.width();
+}
+
+ChatBubbleDelegate::Bubble *ChatBubbleDelegate::bubble(const QStyleOptionViewItem &option,
+                                                       const QModelIndex &index) const
+{
+    const int width = viewWidth(option);
+    if (width != layoutWidth) {
+        // Every bubble wraps differently now
+        bubbles.clear();
+        layoutWidth = width;
+    }
+
+    const quint64 revision = index.data(ChatTranscriptModel::RevisionRole).toULongLong();
+    if (Bubble *cached = bubbles.object(revision)) return cached;
+
+    const QString text = index.data(Qt::DisplayRole).toString();
+    const BubbleKind kind = bubbleKind(index.data(ChatTranscriptModel::SenderRole).toString());
+
+    QTextDocument *document = new QTextDocument;
+    document->setDocumentMargin(0);
+    document->setDefaultFont(contentFont(option.font));
+    switch (kind) {
+    case BubbleKind::User:
+        document->setPlainText(text);
+        break;
+    case BubbleKind::Model:
+        document->setHtml(ChatRenderer::instance().render(
+            index.data(ChatTranscriptModel::IdRole).toLongLong(), text));
+        break;
+    case BubbleKind::System:
+        document->setPlainText(QStringLiteral("⚠️ ") + text);
+        break;
+    }
+
+    // Shrinks to the text, up to a share of the view
+    const double share = kind == BubbleKind::User ? 0.75 : kind == BubbleKind::Model ? 0.8 : 0.9;
+    const int maxTextWidth = qMax(40, int(width * share) - 2 * PaddingX);
+    document->setTextWidth(maxTextWidth);
+    const qreal textWidth = qMin<qreal>(maxTextWidth, std::ceil(document->idealWidth()) + 1);
+    document->setTextWidth(textWidth);
+
+    Bubble *result = new Bubble{ document,
+                                 QSizeF(textWidth + 2 * PaddingX, document->size().height() + 2 * PaddingY),
+                                 0 };
+    result->height = int(std::ceil(result->size.height())) + 2 * RowMargin;
+    if (kind == BubbleKind::Model) {
+        result->height += QFontMetrics(headerFont(option.font)).height() + HeaderSpacing;
+    }
+    bubbles.insert(revision, result);
+
+    if (const ChatTranscriptModel *model = qobject_cast<const ChatTranscriptModel *>(index.model())) {
+        const ChatMessage &message = model->at(index.row());
+        message.measure = { revision, width, result->height };
+    }
+    return result;
+}
+
+QSize ChatBubbleDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const int width = viewWidth(option);
+    // Known height: no document needed (every row is asked on each layout of the view)
+    if (const ChatTranscriptModel *model = qobject_cast<const ChatTranscriptModel *>(index.model())) {
+        const ChatMessage &message = model->at(index.row());
+        if (message.measure.revision == message.revision && message.measure.width == width) {
+            return QSize(width, message.measure.height);
+        }
+    }
+    return QSize(width, bubble(option, index)->height);
+}
+
+void ChatBubbleDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                               const QModelIndex &index) const
+{
+    const Bubble *b = bubble(option, index);
+    const BubbleKind kind = bubbleKind(index.data(ChatTranscriptModel::SenderRole).toString());
+    const QRect row = option.rect;
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    qreal top = row.top() + RowMargin;
+    qreal left = row.left() + SideMargin;
+    QColor background;
+    QColor foreground;
+    QColor border;
+    switch (kind) {
+    case BubbleKind::User:
+        // Design moderne avec fond violet solide
+        left = row.right() - SideMargin - b->size.width();
+        background = QColor("#5b4fc4");
+        foreground = Qt::white;
+        break;
+    case BubbleKind::Model: {
+        // Design élégant avec fond gris foncé solide, précédé du nom
+        const QFont header = headerFont(option.font);
+        painter->setFont(header);
+        painter->setPen(QColor("#8ab4f8"));
+        const int headerHeight = QFontMetrics(header).height();
+        painter->drawText(QRectF(left + 6, top, row.width(), headerHeight),
+                          Qt::AlignLeft | Qt::AlignVCenter, QStringLiteral("✨ GEMINI AI"));
+        top += headerHeight + HeaderSpacing;
+        background = QColor("#2a2a2f");
+        foreground = QColor("#e8e8e8");
+        border = QColor("#8ab4f8");
+        break;
+    }
+    case BubbleKind::System:
+        // Design discret mais visible
+        left = row.left() + (row.width() - b->size.width()) / 2;
+        background = QColor("#3a2a2a");
+        foreground = QColor("#f48771");
+        border = QColor("#f48771");
+        break;
+    }
+
+    const QRectF rect(QPointF(left, top), b->size);
+    QPainterPath path;
+    path.addRoundedRect(rect, Radius, Radius);
+    painter->fillPath(path, background);
+    if (option.state & QStyle::State_Selected) {
+        painter->setPen(QPen(QColor("#4a9eff"), 2));
+        painter->drawPath(path);
+    } else if (kind == BubbleKind::System) {
+        painter->setPen(QPen(border, 1));
+        painter->drawPath(path);
+    } else if (kind == BubbleKind::Model) {
+        // Accent on the left edge
+        painter->save();
+        painter->setClipPath(path);
+        painter->fillRect(QRectF(rect.left(), rect.top(), 3, rect.height()), border);
+        painter->restore();
+    }
+
+    painter->translate(rect.left() + PaddingX, rect.top() + PaddingY);
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette = option.palette;
+    context.palette.setColor(QPalette::Text, foreground);
+    context.clip = QRectF(QPointF(0, 0), b->document->size());
+    b->document->documentLayout()->draw(painter, context);
+    painter->restore();
+}
@@ -0,0 +1,91 @@
+#ifndef CHATTRANSCRIPT_H
+#define CHATTRANSCRIPT_H
+
+#include <QAbstractListModel>
+#include <QStyledItemDelegate>
+#include <QVector>
+#include <QString>
+#include <QCache>
+
+QT_BEGIN_NAMESPACE
+class QTextDocument;
+QT_END_NAMESPACE
+
+struct ChatMessage
+{
+    qint64 id = 0;              // database id, 0 while the message is not saved
+    QString sender;
+    QString text;
+    quint64 revision = 0;       // new value on every text change (layout cache key)
+
+    // Row height measured by ChatBubbleDelegate, valid for this revision and view width
+    struct Measure {
+        quint64 revision = 0;
+        int width = -1;
+        int height = 0;
+    };
+    mutable Measure measure;
+};
+
+// Messages shown by the chat, oldest first. Only a window of the
+// conversation is loaded: older pages are prepended as the user scrolls up.
+class ChatTranscriptModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        SenderRole = Qt::UserRole + 1,
+        IdRole,
+        RevisionRole
+    };
+
+    explicit ChatTranscriptModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    const ChatMessage &at(int row) const { return messages.at(row); }
+    // Returns the row of the new message
+    int append(qint64 id, const QString &sender, const QString &text);
+    // `older` is sorted oldest first and precedes every loaded message
+    void prepend(QVector<ChatMessage> older);
+    void setText(int row, const QString &text);
+    void setId(int row, qint64 id);
+    void clear();
+
+    // Keyset of the next page to load, 0 when nothing saved is loaded
+    qint64 oldestId() const;
+
+private:
+    QVector<ChatMessage> messages;
+    quint64 nextRevision;
+};
+
+// Paints the messages as bubbles. A bubble's height is measured once per
+// revision and view width and kept with its message, so the view's layout
+// passes over all rows cost nothing; laid out documents are only cached for
+// painting the visible rows. Model answers are rendered through ChatRenderer.
+class ChatBubbleDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit ChatBubbleDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    struct Bubble {
+        QTextDocument *document;
+        QSizeF size;            // bubble, padding included
+        int height;             // row
+        ~Bubble();
+    };
+    mutable QCache<quint64, Bubble> bubbles;
+    mutable int layoutWidth;
+
+    Bubble *bubble(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+};
+
+#endif // CHATTRANSCRIPT_H
@@ -1,45 +1,110 @@
 #include "chatwidget.h"
+#include "chattranscript.h"
+#include "chatstore.h"
+#include "chatcontext.h"
+#include "chatbackend.h"
+#include "codeeditor.h"
+#include "chatrenderer.h"
+#include "linediff.h"
+#include "searchengine.h"
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QTextDocumentFragment>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
-#include <QTextEdit>
+#include <QListView>
+#include <QTextBrowser>
+#include <QAction>
+#include <QMenu>
+#include <QFileInfo>
+#include <QClipboard>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
 #include <QJsonDocument>
-#include <QJsonObject>
 #include <QJsonArray>
-#include <QJsonValue>
-#include <QUrl>
-#include <QUrlQuery>
+#include <QCryptographicHash>
 #include <QApplication>
 #include <QScrollBar>
 #include <QDateTime>
-#include <QTextDocument>
 #include <QSplitter>
 #include <QDir>
 #include <QFile>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include <QSqlError>
-#include <QUuid>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <utility>
+
+// Rendering of a streamed answer: at most once per this many ms
+static const int StreamRenderInterval = 50;
+// Messages loaded at a time from the history (the last ones, then older pages on scroll-up)
+static const int HistoryPageSize = 50;
+// History search: results shown, and the pause in typing before searching
+static const int MaxSearchResults = 50;
+static const int SearchDelay = 150;
+// Messages before the prompt offered to the context builder (it keeps what fits its budget)
+static const int MaxContextTurns = 20;
 
 ChatWidget::ChatWidget(QWidget *parent)
     : QWidget(parent)
-    , conversationView(new QTextEdit(this))
+    , conversationView(new QListView(this))
+    , m_transcript(new ChatTranscriptModel(this))
+    , searchLine(new QLineEdit(this))
+    , searchResults(new QTextBrowser(this))
+    , m_searchTimer(new QTimer(this))
     , inputLine(new QLineEdit(this))
     , sendButton(new QPushButton(tr("➤"), this))
+    , stopButton(new QPushButton(tr("■"), this))
     , networkManager(new QNetworkAccessManager(this))
-    , m_dbConnectionName(QUuid::createUuid().toString())
+    , m_requests(new ChatRequestManager(networkManager, this))
+    , m_backend(ChatBackend::create(m_requests, this))
+    , m_store(new ChatStore(this))
+    , m_contextBuilder(new ChatContextBuilder(this))
+    , m_contextTicket(0)
+    , m_hasOlderMessages(false)
+    , m_loadingOlderMessages(false)
+    , m_streamRequest(0)
+    , m_streamRenderTimer(new QTimer(this))
 {
     QString time = QDateTime::currentDateTime().toString("HH:mm");
     
+    // Transcript: one row per message, drawn as a bubble by the delegate.
+    // Rows have their own heights and the view scrolls by pixel.
+    ChatBubbleDelegate *bubbleDelegate = new ChatBubbleDelegate(conversationView);
+    conversationView->setModel(m_transcript);
+    conversationView->setItemDelegate(bubbleDelegate);
+    conversationView->setUniformItemSizes(false);
+    conversationView->setResizeMode(QListView::Adjust);
+    conversationView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    conversationView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    conversationView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    conversationView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    // A bubble whose text changed (streamed answer) gets a new height
+    connect(m_transcript, &QAbstractItemModel::dataChanged, bubbleDelegate,
+            [bubbleDelegate](const QModelIndex &topLeft) { emit bubbleDelegate->sizeHintChanged(topLeft); });
+    // Older pages of the history come in when the top is reached
+    connect(conversationView->verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        if (value <= conversationView->verticalScrollBar()->minimum()) loadOlderMessages();
+    });
+    connect(conversationView->verticalScrollBar(), &QScrollBar::rangeChanged, this, [this](int, int max) {
+        if (max == 0) loadOlderMessages(); // the page does not fill the view
+    });
+
+    QAction *copyAction = new QAction(tr("Copy"), conversationView);
+    copyAction->setShortcut(QKeySequence::Copy);
+    copyAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(copyAction, &QAction::triggered, this, &ChatWidget::copySelectedMessages);
+    conversationView->addAction(copyAction);
+    // Copy, and the code blocks of the message to apply to the editor
+    conversationView->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(conversationView, &QWidget::customContextMenuRequested, this, [this, copyAction](const QPoint &pos) {
+        showConversationMenu(pos, copyAction);
+    });
+
     // Conversation view styling - Design moderne avec dégradé subtil
-    conversationView->setReadOnly(true);
     conversationView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
     conversationView->setStyleSheet(
-        "QTextEdit {"
+        "QListView {"
         "  background: qlineargradient(x1:0, y1:0, x2:0, y2:1,"
         "    stop:0 #1a1a1d, stop:1 #16161a);"
         "  color: #e8e8e8;"
@@ -50,6 +115,7 @@ ChatWidget::ChatWidget(QWidget *parent)
         "  font-size: 14px;"
         "  line-height: 1.6;"
         "  selection-background-color: #4a9eff;"
+        "  outline: none;"
         "}"
         "QScrollBar:vertical {"
         "  background: transparent;"
@@ -69,6 +135,30 @@ ChatWidget::ChatWidget(QWidget *parent)
         "}"
     );
 
+    // History search: the results replace the conversation while there is a query
+    searchLine->setPlaceholderText(tr("Rechercher dans l'historique..."));
+    searchLine->setClearButtonEnabled(true);
+    searchLine->setStyleSheet(
+        "QLineEdit {"
+        "  background-color: #2a2a2f;"
+        "  color: #e8e8e8;"
+        "  border: 1px solid transparent;"
+        "  border-radius: 14px;"
+        "  padding: 6px 14px;"
+        "  font-size: 12px;"
+        "}"
+        "QLineEdit:focus {"
+        "  border: 1px solid #4a9eff;"
+        "}"
+    );
+    searchResults->setOpenLinks(false);
+    searchResults->setStyleSheet(conversationView->styleSheet().replace("QListView", "QTextBrowser"));
+    searchResults->hide();
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(SearchDelay);
+    connect(searchLine, &QLineEdit::textChanged, m_searchTimer, qOverload<>(&QTimer::start));
+    connect(m_searchTimer, &QTimer::timeout, this, &ChatWidget::searchHistory);
+
     // Input field styling - Design plus moderne avec ombre
     inputLine->setPlaceholderText(tr("Posez votre question à Gemini..."));
     inputLine->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
@@ -120,6 +210,25 @@ ChatWidget::ChatWidget(QWidget *parent)
         "}"
     );
 
+    // Stop button: replaces the send button while an answer is on its way
+    stopButton->setFixedSize(44, 44);
+    stopButton->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    stopButton->setCursor(Qt::PointingHandCursor);
+    stopButton->setToolTip(tr("Arrêter la réponse"));
+    stopButton->setStyleSheet(
+        "QPushButton {"
+        "  background: #3a3a45;"
+        "  color: white;"
+        "  border: none;"
+        "  border-radius: 22px;"
+        "  font-size: 14px;"
+        "}"
+        "QPushButton:hover {"
+        "  background: #c94c4c;"
+        "}"
+    );
+    stopButton->hide();
+
     // Input layout encapsulated in a container so it can be placed in a splitter
     QWidget *inputContainer = new QWidget(this);
     QHBoxLayout *inputLayout = new QHBoxLayout(inputContainer);
@@ -127,10 +236,19 @@ ChatWidget::ChatWidget(QWidget *parent)
     inputLayout->setSpacing(12);
     inputLayout->addWidget(inputLine);
     inputLayout->addWidget(sendButton);
+    inputLayout->addWidget(stopButton);
 
     // Use a vertical splitter so the user can stretch the conversation area (height)
+    QWidget *conversationContainer = new QWidget(this);
+    QVBoxLayout *conversationLayout = new QVBoxLayout(conversationContainer);
+    conversationLayout->setContentsMargins(0, 0, 0, 0);
+    conversationLayout->setSpacing(8);
+    conversationLayout->addWidget(searchLine);
+    conversationLayout->addWidget(conversationView, 1);
+    conversationLayout->addWidget(searchResults, 1);
+
     QSplitter *split = new QSplitter(Qt::Vertical, this);
-    split->addWidget(conversationView);
+    split->addWidget(conversationContainer);
     split->addWidget(inputContainer);
     split->setStretchFactor(0, 1);
     split->setCollapsible(0, false);
@@ -160,95 +278,30 @@ ChatWidget::ChatWidget(QWidget *parent)
         "}"
     );
 
+    m_streamRenderTimer->setSingleShot(true);
+    m_streamRenderTimer->setInterval(StreamRenderInterval);
+    connect(m_streamRenderTimer, &QTimer::timeout, this, &ChatWidget::renderStreamingMessage);
+
+    connect(m_store, &ChatStore::messageSaved, this, &ChatWidget::onMessageSaved);
+    connect(m_store, &ChatStore::pageLoaded, this, &ChatWidget::onPageLoaded);
+    connect(m_store, &ChatStore::searchFinished, this, &ChatWidget::onSearchFinished);
+    connect(m_contextBuilder, &ChatContextBuilder::contextReady, this, &ChatWidget::onContextReady);
+    connect(m_store, &ChatStore::responseLookedUp, this, &ChatWidget::onResponseLookedUp);
+
+    connect(m_backend, &ChatBackend::textReceived, this, &ChatWidget::onStreamText);
+    connect(m_backend, &ChatBackend::retrying, this, &ChatWidget::onStreamRetrying);
+    connect(m_backend, &ChatBackend::finished, this, &ChatWidget::finishStreaming);
+
     connect(sendButton, &QPushButton::clicked, this, &ChatWidget::sendMessage);
+    connect(stopButton, &QPushButton::clicked, this, &ChatWidget::stopStreaming);
     connect(inputLine, &QLineEdit::returnPressed, this, &ChatWidget::sendMessage);
 }
 
-void ChatWidget::appendMessage(const QString &who, const QString &text, bool addToHistory)
+int ChatWidget::appendMessage(const QString &who, const QString &text, qint64 id)
 {
-    // Store in history if requested
-    if (addToHistory) {
-        m_chatHistory.append(qMakePair(who, text));
-    }
-    
-    QString html;
-    QString escapedText = text.toHtmlEscaped().replace("\n", "<br>");
-    // Render Markdown to HTML for model responses so formatting is preserved
-    QString renderedMarkdownHtml;
-    {
-        QTextDocument mdDoc;
-        mdDoc.setMarkdown(text);
-        renderedMarkdownHtml = mdDoc.toHtml();
-    }
-    
-    if (who == tr("You")) {
-        // User message - Design moderne avec fond violet solide
-        html = QString(
-            "<div style='text-align: right; margin: 12px 0;'>"
-            "<div style='"
-            "color: #b8b8c0;"
-            "font-size: 10px;"
-            "margin-bottom: 4px;"
-            "margin-right: 8px;"
-            "<span style='"
-            "color: white;"
-            "padding: 14px 18px;"
-            "border-radius: 20px 20px 4px 20px;"
-            "display: inline-block;"
-            "max-width: 75%%;"
-            "text-align: left;"
-            "font-size: 14px;"
-            "line-height: 1.5;"
-            "font-weight: 500;"
-            "'>%1</span>"
-            "</div>"
-        ).arg(escapedText);
-    } else if (who == tr("Gemini")) {
-        // Gemini response - Design élégant avec fond gris foncé solide
-        html = QString(
-            "<div style='text-align: left; margin: 12px 0;'>"
-            "<div style='"
-            "color: #8ab4f8;"
-            "font-size: 11px;"
-            "font-weight: 600;"
-            "margin-bottom: 6px;"
-            "margin-left: 6px;"
-            "letter-spacing: 0.5px;"
-            "'>✨ GEMINI AI</div>"
-            "<span style='"
-            "color: #e8e8e8;"
-            "padding: 14px 18px;"
-            "border-radius: 20px 20px 20px 4px;"
-            "border-left: 3px solid #8ab4f8;"
-            "display: inline-block;"
-            "max-width: 80%%;"
-            "text-align: left;"
-            "font-size: 14px;"
-            "line-height: 1.6;"
-            "'>%1</span>"
-            "</div>"
-        ).arg(renderedMarkdownHtml);
-    } else {
-        // System message - Design discret mais visible
-        html = QString(
-            "<div style='text-align: center; margin: 16px 0;'>"
-            "<span style='"
-            "background-color: #3a2a2a;"
-            "color: #f48771;"
-            "padding: 10px 16px;"
-            "border-radius: 16px;"
-            "border: 1px solid #f48771;"
-            "display: inline-block;"
-            "font-size: 12px;"
-            "font-weight: 500;"
-            "'>⚠️ %1</span>"
-            "</div>"
-        ).arg(escapedText);
-    }
-    
-    conversationView->append(html);
-    QScrollBar *sb = conversationView->verticalScrollBar();
-    if (sb) sb->setValue(sb->maximum());
+    const int row = m_transcript->append(id, who, text);
+    conversationView->scrollToBottom();
+    return row;
 }
 
 void ChatWidget::sendMessage()
@@ -256,109 +309,199 @@ void ChatWidget::sendMessage()
     QString text = inputLine->text().trimmed();
     if (text.isEmpty()) return;
 
-    appendMessage(tr("You"), text);
+    const int row = appendMessage(tr("You"), text);
     // Save user message to database
-    saveMessageToDb(tr("You"), text);
+    saveMessageToDb(row);
     inputLine->clear();
 
-    callGeminiApi(text);
+    // The request is sent once its context is assembled (off the GUI thread)
+    m_contextTicket = m_contextBuilder->build(contextRequest(text, row));
 }
 
+void ChatWidget::setCurrentEditor(CodeEditor *editor)
+{
+    m_editor = editor;
+}
 
-void ChatWidget::callGeminiApi(const QString &prompt)
+// The prompt, the conversation before `row` and the selection of the current editor
+ChatContextRequest ChatWidget::contextRequest(const QString &prompt, int row) const
 {
-    // Build request JSON according to the example REST call
-    QJsonObject partObj;
-    partObj["text"] = prompt;
+    ChatContextRequest request;
+    request.prompt = prompt;
+
+    const QString errorPrefix = tr("Error: %1").arg(QString());
+    for (int i = row - 1; i >= 0 && request.turns.size() < MaxContextTurns; --i) {
+        ChatMessage turn = m_transcript->at(i);
+        if (turn.sender == tr("You")) {
+            turn.sender = QStringLiteral("user");
+        } else if (turn.sender == tr("Gemini") && !turn.text.startsWith(errorPrefix)) {
+            turn.sender = QStringLiteral("model");
+        } else {
+            continue;
+        }
+        request.turns.prepend(turn);
+    }
 
-    QJsonArray partsArr;
-    partsArr.append(partObj);
+    if (m_editor) {
+        const QTextCursor cursor = m_editor->textCursor();
+        if (cursor.hasSelection()) {
+            request.selectionText = cursor.selectedText().replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+            request.selectionFirstLine = m_editor->document()->findBlock(cursor.selectionStart()).blockNumber() + 1;
+            const QString path = m_editor->property("filePath").toString();
+            if (!path.isEmpty()) {
+                const QString relative = QDir(m_projectDir).relativeFilePath(path);
+                request.selectionPath = relative.startsWith(QLatin1String("..")) ? path : relative;
+            }
+        }
+    }
+    return request;
+}
 
-    QJsonObject contentObj;
-    contentObj["parts"] = partsArr;
+void ChatWidget::onContextReady(quint64 ticket, const QJsonArray &contents)
+{
+    // A later message was sent meanwhile
+    if (ticket != m_contextTicket) return;
 
-    QJsonArray contentsArr;
-    contentsArr.append(contentObj);
+    const QByteArray key = responseKey(contents);
+    // The same request is already being answered, or looked up
+    if ((m_streamRequest && key == m_streamKey) || key == m_pendingKey) {
+        appendMessage(tr("System"), tr("This question is already being answered."));
+        return;
+    }
+    m_pendingKey = key;
+    m_pendingContents = contents;
+    if (m_backend->cacheable()) {
+        m_store->lookupResponse(key);
+    } else {
+        onResponseLookedUp(key, QString(), false);
+    }
+}
 
-    QJsonObject root;
-    root["contents"] = contentsArr;
+// Content address of a request: the backend, its model and everything it is
+// sent, turns included. The same question asked again in a conversation is a
+// miss: its turns differ, and so may the answer.
+QByteArray ChatWidget::responseKey(const QJsonArray &contents) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(m_backend->name().toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(m_backend->model().toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(QJsonDocument(contents).toJson(QJsonDocument::Compact));
+    return hash.result().toHex();
+}
 
-    QJsonDocument doc(root);
-    QByteArray body = doc.toJson();
+void ChatWidget::onResponseLookedUp(const QByteArray &key, const QString &response, bool found)
+{
+    if (key != m_pendingKey) return;
+    m_pendingKey.clear();
+    const QJsonArray contents = std::exchange(m_pendingContents, QJsonArray());
 
-    // Use gemini-1.5-flash model (more stable/available)
-    QUrl url("https://generativelanguage.googleapis.com/v1beta/models/gemini-2.0-flash-001:generateContent");
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    if (!found) {
+        requestAnswer(contents, key);
+        return;
+    }
+    // Answered before: shown at once, no request
+    stopStreaming();
+    saveMessageToDb(appendMessage(tr("Gemini"), response));
+}
 
-    // Read API key from environment variable GEMINI_API_KEY
-    QByteArray apiKey = qgetenv("GEMINI_API_KEY");
-    if (apiKey.isEmpty()) {
-        appendMessage(tr("System"), tr("GEMINI_API_KEY not set in environment. Set it and retry."));
+
+void ChatWidget::requestAnswer(const QJsonArray &contents, const QByteArray &key)
+{
+    const QString configurationError = m_backend->configurationError();
+    if (!configurationError.isEmpty()) {
+        appendMessage(tr("System"), configurationError);
         return;
     }
 
-    // The API expects x-goog-api-key header (per example). Set it here.
-    request.setRawHeader("x-goog-api-key", apiKey);
+    // One answer streams at a time (it is the last message of the view); the
+    // previous one keeps what it received
+    stopStreaming();
 
-    QNetworkReply *reply = networkManager->post(request, body);
+    m_streamRequest = m_backend->send(contents);
+    m_streamKey = key;
+    m_streamText.clear();
+    m_streamRow = QPersistentModelIndex();
+    sendButton->hide();
+    stopButton->show();
+}
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        QByteArray resp = reply->readAll();
-        
-        if (reply->error() != QNetworkReply::NoError) {
-            // Show error details including server response body for debugging
-            QString errMsg = reply->errorString();
-            if (!resp.isEmpty()) {
-                errMsg += QString("\nServer response: %1").arg(QString::fromUtf8(resp));
-            }
-            appendMessage(tr("Gemini"), tr("Error: %1").arg(errMsg));
-            reply->deleteLater();
-            return;
-        }
+void ChatWidget::onStreamText(int id, const QString &text)
+{
+    if (id != m_streamRequest) return;
+    m_streamText += text;
+    if (!m_streamRow.isValid()) {
+        renderStreamingMessage(); // first words right away
+    } else if (!m_streamRenderTimer->isActive()) {
+        m_streamRenderTimer->start();
+    }
+}
 
-        // Try to parse response JSON and extract text if available.
-        QJsonParseError err;
-        QJsonDocument jdoc = QJsonDocument::fromJson(resp, &err);
-        QString outText;
-        if (err.error == QJsonParseError::NoError && jdoc.isObject()) {
-            QJsonObject obj = jdoc.object();
-            
-            // Structure: { "candidates": [{ "content": { "parts": [{ "text": "..." }] } }] }
-            if (obj.contains("candidates") && obj["candidates"].isArray()) {
-                QJsonArray cand = obj["candidates"].toArray();
-                if (!cand.isEmpty() && cand[0].isObject()) {
-                    QJsonObject c0 = cand[0].toObject();
-                    if (c0.contains("content") && c0["content"].isObject()) {
-                        QJsonObject content = c0["content"].toObject();
-                        if (content.contains("parts") && content["parts"].isArray()) {
-                            QJsonArray parts = content["parts"].toArray();
-                            for (const QJsonValue &partVal : parts) {
-                                if (partVal.isObject()) {
-                                    QJsonObject part = partVal.toObject();
-                                    if (part.contains("text")) {
-                                        outText += part["text"].toString();
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+void ChatWidget::onStreamRetrying(int id, int attempt, int delayMs, const QString &reason)
+{
+    if (id != m_streamRequest) return;
+    appendMessage(tr("System"), tr("%1 - new attempt (%2) in %3 s.")
+                                    .arg(reason).arg(attempt).arg((delayMs + 999) / 1000));
+}
 
-            // Fallback: raw response
-            if (outText.isEmpty()) {
-                outText = QString::fromUtf8(resp);
-            }
-        } else {
-            outText = QString::fromUtf8(resp);
-        }
+// Stop button: the answer keeps what it received
+void ChatWidget::stopStreaming()
+{
+    if (m_streamRequest) m_backend->cancel(m_streamRequest);
+}
 
-        appendMessage(tr("Gemini"), outText);
-        // Save message to database immediately
-        saveMessageToDb(tr("Gemini"), outText);
-        reply->deleteLater();
-    });
+// Shows the answer received so far in its bubble
+void ChatWidget::renderStreamingMessage()
+{
+    QScrollBar *sb = conversationView->verticalScrollBar();
+    const bool followOutput = !sb || sb->value() >= sb->maximum() - 4;
+
+    if (m_streamRow.isValid()) {
+        m_transcript->setText(m_streamRow.row(), m_streamText);
+    } else {
+        m_streamRow = QPersistentModelIndex(m_transcript->index(m_transcript->append(0, tr("Gemini"), m_streamText)));
+    }
+
+    if (followOutput) conversationView->scrollToBottom();
+}
+
+void ChatWidget::finishStreaming(int id, const ChatRequestResult &result, const ChatBackendMetrics &metrics)
+{
+    if (id != m_streamRequest) return;
+    m_streamRequest = 0;
+    m_streamRenderTimer->stop();
+    stopButton->hide();
+    sendButton->show();
+
+    const bool complete = result.outcome == ChatRequestResult::Success;
+    if (complete) {
+        qInfo().noquote() << QStringLiteral("Chat answer (%1, %2): first token %3 ms, %4 ms, %5%6 tokens, %7 tokens/s")
+                                 .arg(m_backend->name(), m_backend->model())
+                                 .arg(metrics.firstTokenMs).arg(metrics.totalMs)
+                                 .arg(metrics.tokensEstimated ? QStringLiteral("~") : QString())
+                                 .arg(metrics.tokens).arg(metrics.tokensPerSecond(), 0, 'f', 1);
+    }
+
+    if (!m_streamText.isEmpty()) {
+        renderStreamingMessage();
+        // Save message to database once complete
+        saveMessageToDb(m_streamRow.row());
+        // Complete answers only are served again
+        if (complete && m_backend->cacheable()) {
+            m_store->storeResponse(m_streamKey, m_streamText);
+        }
+    }
+    m_streamKey.clear();
+    m_streamRow = QPersistentModelIndex();
+
+    if (result.outcome == ChatRequestResult::Failed || result.outcome == ChatRequestResult::TimedOut) {
+        QString errMsg = result.errorString;
+        if (result.attempts > 1) errMsg += tr(" (%1 attempts)").arg(result.attempts);
+        appendMessage(tr("Gemini"), tr("Error: %1").arg(errMsg));
+    } else if (m_streamText.isEmpty() && complete) {
+        appendMessage(tr("Gemini"), tr("Error: %1").arg(tr("empty response")));
+    }
 }
 
 ChatWidget::~ChatWidget()
@@ -379,6 +522,9 @@ void ChatWidget::setProjectDirectory(const QString &projectDir)
     // Initialize database for new project and load history
     initDatabase();
     loadChatHistory();
+
+    // Project code offered as context to the prompts
+    m_contextBuilder->setProjectDirectory(projectDir);
 }
 
 QString ChatWidget::databaseFilePath() const
@@ -390,85 +536,181 @@ QString ChatWidget::databaseFilePath() const
 void ChatWidget::initDatabase()
 {
     if (m_projectDir.isEmpty()) return;
-    
-    // Ensure .editerako directory exists
-    QDir dir(m_projectDir);
-    if (!dir.exists(".editerako")) {
-        dir.mkdir(".editerako");
-    }
-    
-    // Create database connection with unique name
-    m_db = QSqlDatabase::addDatabase("QSQLITE", m_dbConnectionName);
-    m_db.setDatabaseName(databaseFilePath());
-    
-    if (!m_db.open()) {
-        qWarning() << "Failed to open chat history database:" << m_db.lastError().text();
-        return;
-    }
-    
-    // Create table if not exists
-    QSqlQuery query(m_db);
-    query.exec(
-        "CREATE TABLE IF NOT EXISTS chat_messages ("
-        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  sender TEXT NOT NULL,"
-        "  message TEXT NOT NULL,"
-        "  timestamp DATETIME DEFAULT CURRENT_TIMESTAMP"
-        ")"
-    );
+
+    // Opened on the store's thread (directory and table created there)
+    m_store->open(databaseFilePath());
 }
 
 void ChatWidget::closeDatabase()
 {
-    if (m_db.isOpen()) {
-        m_db.close();
+    m_store->close();
+    m_unsavedRows.clear();
+}
+
+void ChatWidget::saveMessageToDb(int row)
+{
+    const ChatMessage &message = m_transcript->at(row);
+    const quint64 ticket = m_store->saveMessage(message.sender, message.text);
+    // The row gets its id when the message is committed
+    if (ticket) m_unsavedRows.insert(ticket, QPersistentModelIndex(m_transcript->index(row)));
+}
+
+void ChatWidget::onMessageSaved(quint64 ticket, qint64 id)
+{
+    const QPersistentModelIndex index = m_unsavedRows.take(ticket);
+    if (index.isValid()) m_transcript->setId(index.row(), id);
+}
+
+void ChatWidget::saveChatHistory()
+{
+    // Messages are saved as they come; this commits the ones still queued
+    m_store->flush();
+}
+
+void ChatWidget::loadChatHistory()
+{
+    if (!m_store->isOpen()) return;
+
+    // The last page only; older messages are loaded on scroll-up
+    m_hasOlderMessages = false;
+    m_loadingOlderMessages = true;
+    m_store->fetchPage(0, HistoryPageSize);
+}
+
+void ChatWidget::loadOlderMessages()
+{
+    if (!m_hasOlderMessages || m_loadingOlderMessages || !m_store->isOpen()) return;
+    const qint64 oldest = m_transcript->oldestId();
+    if (oldest <= 0) return;
+
+    m_loadingOlderMessages = true;
+    m_store->fetchPage(oldest, HistoryPageSize);
+}
+
+// A page of the history, from loadChatHistory (beforeId 0) or loadOlderMessages
+void ChatWidget::onPageLoaded(qint64 beforeId, const QVector<ChatMessage> &messages, bool hasMore)
+{
+    m_hasOlderMessages = hasMore;
+    QScrollBar *sb = conversationView->verticalScrollBar();
+    const int fromBottom = sb->maximum() - sb->value();
+    m_transcript->prepend(messages);
+    if (beforeId == 0) {
+        conversationView->scrollToBottom();
+    } else {
+        // Same messages on screen: the new rows push the content down
+        conversationView->doItemsLayout();
+        sb->setValue(sb->maximum() - fromBottom);
     }
-    // Remove connection
-    if (QSqlDatabase::contains(m_dbConnectionName)) {
-        QSqlDatabase::removeDatabase(m_dbConnectionName);
+    m_loadingOlderMessages = false;
+}
+
+void ChatWidget::searchHistory()
+{
+    const QString text = searchLine->text().trimmed();
+    if (text.isEmpty() || !m_store->isOpen()) {
+        searchResults->hide();
+        searchResults->clear();
+        conversationView->show();
+        return;
     }
+    m_store->search(text, MaxSearchResults);
 }
 
-void ChatWidget::saveMessageToDb(const QString &sender, const QString &text)
+void ChatWidget::onSearchFinished(const QString &text, const QVector<ChatSearchHit> &hits)
 {
-    if (!m_db.isOpen() || m_projectDir.isEmpty()) return;
-    
-    QSqlQuery query(m_db);
-    query.prepare("INSERT INTO chat_messages (sender, message) VALUES (:sender, :message)");
-    query.bindValue(":sender", sender);
-    query.bindValue(":message", text);
-    
-    if (!query.exec()) {
-        qWarning() << "Failed to save chat message:" << query.lastError().text();
+    // An older query, typed over since
+    if (text != searchLine->text().trimmed()) return;
+
+    QString html = QString("<div style='color: #7a7a85; font-size: 11px; margin-bottom: 8px;'>%1</div>")
+                       .arg(tr("%n result(s)", nullptr, hits.size()));
+    for (const ChatSearchHit &hit : hits) {
+        html += QString(
+            "<div style='margin: 0 0 12px 0;'>"
+            "<div style='color: #8ab4f8; font-size: 11px; font-weight: 600;'>%1"
+            " <span style='color: #7a7a85; font-weight: normal;'>%2</span></div>"
+            "<div style='color: #e8e8e8; font-size: 13px;'>%3</div>"
+            "</div>"
+        ).arg(hit.sender.toHtmlEscaped(), hit.timestamp.toHtmlEscaped(), hit.snippet);
     }
+    searchResults->setHtml(html);
+    conversationView->hide();
+    searchResults->show();
 }
 
-void ChatWidget::saveChatHistory()
+void ChatWidget::copySelectedMessages()
 {
-    // With SQLite, messages are saved immediately via saveMessageToDb
-    // This method is kept for compatibility but doesn't need to do anything
+    QModelIndexList rows = conversationView->selectionModel()->selectedRows();
+    if (rows.isEmpty()) return;
+    std::sort(rows.begin(), rows.end());
+    QStringList texts;
+    for (const QModelIndex &index : std::as_const(rows)) texts.append(index.data().toString());
+    QApplication::clipboard()->setText(texts.join("\n\n"));
 }
 
-void ChatWidget::loadChatHistory()
+void ChatWidget::showConversationMenu(const QPoint &pos, QAction *copyAction)
 {
-    if (!m_db.isOpen() || m_projectDir.isEmpty()) return;
-    
-    QSqlQuery query(m_db);
-    query.exec("SELECT sender, message FROM chat_messages ORDER BY id ASC");
-    
-    while (query.next()) {
-        QString sender = query.value(0).toString();
-        QString text = query.value(1).toString();
-        if (!sender.isEmpty() && !text.isEmpty()) {
-            m_chatHistory.append(qMakePair(sender, text));
-            // Add to view without re-adding to history/db
-            appendMessage(sender, text, false);
+    QMenu menu(this);
+    menu.addAction(copyAction);
+
+    const QModelIndex index = conversationView->indexAt(pos);
+    const QVector<ChatCodeBlock> blocks = index.isValid() ? ChatRenderer::codeBlocks(index.data().toString())
+                                                          : QVector<ChatCodeBlock>();
+    if (!blocks.isEmpty()) {
+        menu.addSeparator();
+        const bool toSelection = m_editor && m_editor->textCursor().hasSelection();
+        const QString target = !m_editor ? QString()
+                               : toSelection ? tr("la sélection")
+                                             : QFileInfo(m_editor->property("filePath").toString()).fileName();
+        for (int i = 0; i < blocks.size(); ++i) {
+            const ChatCodeBlock &block = blocks.at(i);
+            const QString what = blocks.size() == 1 ? tr("le code") : tr("le bloc de code %1").arg(i + 1);
+            QAction *apply = menu.addAction(target.isEmpty() ? tr("Appliquer %1").arg(what)
+                                                             : tr("Appliquer %1 à %2").arg(what, target));
+            // Read-only editors (a window on a large file) are not edited behind their back
+            apply->setEnabled(m_editor && !m_editor->isReadOnly());
+            connect(apply, &QAction::triggered, this, [this, block]() { applyCodeBlock(block.code); });
         }
     }
+    menu.exec(conversationView->viewport()->mapToGlobal(pos));
+}
+
+// Replaces the editor's selection, or its whole text, with `code`. Only the
+// lines that differ are edited, in one undo step, so cursors, bookmarks of
+// the document and the highlighting of the other lines stay as they are.
+void ChatWidget::applyCodeBlock(const QString &code)
+{
+    if (!m_editor || m_editor->isReadOnly()) return;
+    QTextDocument *document = m_editor->document();
+    const QTextCursor cursor = m_editor->textCursor();
+
+    int start = 0;
+    QString current;
+    if (cursor.hasSelection()) {
+        start = cursor.selectionStart();
+        current = cursor.selection().toPlainText();
+    } else {
+        current = document->toPlainText();
+    }
+    // The fence drops the final newline; the text it replaces keeps its own
+    QString replacement = code;
+    if (current.endsWith(QLatin1Char('\n')) && !replacement.endsWith(QLatin1Char('\n'))) {
+        replacement += QLatin1Char('\n');
+    }
+
+    QVector<TextReplacement> edits = LineDiff::replacements(current, replacement);
+    for (TextReplacement &edit : edits) edit.start += start;
+    SearchEngine::applyReplacements(document, edits);
 }
 
 void ChatWidget::clearChat()
 {
-    m_chatHistory.clear();
-    conversationView->clear();
+    // The answer being streamed belongs to the conversation going away
+    stopStreaming();
+    m_transcript->clear();
+    m_unsavedRows.clear();
+    m_pendingKey.clear();
+    m_pendingContents = QJsonArray();
+    searchLine->clear();
+    m_hasOlderMessages = false;
+    m_loadingOlderMessages = false;
 }
\ No newline at end of file
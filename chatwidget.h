@@ -2,14 +2,24 @@
 #define CHATWIDGET_H
 
 #include <QWidget>
-#include <QList>
-#include <QPair>
-#include <QSqlDatabase>
+#include <QVector>
+#include <QHash>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include "chattranscript.h"
+#include "chatstore.h"
+#include "chatcontext.h"
+#include "chatbackend.h"
 
-class QTextEdit;
+class QListView;
+class QTextBrowser;
+class CodeEditor;
 class QLineEdit;
 class QPushButton;
 class QNetworkAccessManager;
+class QTimer;
+class QAction;
+class QPoint;
 
 class ChatWidget : public QWidget {
     Q_OBJECT
@@ -27,29 +37,70 @@ public:
     void loadChatHistory();
     // Clear current conversation view and history
     void clearChat();
+    // Editor whose selection is sent along with the prompts
+    void setCurrentEditor(CodeEditor *editor);
 
 public slots:
     void sendMessage();
 
 private:
-    QTextEdit *conversationView;
+    QListView *conversationView;
+    ChatTranscriptModel *m_transcript;
+    QLineEdit *searchLine;
+    QTextBrowser *searchResults;
+    QTimer *m_searchTimer;
     QLineEdit *inputLine;
     QPushButton *sendButton;
+    QPushButton *stopButton;
     QNetworkAccessManager *networkManager;
+    ChatRequestManager *m_requests;
+    ChatBackend *m_backend;
 
     QString m_projectDir;
-    QSqlDatabase m_db;
-    QString m_dbConnectionName;
-    
-    // Store messages as pairs (sender, text) for persistence
-    QList<QPair<QString, QString>> m_chatHistory;
-
-    void appendMessage(const QString &who, const QString &text, bool addToHistory = true);
-    void callGeminiApi(const QString &prompt);
+    ChatStore *m_store;
+    ChatContextBuilder *m_contextBuilder;
+    quint64 m_contextTicket;    // of the last message sent
+    QPointer<CodeEditor> m_editor;
+    // Request waiting for the response cache lookup
+    QByteArray m_pendingKey;
+    QJsonArray m_pendingContents;
+    // Messages queued for saving, by ChatStore ticket
+    QHash<quint64, QPersistentModelIndex> m_unsavedRows;
+    // More history in the database before the first loaded message
+    bool m_hasOlderMessages;
+    bool m_loadingOlderMessages;
+
+    // Answer being streamed, shown in the m_streamRow bubble
+    int m_streamRequest;        // ChatBackend id, 0 if none
+    QString m_streamText;
+    QByteArray m_streamKey;     // response cache key of the request
+    QPersistentModelIndex m_streamRow;
+    QTimer *m_streamRenderTimer;
+
+    // `id`: database id of the message, 0 if it is not saved; returns its row
+    int appendMessage(const QString &who, const QString &text, qint64 id = 0);
+    ChatContextRequest contextRequest(const QString &prompt, int row) const;
+    void onContextReady(quint64 ticket, const QJsonArray &contents);
+    QByteArray responseKey(const QJsonArray &contents) const;
+    void onResponseLookedUp(const QByteArray &key, const QString &response, bool found);
+    void requestAnswer(const QJsonArray &contents, const QByteArray &key);
+    void renderStreamingMessage();
+    void onStreamText(int id, const QString &text);
+    void onStreamRetrying(int id, int attempt, int delayMs, const QString &reason);
+    void finishStreaming(int id, const ChatRequestResult &result, const ChatBackendMetrics &metrics);
+    void stopStreaming();
     QString databaseFilePath() const;
     void initDatabase();
     void closeDatabase();
-    void saveMessageToDb(const QString &sender, const QString &text);
+    void saveMessageToDb(int row);
+    void onMessageSaved(quint64 ticket, qint64 id);
+    void loadOlderMessages();
+    void onPageLoaded(qint64 beforeId, const QVector<ChatMessage> &messages, bool hasMore);
+    void searchHistory();
+    void onSearchFinished(const QString &text, const QVector<ChatSearchHit> &hits);
+    void copySelectedMessages();
+    void showConversationMenu(const QPoint &pos, QAction *copyAction);
+    void applyCodeBlock(const QString &code);
 };
 
 #endif // CHATWIDGET_H
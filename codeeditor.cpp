@@ -7,7 +7,7 @@
 #include <algorithm>
 #include <QVector>
 
-CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), lineNumbersVisible(true)
+CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), lineNumbersVisible(true), firstLineNumber(1)
 {
     lineNumberArea = new LineNumberArea(this);
 
@@ -26,7 +26,7 @@ int CodeEditor::lineNumberAreaWidth()
     }
 
     int digits = 1;
-    int max = qMax(1, blockCount());
+    qint64 max = qMax<qint64>(1, firstLineNumber + blockCount() - 1);
     while (max >= 10) {
         max /= 10;
         ++digits;
@@ -77,9 +77,17 @@ void CodeEditor::highlightCurrentLine()
         extraSelections.append(selection);
     }
 
+    extraSelections.append(searchSelections);
     setExtraSelections(extraSelections);
 }
 
+void CodeEditor::setSearchSelections(const QList<QTextEdit::ExtraSelection> &selections)
+{
+    if (selections.isEmpty() && searchSelections.isEmpty()) return;
+    searchSelections = selections;
+    highlightCurrentLine();
+}
+
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
     if (!lineNumbersVisible) {
@@ -90,13 +98,13 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
     painter.fillRect(event->rect(), QColor(45, 45, 48)); 
 
     QTextBlock block = firstVisibleBlock();
-    int blockNumber = block.blockNumber();
+    qint64 blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
 
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
+            QString number = QString::number(blockNumber + firstLineNumber);
             painter.setPen(QColor(128, 128, 128)); 
             painter.drawText(0, top, lineNumberArea->width() - 3, fontMetrics().height(),
                              Qt::AlignRight, number);
@@ -119,6 +127,13 @@ void CodeEditor::setLineNumbersVisible(bool visible)
     }
 }
 
+void CodeEditor::setFirstLineNumber(qint64 number)
+{
+    firstLineNumber = number;
+    updateLineNumberAreaWidth(0);
+    lineNumberArea->update();
+}
+
 // Normalize extra cursors: remove duplicates and any that equal the primary cursor, sort ascending
 void CodeEditor::normalizeExtraCursors()
 {
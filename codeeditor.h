@@ -24,6 +24,11 @@ public:
     int lineNumberAreaWidth();
     void setLineNumbersVisible(bool visible);
     bool isLineNumbersVisible() const;
+    // Number shown for the first block (views of a slice of a larger file)
+    void setFirstLineNumber(qint64 number);
+
+    // Extra selections drawn on top of the current line highlight (search matches, ...)
+    void setSearchSelections(const QList<QTextEdit::ExtraSelection> &selections);
 
 protected:
     // Multi-cursor support and keyboard handling
@@ -42,8 +47,10 @@ private slots:
 private:
     QWidget *lineNumberArea;
     bool lineNumbersVisible;
+    qint64 firstLineNumber;
     // Additional cursors for multi-cursor editing (excluding the primary cursor())
     QList<QTextCursor> extraCursors;
+    QList<QTextEdit::ExtraSelection> searchSelections;
 
     // Helpers for multi-cursor editing
     void normalizeExtraCursors();
@@ -0,0 +1,127 @@
+#include "commandhistory.h"
+#include <QDateTime>
+#include <algorithm>
+
+static quint64 trigramKey(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | quint64(c.unicode());
+}
+
+// The distinct trigrams of `text`, case-folded
+static QVector<quint64> trigramsOf(const QString &text)
+{
+    const QString folded = text.toCaseFolded();
+    QVector<quint64> keys;
+    keys.reserve(qMax<qsizetype>(0, folded.size() - 2));
+    for (qsizetype i = 0; i + 2 < folded.size(); ++i) {
+        keys.append(trigramKey(folded.at(i), folded.at(i + 1), folded.at(i + 2)));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+CommandHistory &CommandHistory::shared()
+{
+    static CommandHistory history;
+    return history;
+}
+
+int CommandHistory::previous(int position) const
+{
+    for (int i = qMin(position, end()) - 1; i >= 0; --i) {
+        if (!entries.at(i).command.isEmpty()) return i;
+    }
+    return -1;
+}
+
+int CommandHistory::next(int position) const
+{
+    for (int i = qMax(position + 1, 0); i < end(); ++i) {
+        if (!entries.at(i).command.isEmpty()) return i;
+    }
+    return end();
+}
+
+void CommandHistory::append(const HistoryEntry &entry)
+{
+    if (entry.command.isEmpty()) return;
+    auto it = positions.find(entry.command);
+    if (it != positions.end()) {
+        // Its trigrams still point there; the search skips empty lines
+        entries[it.value()].command.clear();
+        entries[it.value()].directory.clear();
+    }
+    const int position = end();
+    entries.append(entry);
+    positions.insert(entry.command, position);
+    indexLine(position);
+}
+
+HistoryEntry CommandHistory::add(const QString &command, const QString &directory)
+{
+    HistoryEntry entry;
+    entry.command = command;
+    entry.directory = directory;
+    entry.timestamp = QDateTime::currentSecsSinceEpoch();
+    append(entry);
+    return entry;
+}
+
+bool CommandHistory::setExitCode(const QString &command, int exitCode, HistoryEntry *updated)
+{
+    auto it = positions.constFind(command);
+    if (it == positions.cend()) return false;
+    HistoryEntry &entry = entries[it.value()];
+    entry.exitCode = exitCode;
+    if (updated) *updated = entry;
+    return true;
+}
+
+void CommandHistory::prepend(CommandHistory &&older)
+{
+    // Lines of this history are more recent than any of `older`
+    for (const HistoryEntry &entry : std::as_const(entries)) older.append(entry);
+    *this = std::move(older);
+}
+
+void CommandHistory::indexLine(int position)
+{
+    for (quint64 key : trigramsOf(entries.at(position).command)) {
+        trigrams[key].append(position);
+    }
+}
+
+int CommandHistory::searchBackward(const QString &query, int before) const
+{
+    before = qMin(before, end());
+    if (query.isEmpty()) return previous(before);
+
+    auto matches = [&](int i) {
+        const QString &command = entries.at(i).command;
+        return !command.isEmpty() && command.contains(query, Qt::CaseInsensitive);
+    };
+
+    const QVector<quint64> keys = trigramsOf(query);
+    if (keys.isEmpty()) {
+        // One or two characters: the most recent lines are likely to match
+        for (int i = before - 1; i >= 0; --i) {
+            if (matches(i)) return i;
+        }
+        return -1;
+    }
+
+    // Only the lines having the rarest trigram of the query are candidates
+    const QVector<int> *rarest = nullptr;
+    for (quint64 key : keys) {
+        auto it = trigrams.constFind(key);
+        if (it == trigrams.cend()) return -1;
+        if (!rarest || it->size() < rarest->size()) rarest = &it.value();
+    }
+    auto it = std::lower_bound(rarest->cbegin(), rarest->cend(), before);
+    while (it != rarest->cbegin()) {
+        --it;
+        if (matches(*it)) return *it;
+    }
+    return -1;
+}
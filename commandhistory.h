@@ -0,0 +1,58 @@
+#ifndef COMMANDHISTORY_H
+#define COMMANDHISTORY_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+struct HistoryEntry
+{
+    QString command;
+    QString directory;
+    qint64 timestamp = 0;       // seconds since the epoch, last run
+    int exitCode = -1;          // -1 while running or when not known
+};
+
+// Command lines run in the terminals, oldest first, each one only once:
+// running a line again moves it to the end. The position it leaves is kept
+// empty, so the positions held while stepping through the history stay valid.
+//
+// A trigram index (positions of the lines containing each case-folded
+// character triple) keeps the reverse search proportional to the number of
+// lines sharing the rarest trigram of the query, not to the history size.
+class CommandHistory
+{
+public:
+    // History shared by all tabs (GUI thread)
+    static CommandHistory &shared();
+
+    // One past the last position
+    int end() const { return static_cast<int>(entries.size()); }
+    bool isEmpty() const { return positions.isEmpty(); }
+    // Nearest used position before / after `position`; -1 / end() if none
+    int previous(int position) const;
+    int next(int position) const;
+    const HistoryEntry &at(int position) const { return entries.at(position); }
+
+    // Adds `entry` as the most recent line
+    void append(const HistoryEntry &entry);
+    // Records a run of `command`; returns the entry as it now is
+    HistoryEntry add(const QString &command, const QString &directory);
+    // Exit code of the last run of `command`; false if it is not in the history
+    bool setExitCode(const QString &command, int exitCode, HistoryEntry *updated = nullptr);
+    // Puts `older` (read from disk) before the lines of this history
+    void prepend(CommandHistory &&older);
+
+    // Most recent position before `before` whose line contains `query`
+    // (case-insensitive), -1 if there is none
+    int searchBackward(const QString &query, int before) const;
+
+private:
+    QVector<HistoryEntry> entries;      // an empty command marks a line run again later
+    QHash<QString, int> positions;
+    QHash<quint64, QVector<int>> trigrams;
+
+    void indexLine(int position);
+};
+
+#endif // COMMANDHISTORY_H
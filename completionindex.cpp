@@ -0,0 +1,232 @@
+#include "completionindex.h"
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
+
+// A use counts half as much after a week
+static const double FrecencyHalfLife = 7 * 24 * 3600.0;
+
+static double decayed(double frecency, qint64 stamp, qint64 now)
+{
+    if (frecency <= 0) return 0;
+    return frecency * std::exp2(-double(now - stamp) / FrecencyHalfLife);
+}
+
+// Quality of `query` as a subsequence of `key` in (0, 2], or 0 if it is not
+// one: dense matches and matches at the start of the key rank first.
+static double fuzzyScore(const QString &key, const QString &query)
+{
+    int first = -1;
+    int pos = 0;
+    for (QChar c : query) {
+        pos = key.indexOf(c, pos);
+        if (pos < 0) return 0;
+        if (first < 0) first = pos;
+        ++pos;
+    }
+    const double density = double(query.size()) / double(pos - first);
+    return density + (first == 0 ? 1.0 : 0.0);
+}
+
+CompletionIndex &CompletionIndex::instance()
+{
+    static CompletionIndex index;
+    return index;
+}
+
+QVector<CompletionIndex::Entry>::const_iterator CompletionIndex::Table::lowerBound(const QString &key) const
+{
+    return std::lower_bound(entries.cbegin(), entries.cend(), key,
+                            [](const Entry &e, const QString &k) { return e.key < k; });
+}
+
+int CompletionIndex::Table::merge(const QStringList &texts)
+{
+    QVector<Entry> added;
+    for (const QString &text : texts) {
+        if (text.isEmpty()) continue;
+        Entry entry;
+        entry.key = text.toCaseFolded();
+        entry.text = text;
+        added.append(entry);
+    }
+    auto byKey = [](const Entry &a, const Entry &b) {
+        return a.key < b.key || (a.key == b.key && a.text < b.text);
+    };
+    std::sort(added.begin(), added.end(), byKey);
+
+    // One merge of two sorted arrays; known entries keep their frecency
+    QVector<Entry> merged;
+    merged.reserve(entries.size() + added.size());
+    int count = 0;
+    auto a = entries.cbegin();
+    auto b = added.cbegin();
+    while (a != entries.cend() || b != added.cend()) {
+        if (b == added.cend() || (a != entries.cend() && !byKey(*b, *a))) {
+            if (b != added.cend() && a->text == b->text) ++b;
+            merged.append(*a++);
+        } else {
+            if (merged.isEmpty() || merged.last().text != b->text) {
+                merged.append(*b);
+                ++count;
+            }
+            ++b;
+        }
+    }
+    entries.swap(merged);
+    return count;
+}
+
+// Position of `text`, -1 if it is not there and `insert` is not set
+int CompletionIndex::Table::find(const QString &text, bool insert)
+{
+    const QString key = text.toCaseFolded();
+    auto it = lowerBound(key);
+    while (it != entries.cend() && it->key == key && it->text != text) ++it;
+    const int i = static_cast<int>(it - entries.cbegin());
+    if (it == entries.cend() || it->text != text) {
+        if (!insert) return -1;
+        Entry entry;
+        entry.key = key;
+        entry.text = text;
+        entries.insert(i, entry);
+    }
+    return i;
+}
+
+const CompletionIndex::Entry *CompletionIndex::Table::touch(const QString &text, qint64 now, bool insert)
+{
+    const int i = find(text, insert);
+    if (i < 0) return nullptr;
+    Entry &entry = entries[i];
+    entry.frecency = decayed(entry.frecency, entry.stamp, now) + 1.0;
+    entry.stamp = now;
+    return &entry;
+}
+
+void CompletionIndex::Table::restore(const QString &text, double frecency, qint64 stamp)
+{
+    Entry &entry = entries[find(text, true)];
+    if (stamp < entry.stamp) return;
+    entry.frecency = frecency;
+    entry.stamp = stamp;
+}
+
+QStringList CompletionIndex::Table::texts() const
+{
+    QStringList result;
+    result.reserve(entries.size());
+    for (const Entry &e : entries) result.append(e.text);
+    return result;
+}
+
+QStringList CompletionIndex::Table::complete(const QString &partial, int limit, qint64 now, bool fuzzy) const
+{
+    struct Candidate {
+        const Entry *entry;
+        double score;
+    };
+    QVector<Candidate> candidates;
+    const QString key = partial.toCaseFolded();
+
+    // Prefix matches: one contiguous range of the sorted array
+    for (auto it = lowerBound(key); it != entries.cend() && it->key.startsWith(key); ++it) {
+        candidates.append({ &*it, decayed(it->frecency, it->stamp, now) });
+    }
+
+    // Nothing starts with it: fall back to subsequence matches
+    if (fuzzy && candidates.isEmpty() && key.size() >= 2) {
+        for (const Entry &e : entries) {
+            const double quality = fuzzyScore(e.key, key);
+            if (quality > 0) candidates.append({ &e, quality + std::log1p(decayed(e.frecency, e.stamp, now)) });
+        }
+    }
+
+    // Best first; equal scores keep the alphabetical order of the array
+    const int n = qMin(limit, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+                      [](const Candidate &a, const Candidate &b) {
+                          return a.score > b.score || (a.score == b.score && a.entry < b.entry);
+                      });
+    QStringList result;
+    result.reserve(n);
+    for (int i = 0; i < n; ++i) result.append(candidates.at(i).entry->text);
+    return result;
+}
+
+int CompletionIndex::addCommands(const QStringList &commands)
+{
+    return commandTable.merge(commands);
+}
+
+QStringList CompletionIndex::commands() const
+{
+    return commandTable.texts();
+}
+
+bool CompletionIndex::hasArguments(const QString &command) const
+{
+    return argumentsKnown.contains(command);
+}
+
+void CompletionIndex::setArguments(const QString &command, const QStringList &arguments)
+{
+    argumentTables[command].merge(arguments);
+    argumentsKnown.insert(command);
+}
+
+QStringList CompletionIndex::arguments(const QString &command) const
+{
+    auto it = argumentTables.constFind(command);
+    return it == argumentTables.cend() ? QStringList() : it->texts();
+}
+
+QVector<CompletionUsage> CompletionIndex::recordCommandLine(const QString &line)
+{
+    QVector<CompletionUsage> usage;
+    const QStringList words = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    if (words.isEmpty()) return usage;
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const QString &command = words.first();
+    const Entry *entry = commandTable.touch(command, now, true);
+    usage.append({ command, QString(), entry->frecency, entry->stamp });
+    for (int i = 1; i < words.size(); ++i) {
+        const QString &word = words.at(i);
+        // Options, and a known subcommand right after the command (git commit);
+        // file names are left to the path completion
+        entry = nullptr;
+        if (word.startsWith(QLatin1Char('-'))) {
+            entry = argumentTables[command].touch(word, now, true);
+        } else if (i == 1 && argumentTables.contains(command)) {
+            entry = argumentTables[command].touch(word, now, false);
+        }
+        if (entry) usage.append({ command, word, entry->frecency, entry->stamp });
+    }
+    return usage;
+}
+
+void CompletionIndex::restoreUsage(const QVector<CompletionUsage> &usage)
+{
+    for (const CompletionUsage &u : usage) {
+        if (u.argument.isEmpty()) {
+            commandTable.restore(u.command, u.frecency, u.stamp);
+        } else {
+            argumentTables[u.command].restore(u.argument, u.frecency, u.stamp);
+        }
+    }
+}
+
+QStringList CompletionIndex::completeCommand(const QString &partial, int limit) const
+{
+    return commandTable.complete(partial, limit, QDateTime::currentSecsSinceEpoch(), true);
+}
+
+QStringList CompletionIndex::completeArgument(const QString &command, const QString &partial, int limit) const
+{
+    auto it = argumentTables.constFind(command);
+    if (it == argumentTables.cend()) return QStringList();
+    // Fuzzy matches of options only: other words may be paths, completed elsewhere
+    return it->complete(partial, limit, QDateTime::currentSecsSinceEpoch(),
+                        partial.startsWith(QLatin1Char('-')));
+}
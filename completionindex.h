@@ -0,0 +1,82 @@
+#ifndef COMPLETIONINDEX_H
+#define COMPLETIONINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+// Ranking state of one candidate, as saved by the CompletionStore
+struct CompletionUsage
+{
+    QString command;
+    QString argument;           // empty: the command itself
+    double frecency = 0;
+    qint64 stamp = 0;
+};
+
+// Completion candidates shared by all terminal tabs: commands (built-in list,
+// $PATH, history) and the arguments of each command.
+//
+// Every table is an array sorted on the case-folded text, so the candidates
+// for a prefix are one contiguous range found by binary search. They are
+// ranked by frecency (how often and how recently they were used); when no
+// candidate starts with what was typed, a subsequence ("fuzzy") match over
+// the table is used instead. GUI thread only.
+class CompletionIndex
+{
+public:
+    static CompletionIndex &instance();
+
+    // Returns how many of them were not known yet
+    int addCommands(const QStringList &commands);
+    QStringList commands() const;
+
+    // True once the arguments of `command` were loaded or scanned (even if none were found)
+    bool hasArguments(const QString &command) const;
+    void setArguments(const QString &command, const QStringList &arguments);
+    QStringList arguments(const QString &command) const;
+
+    // A command line was run: its command and its options rank higher from
+    // now on. Returns the new ranking state of what was touched.
+    QVector<CompletionUsage> recordCommandLine(const QString &line);
+    // Ranking state read back from the store; newer state in the index wins
+    void restoreUsage(const QVector<CompletionUsage> &usage);
+
+    QStringList completeCommand(const QString &partial, int limit) const;
+    QStringList completeArgument(const QString &command, const QString &partial, int limit) const;
+
+private:
+    CompletionIndex() = default;
+
+    struct Entry {
+        QString key;            // case-folded text, sort key
+        QString text;
+        double frecency = 0;    // uses, decayed with a half-life, as of `stamp`
+        qint64 stamp = 0;
+    };
+
+    class Table
+    {
+    public:
+        int merge(const QStringList &texts);
+        // Counts one use; an unknown text is added only if `insert` is set
+        const Entry *touch(const QString &text, qint64 now, bool insert);
+        void restore(const QString &text, double frecency, qint64 stamp);
+        QStringList texts() const;
+        QStringList complete(const QString &partial, int limit, qint64 now, bool fuzzy) const;
+
+    private:
+        QVector<Entry> entries;
+
+        QVector<Entry>::const_iterator lowerBound(const QString &key) const;
+        int find(const QString &text, bool insert);
+    };
+
+    Table commandTable;
+    QHash<QString, Table> argumentTables;
+    QSet<QString> argumentsKnown;
+};
+
+#endif // COMPLETIONINDEX_H
@@ -0,0 +1,314 @@
+#include "completionstore.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <memory>
+
+static const char *ConnectionName = "completion_store";
+// Writes wait this long for the ones that follow
+static const int CommitDelay = 1000;
+
+namespace {
+struct Snapshot {
+    QStringList commands;
+    QHash<QString, QStringList> arguments;
+    QVector<CompletionUsage> usage;
+    CommandHistory history;
+};
+}
+
+// Everything below runs on the worker thread
+
+static QString storeDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+}
+
+// The text files used before the database: commands_cache.txt and one args_<command>.txt per command
+static void importCacheFiles(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.exec("PRAGMA user_version");
+    if (query.next() && query.value(0).toInt() > 0) return;
+
+    QDir dir(storeDirectory());
+    QStringList imported;
+    db.transaction();
+
+    QFile commandsFile(dir.filePath("commands_cache.txt"));
+    if (commandsFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        query.prepare("INSERT OR IGNORE INTO commands (name) VALUES (?)");
+        QTextStream in(&commandsFile);
+        while (!in.atEnd()) {
+            const QString line = in.readLine().trimmed();
+            if (line.isEmpty()) continue;
+            query.addBindValue(line);
+            query.exec();
+        }
+        imported << commandsFile.fileName();
+    }
+
+    const QFileInfoList argumentFiles = dir.entryInfoList(QStringList() << "args_*.txt", QDir::Files);
+    for (const QFileInfo &info : argumentFiles) {
+        QFile f(info.absoluteFilePath());
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) continue;
+        const QString command = info.completeBaseName().mid(5);
+        query.prepare("INSERT OR IGNORE INTO argument_scans (command) VALUES (?)");
+        query.addBindValue(command);
+        query.exec();
+        query.prepare("INSERT OR IGNORE INTO arguments (command, argument) VALUES (?, ?)");
+        QTextStream in(&f);
+        while (!in.atEnd()) {
+            const QString line = in.readLine().trimmed();
+            if (line.isEmpty()) continue;
+            query.addBindValue(command);
+            query.addBindValue(line);
+            query.exec();
+        }
+        imported << f.fileName();
+    }
+
+    query.exec("PRAGMA user_version = 1");
+    if (!db.commit()) {
+        qWarning() << "Failed to import the completion cache:" << db.lastError().text();
+        return;
+    }
+    for (const QString &file : std::as_const(imported)) QFile::remove(file);
+}
+
+static bool openDatabase()
+{
+    QDir().mkpath(storeDirectory());
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", ConnectionName);
+    db.setDatabaseName(QDir(storeDirectory()).filePath("terminal.db"));
+    // Another instance of the editor may be committing
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=2000");
+    if (!db.open()) {
+        qWarning() << "Failed to open the completion database:" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    // Readers never wait for a writer; a commit is one append to the log
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+    query.exec("CREATE TABLE IF NOT EXISTS commands ("
+               "  name TEXT PRIMARY KEY"
+               ") WITHOUT ROWID");
+    query.exec("CREATE TABLE IF NOT EXISTS arguments ("
+               "  command TEXT NOT NULL,"
+               "  argument TEXT NOT NULL,"
+               "  PRIMARY KEY (command, argument)"
+               ") WITHOUT ROWID");
+    // Commands whose arguments were looked for, found or not
+    query.exec("CREATE TABLE IF NOT EXISTS argument_scans ("
+               "  command TEXT PRIMARY KEY"
+               ") WITHOUT ROWID");
+    query.exec("CREATE TABLE IF NOT EXISTS usage ("
+               "  command TEXT NOT NULL,"
+               "  argument TEXT NOT NULL,"
+               "  frecency REAL NOT NULL,"
+               "  stamp INTEGER NOT NULL,"
+               "  PRIMARY KEY (command, argument)"
+               ") WITHOUT ROWID");
+    // One row per distinct command line, with its last run
+    query.exec("CREATE TABLE IF NOT EXISTS history ("
+               "  command TEXT PRIMARY KEY,"
+               "  directory TEXT NOT NULL,"
+               "  timestamp INTEGER NOT NULL,"
+               "  exit_code INTEGER NOT NULL"
+               ")");
+    query.exec("CREATE INDEX IF NOT EXISTS history_timestamp ON history (timestamp)");
+
+    importCacheFiles(db);
+    return true;
+}
+
+static Snapshot readDatabase()
+{
+    Snapshot snapshot;
+    QSqlDatabase db = QSqlDatabase::database(ConnectionName);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    query.exec("SELECT name FROM commands");
+    while (query.next()) snapshot.commands << query.value(0).toString();
+
+    query.exec("SELECT command FROM argument_scans");
+    while (query.next()) snapshot.arguments.insert(query.value(0).toString(), QStringList());
+    query.exec("SELECT command, argument FROM arguments");
+    while (query.next()) snapshot.arguments[query.value(0).toString()] << query.value(1).toString();
+
+    query.exec("SELECT command, argument, frecency, stamp FROM usage");
+    while (query.next()) {
+        snapshot.usage.append({ query.value(0).toString(), query.value(1).toString(),
+                                query.value(2).toDouble(), query.value(3).toLongLong() });
+    }
+
+    query.exec("SELECT command, directory, timestamp, exit_code FROM history ORDER BY timestamp");
+    while (query.next()) {
+        HistoryEntry entry;
+        entry.command = query.value(0).toString();
+        entry.directory = query.value(1).toString();
+        entry.timestamp = query.value(2).toLongLong();
+        entry.exitCode = query.value(3).toInt();
+        snapshot.history.append(entry);
+    }
+    return snapshot;
+}
+
+static void writeDatabase(const QStringList &commands, const QHash<QString, QStringList> &arguments,
+                          const QVector<CompletionUsage> &usage, const QHash<QString, HistoryEntry> &history)
+{
+    QSqlDatabase db = QSqlDatabase::database(ConnectionName);
+    if (!db.isOpen()) return;
+
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO commands (name) VALUES (?)");
+    for (const QString &command : commands) {
+        query.addBindValue(command);
+        query.exec();
+    }
+
+    for (auto it = arguments.cbegin(); it != arguments.cend(); ++it) {
+        query.prepare("INSERT OR IGNORE INTO argument_scans (command) VALUES (?)");
+        query.addBindValue(it.key());
+        query.exec();
+        query.prepare("INSERT OR IGNORE INTO arguments (command, argument) VALUES (?, ?)");
+        for (const QString &argument : it.value()) {
+            query.addBindValue(it.key());
+            query.addBindValue(argument);
+            query.exec();
+        }
+    }
+
+    // Another instance may have saved a more recent state meanwhile
+    query.prepare("INSERT INTO usage (command, argument, frecency, stamp) VALUES (?, ?, ?, ?) "
+                  "ON CONFLICT (command, argument) DO UPDATE SET "
+                  "frecency = excluded.frecency, stamp = excluded.stamp "
+                  "WHERE excluded.stamp >= usage.stamp");
+    for (const CompletionUsage &u : usage) {
+        query.addBindValue(u.command);
+        query.addBindValue(u.argument);
+        query.addBindValue(u.frecency);
+        query.addBindValue(u.stamp);
+        query.exec();
+    }
+
+    query.prepare("INSERT INTO history (command, directory, timestamp, exit_code) VALUES (?, ?, ?, ?) "
+                  "ON CONFLICT (command) DO UPDATE SET "
+                  "directory = excluded.directory, timestamp = excluded.timestamp, "
+                  "exit_code = excluded.exit_code "
+                  "WHERE excluded.timestamp >= history.timestamp");
+    for (const HistoryEntry &entry : history) {
+        query.addBindValue(entry.command);
+        query.addBindValue(entry.directory);
+        query.addBindValue(entry.timestamp);
+        query.addBindValue(entry.exitCode);
+        query.exec();
+    }
+
+    if (!db.commit()) {
+        qWarning() << "Failed to save completions:" << db.lastError().text();
+    }
+}
+
+static void closeDatabase()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(ConnectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(ConnectionName);
+}
+
+// GUI thread
+
+CompletionStore &CompletionStore::instance()
+{
+    static CompletionStore *store = new CompletionStore(QCoreApplication::instance());
+    return *store;
+}
+
+CompletionStore::CompletionStore(QObject *parent)
+    : QObject(parent)
+    , thread(new QThread(this))
+    , worker(new QObject)
+    , committer(this, CommitDelay, [this]() { commit(); })
+    , loadedFlag(false)
+{
+    thread->setObjectName("CompletionStore");
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start();
+
+    QMetaObject::invokeMethod(worker, [this]() {
+        auto snapshot = std::make_shared<Snapshot>();
+        if (openDatabase()) *snapshot = readDatabase();
+        QMetaObject::invokeMethod(this, [this, snapshot]() {
+            CompletionIndex &index = CompletionIndex::instance();
+            index.addCommands(snapshot->commands);
+            for (auto it = snapshot->arguments.cbegin(); it != snapshot->arguments.cend(); ++it) {
+                index.setArguments(it.key(), it.value());
+            }
+            index.restoreUsage(snapshot->usage);
+            CommandHistory::shared().prepend(std::move(snapshot->history));
+            loadedFlag = true;
+            emit loaded();
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+CompletionStore::~CompletionStore()
+{
+    committer.flush();
+    QMetaObject::invokeMethod(worker, []() { closeDatabase(); }, Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+}
+
+void CompletionStore::addCommands(const QStringList &commands)
+{
+    pending.commands += commands;
+    committer.schedule();
+}
+
+void CompletionStore::setArguments(const QString &command, const QStringList &arguments)
+{
+    pending.arguments[command] += arguments;
+    committer.schedule();
+}
+
+void CompletionStore::saveUsage(const QVector<CompletionUsage> &usage)
+{
+    pending.usage += usage;
+    committer.schedule();
+}
+
+void CompletionStore::saveHistory(const HistoryEntry &entry)
+{
+    pending.history.insert(entry.command, entry);
+    committer.schedule();
+}
+
+void CompletionStore::commit()
+{
+    if (pending.commands.isEmpty() && pending.arguments.isEmpty() && pending.usage.isEmpty()
+        && pending.history.isEmpty()) {
+        return;
+    }
+    PendingWrites writes;
+    std::swap(writes, pending);
+    QMetaObject::invokeMethod(worker, [writes]() {
+        writeDatabase(writes.commands, writes.arguments, writes.usage, writes.history);
+    }, Qt::QueuedConnection);
+}
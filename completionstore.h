@@ -0,0 +1,64 @@
+#ifndef COMPLETIONSTORE_H
+#define COMPLETIONSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "groupcommit.h"
+#include "completionindex.h"
+#include "commandhistory.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+// Persistent side of the CompletionIndex and of the CommandHistory: commands,
+// the arguments found for each command, the ranking state and the command
+// lines run, in one SQLite database (WAL mode) in the application data
+// directory, shared by all tabs and by every running instance of the editor.
+//
+// The database is read once per process on a worker thread (the history
+// index is built there too) and merged into the shared objects when done. Writes are queued and committed together, in one
+// transaction on the worker thread, shortly after the first of them.
+// GUI thread only.
+class CompletionStore : public QObject
+{
+    Q_OBJECT
+public:
+    static CompletionStore &instance();
+    ~CompletionStore();
+
+    // False until the saved data is in the CompletionIndex and the CommandHistory
+    bool isLoaded() const { return loadedFlag; }
+
+    void addCommands(const QStringList &commands);
+    // `arguments` may be empty: the command was scanned and nothing was found
+    void setArguments(const QString &command, const QStringList &arguments);
+    void saveUsage(const QVector<CompletionUsage> &usage);
+    void saveHistory(const HistoryEntry &entry);
+
+signals:
+    void loaded();
+
+private:
+    explicit CompletionStore(QObject *parent);
+
+    struct PendingWrites {
+        QStringList commands;
+        QHash<QString, QStringList> arguments;
+        QVector<CompletionUsage> usage;
+        QHash<QString, HistoryEntry> history;
+    };
+
+    QThread *thread;
+    QObject *worker;            // lives on `thread`, owns the database connection
+    GroupCommit committer;
+    PendingWrites pending;
+    bool loadedFlag;
+
+    void commit();
+};
+
+#endif // COMPLETIONSTORE_H
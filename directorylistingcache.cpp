@@ -0,0 +1,147 @@
+#include "directorylistingcache.h"
+#include <QCoreApplication>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+#include <QFile>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <QDirIterator>
+#include <QFileInfo>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Directories kept (and watched) at most
+static const int MaxListings = 64;
+// A listing older than this is read again on its next lookup (it is still served meanwhile)
+static const int MaxListingAge = 5000;
+
+namespace {
+struct ReadResult {
+    QVector<DirectoryEntry> entries;
+    bool ok = false;
+};
+}
+
+// Runs on the pool
+static ReadResult readDirectory(const QString &path)
+{
+    ReadResult result;
+#ifdef Q_OS_WIN
+    // The attributes come with the directory listing (FindNextFile), no extra query
+    QDirIterator it(path, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        result.entries.append({ info.fileName(), info.isDir() });
+    }
+    result.ok = QFileInfo(path).isDir();
+#else
+    DIR *dir = ::opendir(QFile::encodeName(path).constData());
+    if (!dir) return result;
+    while (const dirent *e = ::readdir(dir)) {
+        const char *name = e->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        bool isDirectory = false;
+        switch (e->d_type) {
+        case DT_DIR:
+            isDirectory = true;
+            break;
+        case DT_LNK:
+        case DT_UNKNOWN: {
+            // Links are completed like their target; some file systems do not fill d_type
+            struct stat st;
+            isDirectory = ::fstatat(::dirfd(dir), name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+            break;
+        }
+        default:
+            break;
+        }
+        result.entries.append({ QFile::decodeName(name), isDirectory });
+    }
+    ::closedir(dir);
+    result.ok = true;
+#endif
+    std::sort(result.entries.begin(), result.entries.end(),
+              [](const DirectoryEntry &a, const DirectoryEntry &b) {
+                  return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+              });
+    return result;
+}
+
+DirectoryListingCache &DirectoryListingCache::instance()
+{
+    static DirectoryListingCache *cache = new DirectoryListingCache(QCoreApplication::instance());
+    return *cache;
+}
+
+DirectoryListingCache::DirectoryListingCache(QObject *parent)
+    : QObject(parent)
+    , watcher(new QFileSystemWatcher(this))
+    , useCounter(0)
+{
+    pool.setMaxThreadCount(2);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, [this](const QString &path) {
+        auto it = listings.find(path);
+        if (it == listings.end()) return;
+        it->stale = true;
+        if (!it->loading) refresh(path);
+    });
+}
+
+QVector<DirectoryEntry> DirectoryListingCache::entries(const QString &path, bool *ready)
+{
+    if (!listings.contains(path)) evict();
+    Listing &listing = listings[path];
+    listing.lastUsed = ++useCounter;
+
+    const bool outdated = !listing.readTime.isValid() || listing.stale
+                          || listing.readTime.hasExpired(MaxListingAge);
+    if (outdated && !listing.loading) refresh(path);
+
+    if (ready) *ready = listing.readTime.isValid();
+    return listing.entries;
+}
+
+void DirectoryListingCache::refresh(const QString &path)
+{
+    Listing &listing = listings[path];
+    listing.loading = true;
+    listing.stale = false;
+
+    auto *futureWatcher = new QFutureWatcher<ReadResult>(this);
+    connect(futureWatcher, &QFutureWatcher<ReadResult>::finished, this, [this, path, futureWatcher]() {
+        futureWatcher->deleteLater();
+        auto it = listings.find(path);
+        if (it == listings.end()) return; // evicted meanwhile
+
+        const ReadResult result = futureWatcher->result();
+        it->entries = result.entries;
+        it->readTime.start();
+        it->loading = false;
+        if (result.ok && !it->watched) {
+            it->watched = watcher->addPath(path);
+        }
+        const bool changedWhileReading = it->stale;
+        emit listingUpdated(path);
+        if (changedWhileReading) refresh(path);
+    });
+    futureWatcher->setFuture(QtConcurrent::run(&pool, readDirectory, path));
+}
+
+// Make room for one more listing: the least recently used one goes
+void DirectoryListingCache::evict()
+{
+    if (listings.size() < MaxListings) return;
+    auto oldest = listings.end();
+    for (auto it = listings.begin(); it != listings.end(); ++it) {
+        if (it->loading) continue;
+        if (oldest == listings.end() || it->lastUsed < oldest->lastUsed) oldest = it;
+    }
+    if (oldest == listings.end()) return;
+    if (oldest->watched) watcher->removePath(oldest.key());
+    listings.erase(oldest);
+}
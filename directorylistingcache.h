@@ -0,0 +1,64 @@
+#ifndef DIRECTORYLISTINGCACHE_H
+#define DIRECTORYLISTINGCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QThreadPool>
+
+QT_BEGIN_NAMESPACE
+class QFileSystemWatcher;
+QT_END_NAMESPACE
+
+struct DirectoryEntry
+{
+    QString name;
+    bool isDirectory = false;   // symbolic links to directories too
+};
+
+// Directory listings for the path completion of the terminals.
+//
+// A lookup never touches the disk: it returns what is cached (possibly
+// nothing yet, possibly outdated) and, when needed, reads the directory again
+// on a small thread pool of its own, so a slow network mount never blocks a
+// keystroke nor the global pool. Listings are refreshed when a file system
+// watcher reports a change, or when they are older than a few seconds (for
+// file systems without change notification); listingUpdated() tells when a
+// new listing is in. On Unix entries are typed from readdir() (d_type), with
+// no stat per entry. GUI thread only.
+class DirectoryListingCache : public QObject
+{
+    Q_OBJECT
+public:
+    static DirectoryListingCache &instance();
+
+    // `ready` is set to false while the first listing of `path` is being read
+    QVector<DirectoryEntry> entries(const QString &path, bool *ready = nullptr);
+
+signals:
+    void listingUpdated(const QString &path);
+
+private:
+    explicit DirectoryListingCache(QObject *parent);
+
+    struct Listing {
+        QVector<DirectoryEntry> entries;
+        QElapsedTimer readTime;     // invalid until read once
+        quint64 lastUsed = 0;
+        bool loading = false;
+        bool stale = false;         // changed since (or while) it was read
+        bool watched = false;
+    };
+
+    QHash<QString, Listing> listings;
+    QFileSystemWatcher *watcher;
+    QThreadPool pool;
+    quint64 useCounter;
+
+    void refresh(const QString &path);
+    void evict();
+};
+
+#endif // DIRECTORYLISTINGCACHE_H
@@ -0,0 +1,248 @@
+#include "disksearchdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QLocale>
+#include <QtConcurrent/QtConcurrent>
+
+// The hit list is the only thing that grows with the file; keep it bounded
+static const int MaxHits = 10000;
+
+DiskSearchDialog::DiskSearchDialog(const QString &filePath, QWidget *parent)
+    : QDialog(parent), watcher(new QFutureWatcher<LargeFileSearch::LineHit>(this))
+{
+    setWindowTitle(tr("Search File on Disk"));
+    setMinimumSize(720, 480);
+
+    setStyleSheet(
+        "QDialog {"
+        "    background-color: #1e1e1e;"
+        "    color: #cccccc;"
+        "}"
+        "QLabel {"
+        "    color: #cccccc;"
+        "    font-size: 12px;"
+        "}"
+        "QLineEdit {"
+        "    background-color: #3e3e42;"
+        "    border: 1px solid #6f6f6f;"
+        "    border-radius: 4px;"
+        "    color: #cccccc;"
+        "    padding: 8px;"
+        "    font-size: 12px;"
+        "    selection-background-color: #264f78;"
+        "}"
+        "QLineEdit:focus {"
+        "    border: 1px solid #98c379;"
+        "}"
+        "QCheckBox {"
+        "    color: #cccccc;"
+        "    font-size: 11px;"
+        "}"
+        "QTreeWidget {"
+        "    background-color: #252526;"
+        "    border: 1px solid #3e3e42;"
+        "    color: #cccccc;"
+        "    font-family: 'Consolas', 'Monaco', monospace;"
+        "    font-size: 12px;"
+        "}"
+        "QHeaderView::section {"
+        "    background-color: #2d2d30;"
+        "    color: #8f8f8f;"
+        "    border: none;"
+        "    padding: 4px;"
+        "}"
+        "QPushButton {"
+        "    background-color: #3e3e42;"
+        "    border: 1px solid #6f6f6f;"
+        "    border-radius: 4px;"
+        "    color: #cccccc;"
+        "    padding: 8px 16px;"
+        "    font-size: 11px;"
+        "    min-width: 80px;"
+        "}"
+        "QPushButton:hover {"
+        "    background-color: #6f6f6f;"
+        "}"
+        "QPushButton:disabled {"
+        "    color: #6f6f6f;"
+        "}"
+        "QPushButton#searchButton {"
+        "    background-color: #98c379;"
+        "    color: #1e1e1e;"
+        "    font-weight: bold;"
+        "    border: none;"
+        "}"
+        );
+
+    fileLineEdit = new QLineEdit(filePath);
+    fileLineEdit->setPlaceholderText(tr("File to search..."));
+    QPushButton *browseButton = new QPushButton(tr("Browse..."));
+    searchLineEdit = new QLineEdit;
+    searchLineEdit->setPlaceholderText(tr("Search text..."));
+    caseSensitiveCheckBox = new QCheckBox(tr("Case sensitive"));
+    regexCheckBox = new QCheckBox(tr("Use Regular Expression"));
+
+    hitTree = new QTreeWidget;
+    hitTree->setColumnCount(2);
+    hitTree->setHeaderLabels({ tr("Line"), tr("Text") });
+    hitTree->setRootIsDecorated(false);
+    hitTree->setUniformRowHeights(true);
+    hitTree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+
+    statusLabel = new QLabel;
+    searchButton = new QPushButton(tr("Search"));
+    searchButton->setObjectName("searchButton");
+    stopButton = new QPushButton(tr("Stop"));
+    stopButton->setEnabled(false);
+    QPushButton *closeButton = new QPushButton(tr("Close"));
+
+    connect(browseButton, &QPushButton::clicked, this, &DiskSearchDialog::browse);
+    connect(searchButton, &QPushButton::clicked, this, &DiskSearchDialog::startSearch);
+    connect(searchLineEdit, &QLineEdit::returnPressed, this, &DiskSearchDialog::startSearch);
+    connect(stopButton, &QPushButton::clicked, this, &DiskSearchDialog::stopSearch);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+    connect(hitTree, &QTreeWidget::itemActivated, this, &DiskSearchDialog::onHitActivated);
+    connect(watcher, &QFutureWatcher<LargeFileSearch::LineHit>::resultsReadyAt, this, &DiskSearchDialog::onResultsReady);
+    connect(watcher, &QFutureWatcher<LargeFileSearch::LineHit>::progressValueChanged, this, &DiskSearchDialog::onProgress);
+    connect(watcher, &QFutureWatcher<LargeFileSearch::LineHit>::finished, this, &DiskSearchDialog::onSearchFinished);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->setSpacing(8);
+    mainLayout->setContentsMargins(16, 16, 16, 16);
+    mainLayout->addWidget(new QLabel(tr("File:")));
+    QHBoxLayout *fileLayout = new QHBoxLayout;
+    fileLayout->addWidget(fileLineEdit, 1);
+    fileLayout->addWidget(browseButton);
+    mainLayout->addLayout(fileLayout);
+    mainLayout->addWidget(new QLabel(tr("Find:")));
+    mainLayout->addWidget(searchLineEdit);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout;
+    optionsLayout->setSpacing(20);
+    optionsLayout->addWidget(caseSensitiveCheckBox);
+    optionsLayout->addWidget(regexCheckBox);
+    optionsLayout->addStretch();
+    mainLayout->addLayout(optionsLayout);
+
+    mainLayout->addWidget(hitTree, 1);
+    mainLayout->addWidget(statusLabel);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout;
+    buttonsLayout->setSpacing(10);
+    buttonsLayout->addWidget(searchButton);
+    buttonsLayout->addWidget(stopButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(closeButton);
+    mainLayout->addLayout(buttonsLayout);
+
+    setLayout(mainLayout);
+    if (filePath.isEmpty())
+        fileLineEdit->setFocus();
+    else
+        searchLineEdit->setFocus();
+}
+
+DiskSearchDialog::~DiskSearchDialog()
+{
+    watcher->cancel();
+    watcher->waitForFinished();
+}
+
+void DiskSearchDialog::browse()
+{
+    QString path = QFileDialog::getOpenFileName(this, tr("Search File on Disk"), fileLineEdit->text());
+    if (!path.isEmpty()) fileLineEdit->setText(path);
+}
+
+void DiskSearchDialog::startSearch()
+{
+    SearchOptions options;
+    options.pattern = searchLineEdit->text();
+    options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    options.useRegex = regexCheckBox->isChecked();
+    if (!options.isValid()) {
+        statusLabel->setText(options.pattern.isEmpty() ? tr("Nothing to search for.")
+                                                       : tr("Invalid regular expression."));
+        return;
+    }
+
+    QFileInfo info(fileLineEdit->text());
+    if (!info.isFile() || !info.isReadable()) {
+        statusLabel->setText(tr("Cannot read %1.").arg(fileLineEdit->text()));
+        return;
+    }
+
+    if (watcher->isRunning()) {
+        watcher->cancel();
+        watcher->waitForFinished();
+    }
+
+    searchedPath = info.absoluteFilePath();
+    hitTree->clear();
+    searchButton->setEnabled(false);
+    stopButton->setEnabled(true);
+    statusLabel->setText(tr("Searching..."));
+
+    const QString path = searchedPath;
+    watcher->setFuture(QtConcurrent::run([path, options](QPromise<LargeFileSearch::LineHit> &promise) {
+        LargeFileSearch::search(promise, path, options, MaxHits);
+    }));
+}
+
+void DiskSearchDialog::stopSearch()
+{
+    watcher->cancel();
+}
+
+void DiskSearchDialog::onResultsReady(int begin, int end)
+{
+    QList<QTreeWidgetItem*> items;
+    for (int i = begin; i < end; ++i) {
+        const LargeFileSearch::LineHit hit = watcher->resultAt(i);
+        QTreeWidgetItem *item = new QTreeWidgetItem;
+        item->setText(0, QString::number(hit.lineNumber));
+        item->setText(1, hit.preview);
+        item->setData(0, Qt::UserRole, hit.lineOffset);
+        item->setData(0, Qt::UserRole + 1, hit.lineNumber);
+        item->setTextAlignment(0, Qt::AlignRight | Qt::AlignVCenter);
+        items.append(item);
+    }
+    hitTree->addTopLevelItems(items);
+}
+
+void DiskSearchDialog::onProgress(int value)
+{
+    statusLabel->setText(tr("Searching... %1% (%2 hits)")
+                             .arg(value / 10)
+                             .arg(QLocale().toString(hitTree->topLevelItemCount())));
+}
+
+void DiskSearchDialog::onSearchFinished()
+{
+    searchButton->setEnabled(true);
+    stopButton->setEnabled(false);
+
+    const QString count = QLocale().toString(hitTree->topLevelItemCount());
+    if (hitTree->topLevelItemCount() >= MaxHits)
+        statusLabel->setText(tr("%1 matching lines (limit reached).").arg(count));
+    else if (watcher->isCanceled())
+        statusLabel->setText(tr("Stopped, %1 matching lines so far.").arg(count));
+    else
+        statusLabel->setText(tr("%1 matching lines.").arg(count));
+}
+
+void DiskSearchDialog::onHitActivated(QTreeWidgetItem *item)
+{
+    if (!item) return;
+    emit openHitRequested(searchedPath,
+                          item->data(0, Qt::UserRole).toLongLong(),
+                          item->data(0, Qt::UserRole + 1).toLongLong());
+}
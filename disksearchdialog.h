@@ -0,0 +1,52 @@
+#ifndef DISKSEARCHDIALOG_H
+#define DISKSEARCHDIALOG_H
+
+#include <QDialog>
+#include <QFutureWatcher>
+#include "largefilesearch.h"
+
+QT_BEGIN_NAMESPACE
+class QLineEdit;
+class QCheckBox;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QLabel;
+QT_END_NAMESPACE
+
+// "Search file on disk": streams a file of any size through the search
+// engine and lists the matching lines; a hit opens a windowed view.
+class DiskSearchDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit DiskSearchDialog(const QString &filePath = QString(), QWidget *parent = nullptr);
+    ~DiskSearchDialog();
+
+signals:
+    void openHitRequested(const QString &filePath, qint64 lineOffset, qint64 lineNumber);
+
+private slots:
+    void browse();
+    void startSearch();
+    void stopSearch();
+    void onResultsReady(int begin, int end);
+    void onProgress(int value);
+    void onSearchFinished();
+    void onHitActivated(QTreeWidgetItem *item);
+
+private:
+    QFutureWatcher<LargeFileSearch::LineHit> *watcher;
+    QString searchedPath;
+
+    QLineEdit *fileLineEdit;
+    QLineEdit *searchLineEdit;
+    QCheckBox *caseSensitiveCheckBox;
+    QCheckBox *regexCheckBox;
+    QTreeWidget *hitTree;
+    QLabel *statusLabel;
+    QPushButton *searchButton;
+    QPushButton *stopButton;
+};
+
+#endif // DISKSEARCHDIALOG_H
@@ -1,5 +1,7 @@
 #include "finddialog.h"
 #include "codeeditor.h"
+#include "incrementalsearch.h"
+#include "searchengine.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -10,6 +12,7 @@
 #include <QRegularExpression>
 #include <QMessageBox>
 #include <QFrame>
+#include <QLocale>
 
 FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
     : QDialog(parent), editor(editor)
@@ -109,6 +112,7 @@ FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
 
     findNextButton = new QPushButton("Find Next");
     findNextButton->setObjectName("findNextButton");
+    findPreviousButton = new QPushButton("Find Previous");
 
     replaceButton = new QPushButton("Replace");
     replaceAllButton = new QPushButton("Replace All");
@@ -116,11 +120,22 @@ FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
 
     cancelButton = new QPushButton("Cancel");
 
+    matchCountLabel = new QLabel;
+    matchCountLabel->setStyleSheet("color: #8f8f8f; font-size: 11px;");
+
+    // Recherche incrémentale : compte en arrière-plan, surlignage du viewport
+    incrementalSearch = new IncrementalSearch(editor, this);
+
     // Connexions
     connect(findNextButton, &QPushButton::clicked, this, &FindReplaceDialog::findNext);
+    connect(findPreviousButton, &QPushButton::clicked, this, &FindReplaceDialog::findPrevious);
     connect(replaceButton, &QPushButton::clicked, this, &FindReplaceDialog::replace);
     connect(replaceAllButton, &QPushButton::clicked, this, &FindReplaceDialog::replaceAll);
     connect(cancelButton, &QPushButton::clicked, this, &QDialog::close);
+    connect(searchLineEdit, &QLineEdit::textChanged, this, &FindReplaceDialog::onSearchOptionsChanged);
+    connect(caseSensitiveCheckBox, &QCheckBox::toggled, this, &FindReplaceDialog::onSearchOptionsChanged);
+    connect(regexCheckBox, &QCheckBox::toggled, this, &FindReplaceDialog::onSearchOptionsChanged);
+    connect(incrementalSearch, &IncrementalSearch::matchesChanged, this, &FindReplaceDialog::onMatchesChanged);
 
     // Layout principal
     QVBoxLayout *mainLayout = new QVBoxLayout;
@@ -132,6 +147,7 @@ FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
     findLabel->setStyleSheet("font-weight: bold; font-size: 13px;");
     mainLayout->addWidget(findLabel);
     mainLayout->addWidget(searchLineEdit);
+    mainLayout->addWidget(matchCountLabel);
 
     // Section Replace
     mainLayout->addSpacing(8);
@@ -161,6 +177,7 @@ FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
     QHBoxLayout *buttonsLayout = new QHBoxLayout;
     buttonsLayout->setSpacing(10);
     buttonsLayout->addWidget(findNextButton);
+    buttonsLayout->addWidget(findPreviousButton);
     buttonsLayout->addWidget(replaceButton);
     buttonsLayout->addWidget(replaceAllButton);
     buttonsLayout->addStretch();
@@ -173,81 +190,180 @@ FindReplaceDialog::FindReplaceDialog(CodeEditor *editor, QWidget *parent)
     searchLineEdit->setFocus();
 }
 
+// Red border on the search field: nothing to look for
+void FindReplaceDialog::flagEmptyPattern()
+{
+    searchLineEdit->setStyleSheet(
+        "QLineEdit {"
+        "    border: 2px solid #e06c75;"
+        "    background-color: #3e3e42;"
+        "    color: #cccccc;"
+        "    padding: 8px;"
+        "}"
+        );
+}
+
 void FindReplaceDialog::findNext()
 {
     QString pattern = searchLineEdit->text();
     if(pattern.isEmpty()) {
-        searchLineEdit->setStyleSheet(
-            "QLineEdit {"
-            "    border: 2px solid #e06c75;"
-            "    background-color: #3e3e42;"
-            "    color: #cccccc;"
-            "    padding: 8px;"
-            "}"
-            );
+        flagEmptyPattern();
         return;
     }
 
     // Reset style
     searchLineEdit->setStyleSheet("");
 
-    QTextDocument::FindFlags flags;
-    if(caseSensitiveCheckBox->isChecked())
-        flags |= QTextDocument::FindCaseSensitively;
-
-    QTextCursor cursor = editor->textCursor();
+    // The match index answers in O(log n); the plain rescan is only used
+    // while the background count is still running.
     bool found = false;
+    if (incrementalSearch->isReady()) {
+        found = incrementalSearch->selectNext();
+    } else {
+        QTextDocument::FindFlags flags;
+        if(caseSensitiveCheckBox->isChecked())
+            flags |= QTextDocument::FindCaseSensitively;
 
-    if(regexCheckBox->isChecked()) {
-        QRegularExpression regex(pattern,
-                                 caseSensitiveCheckBox->isChecked()
-                                     ? QRegularExpression::NoPatternOption
-                                     : QRegularExpression::CaseInsensitiveOption);
-
-        QRegularExpressionMatch match = regex.match(editor->toPlainText(), cursor.position());
-        if(match.hasMatch()) {
-            cursor.setPosition(match.capturedStart());
-            cursor.setPosition(match.capturedEnd(), QTextCursor::KeepAnchor);
-            editor->setTextCursor(cursor);
-            found = true;
+        QTextCursor cursor = editor->textCursor();
+
+        if(regexCheckBox->isChecked()) {
+            QRegularExpression regex = SearchEngine::buildRegex({ pattern,
+                                                                  caseSensitiveCheckBox->isChecked(),
+                                                                  true });
+
+            QRegularExpressionMatch match = regex.match(editor->toPlainText(), cursor.position());
+            if(match.hasMatch()) {
+                cursor.setPosition(match.capturedStart());
+                cursor.setPosition(match.capturedEnd(), QTextCursor::KeepAnchor);
+                editor->setTextCursor(cursor);
+                found = true;
+            }
+        } else {
+            int index = editor->toPlainText().indexOf(
+                pattern,
+                cursor.position(),
+                caseSensitiveCheckBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive
+                );
+            if(index != -1) {
+                cursor.setPosition(index);
+                cursor.setPosition(index + pattern.length(), QTextCursor::KeepAnchor);
+                editor->setTextCursor(cursor);
+                found = true;
+            }
         }
+    }
+
+    if(!found) {
+        showNoMoreMatches();
+    }
+}
+
+void FindReplaceDialog::findPrevious()
+{
+    QString pattern = searchLineEdit->text();
+    if(pattern.isEmpty()) {
+        flagEmptyPattern();
+        return;
+    }
+
+    searchLineEdit->setStyleSheet("");
+
+    // Same as findNext(): the index when it is ready, else a backward rescan
+    // from the start of the selection
+    bool found = false;
+    if (incrementalSearch->isReady()) {
+        found = incrementalSearch->selectPrevious();
     } else {
-        int index = editor->toPlainText().indexOf(
-            pattern,
-            cursor.position(),
-            caseSensitiveCheckBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive
-            );
-        if(index != -1) {
-            cursor.setPosition(index);
-            cursor.setPosition(index + pattern.length(), QTextCursor::KeepAnchor);
-            editor->setTextCursor(cursor);
-            found = true;
+        QTextCursor cursor = editor->textCursor();
+        const int before = cursor.selectionStart();
+        const QString text = editor->toPlainText();
+
+        if(regexCheckBox->isChecked()) {
+            QRegularExpression regex = SearchEngine::buildRegex({ pattern,
+                                                                  caseSensitiveCheckBox->isChecked(),
+                                                                  true });
+
+            // Last match starting before the selection
+            QRegularExpressionMatch last;
+            QRegularExpressionMatchIterator it = regex.globalMatch(text);
+            while(it.hasNext()) {
+                QRegularExpressionMatch match = it.next();
+                if(match.capturedStart() >= before) break;
+                last = match;
+            }
+            if(last.hasMatch()) {
+                cursor.setPosition(last.capturedStart());
+                cursor.setPosition(last.capturedEnd(), QTextCursor::KeepAnchor);
+                editor->setTextCursor(cursor);
+                found = true;
+            }
+        } else if(before > 0) {
+            int index = text.lastIndexOf(
+                pattern,
+                before - 1,
+                caseSensitiveCheckBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive
+                );
+            if(index != -1) {
+                cursor.setPosition(index);
+                cursor.setPosition(index + pattern.length(), QTextCursor::KeepAnchor);
+                editor->setTextCursor(cursor);
+                found = true;
+            }
         }
     }
 
     if(!found) {
-        QMessageBox msgBox(this);
-        msgBox.setWindowTitle("Find");
-        msgBox.setText("No more matches found.");
-        msgBox.setIcon(QMessageBox::Information);
-        msgBox.setStyleSheet(
-            "QMessageBox {"
-            "    background-color: #1e1e1e;"
-            "    color: #cccccc;"
-            "}"
-            "QPushButton {"
-            "    background-color: #3e3e42;"
-            "    border: 1px solid #6f6f6f;"
-            "    border-radius: 4px;"
-            "    color: #cccccc;"
-            "    padding: 6px 16px;"
-            "    min-width: 60px;"
-            "}"
-            "QPushButton:hover {"
-            "    background-color: #6f6f6f;"
-            "}"
-            );
-        msgBox.exec();
+        showNoMoreMatches();
+    }
+}
+
+void FindReplaceDialog::showNoMoreMatches()
+{
+    QMessageBox msgBox(this);
+    msgBox.setWindowTitle("Find");
+    msgBox.setText("No more matches found.");
+    msgBox.setIcon(QMessageBox::Information);
+    msgBox.setStyleSheet(
+        "QMessageBox {"
+        "    background-color: #1e1e1e;"
+        "    color: #cccccc;"
+        "}"
+        "QPushButton {"
+        "    background-color: #3e3e42;"
+        "    border: 1px solid #6f6f6f;"
+        "    border-radius: 4px;"
+        "    color: #cccccc;"
+        "    padding: 6px 16px;"
+        "    min-width: 60px;"
+        "}"
+        "QPushButton:hover {"
+        "    background-color: #6f6f6f;"
+        "}"
+        );
+    msgBox.exec();
+}
+
+void FindReplaceDialog::onSearchOptionsChanged()
+{
+    searchLineEdit->setStyleSheet("");
+    incrementalSearch->setOptions({ searchLineEdit->text(),
+                                    caseSensitiveCheckBox->isChecked(),
+                                    regexCheckBox->isChecked() });
+}
+
+void FindReplaceDialog::onMatchesChanged(int current, int total)
+{
+    QLocale locale;
+    if (searchLineEdit->text().isEmpty()) {
+        matchCountLabel->clear();
+    } else if (total < 0) {
+        matchCountLabel->setText(tr("Searching..."));
+    } else if (total == 0) {
+        matchCountLabel->setText(tr("No results"));
+    } else if (current < 0) {
+        matchCountLabel->setText(tr("%1 matches").arg(locale.toString(total)));
+    } else {
+        matchCountLabel->setText(tr("Match %1 of %2").arg(locale.toString(current + 1), locale.toString(total)));
     }
 }
 
@@ -262,33 +378,18 @@ void FindReplaceDialog::replace()
 
 void FindReplaceDialog::replaceAll()
 {
-    QString text = editor->toPlainText();
-    QString pattern = searchLineEdit->text();
-    if(pattern.isEmpty()) return;
-
-    int count = 0;
-
-    if(regexCheckBox->isChecked()) {
-        QRegularExpression regex(pattern,
-                                 caseSensitiveCheckBox->isChecked()
-                                     ? QRegularExpression::NoPatternOption
-                                     : QRegularExpression::CaseInsensitiveOption);
-
-        QRegularExpressionMatchIterator it = regex.globalMatch(text);
-        while(it.hasNext()) {
-            it.next();
-            count++;
-        }
-        text.replace(regex, replaceLineEdit->text());
-    } else {
-        Qt::CaseSensitivity cs = caseSensitiveCheckBox->isChecked()
-        ? Qt::CaseSensitive
-        : Qt::CaseInsensitive;
-        count = text.count(pattern, cs);
-        text.replace(pattern, replaceLineEdit->text(), cs);
-    }
+    const SearchOptions options = { searchLineEdit->text(),
+                                    caseSensitiveCheckBox->isChecked(),
+                                    regexCheckBox->isChecked() };
+    if(!options.isValid()) return;
 
-    editor->setPlainText(text);
+    // Edits are applied in place, back to front, in a single edit block:
+    // one undo step, cursors and the rest of the document are left alone,
+    // and only the touched blocks are re-highlighted.
+    const QVector<TextReplacement> edits =
+        SearchEngine::computeReplacements(editor->toPlainText(), options, replaceLineEdit->text());
+    SearchEngine::applyReplacements(editor->document(), edits);
+    const int count = edits.size();
 
     // Message de confirmation
     QMessageBox msgBox(this);
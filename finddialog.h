@@ -7,9 +7,11 @@ QT_BEGIN_NAMESPACE
 class QLineEdit;
 class QCheckBox;
 class QPushButton;
+class QLabel;
 QT_END_NAMESPACE
 
 class CodeEditor;
+class IncrementalSearch;
 
 class FindReplaceDialog : public QDialog
 {
@@ -19,8 +21,11 @@ public:
 
 private slots:
     void findNext();
+    void findPrevious();
     void replace();
     void replaceAll();
+    void onSearchOptionsChanged();
+    void onMatchesChanged(int current, int total);
 
 private:
     CodeEditor *editor;
@@ -29,9 +34,15 @@ private:
     QCheckBox *caseSensitiveCheckBox;
     QCheckBox *regexCheckBox;
     QPushButton *findNextButton;
+    QPushButton *findPreviousButton;
     QPushButton *replaceButton;
     QPushButton *replaceAllButton;
     QPushButton *cancelButton;
+    QLabel *matchCountLabel;
+    IncrementalSearch *incrementalSearch;
+
+    void showNoMoreMatches();
+    void flagEmptyPattern();
 };
 
 #endif // FINDREPLACEDIALOG_H
@@ -0,0 +1,22 @@
+#include "groupcommit.h"
+#include <QTimer>
+
+GroupCommit::GroupCommit(QObject *owner, int delay, std::function<void()> commit)
+    : timer(new QTimer(owner))
+    , commit(std::move(commit))
+{
+    timer->setSingleShot(true);
+    timer->setInterval(delay);
+    QObject::connect(timer, &QTimer::timeout, owner, [this]() { this->commit(); });
+}
+
+void GroupCommit::schedule()
+{
+    if (!timer->isActive()) timer->start();
+}
+
+void GroupCommit::flush()
+{
+    timer->stop();
+    commit();
+}
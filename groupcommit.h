@@ -0,0 +1,31 @@
+#ifndef GROUPCOMMIT_H
+#define GROUPCOMMIT_H
+
+#include <QtGlobal>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QObject;
+class QTimer;
+QT_END_NAMESPACE
+
+// Group commit of a store's queued writes: the first write after a commit
+// starts the delay and later ones do not restart it, so a steady stream of
+// writes still commits once per delay. `commit` takes the queue (and hands
+// it to the store's worker). GUI thread only.
+class GroupCommit
+{
+public:
+    GroupCommit(QObject *owner, int delay, std::function<void()> commit);
+
+    // After queuing a write
+    void schedule();
+    // Commits the queued writes now
+    void flush();
+
+private:
+    QTimer *timer;              // child of the owner
+    std::function<void()> commit;
+};
+
+#endif // GROUPCOMMIT_H
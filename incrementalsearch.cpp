@@ -0,0 +1,256 @@
+#include "incrementalsearch.h"
+#include "codeeditor.h"
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QColor>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+
+// Edits bigger than this (e.g. setPlainText) trigger a full background rescan
+static const int MaxIncrementalEdit = 256 * 1024;
+// Upper bound of extra selections built for one viewport
+static const int MaxVisibleHighlights = 2000;
+
+IncrementalSearch::IncrementalSearch(CodeEditor *editor, QObject *parent)
+    : QObject(parent)
+    , editor(editor)
+    , watcher(new QFutureWatcher<QVector<TextMatch>>(this))
+    , debounceTimer(new QTimer(this))
+    , viewportTimer(new QTimer(this))
+    , scanPending(false)
+    , indexValid(false)
+{
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(150);
+    connect(debounceTimer, &QTimer::timeout, this, &IncrementalSearch::startScan);
+
+    // Several scroll/resize notifications in a row produce a single refresh
+    viewportTimer->setSingleShot(true);
+    viewportTimer->setInterval(0);
+    connect(viewportTimer, &QTimer::timeout, this, &IncrementalSearch::refreshVisibleHighlights);
+
+    connect(watcher, &QFutureWatcher<QVector<TextMatch>>::finished, this, &IncrementalSearch::onScanFinished);
+
+    if (!editor) return;
+    connect(editor->document(), &QTextDocument::contentsChange, this, &IncrementalSearch::onContentsChange);
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, viewportTimer, qOverload<>(&QTimer::start));
+    connect(editor->verticalScrollBar(), &QScrollBar::rangeChanged, viewportTimer, qOverload<>(&QTimer::start));
+    connect(editor, &CodeEditor::cursorPositionChanged, this, &IncrementalSearch::emitState);
+}
+
+IncrementalSearch::~IncrementalSearch()
+{
+    watcher->waitForFinished();
+    if (editor) editor->setSearchSelections({});
+}
+
+void IncrementalSearch::setOptions(const SearchOptions &options)
+{
+    if (options.pattern == searchOptions.pattern
+        && options.caseSensitive == searchOptions.caseSensitive
+        && options.useRegex == searchOptions.useRegex) {
+        return;
+    }
+    searchOptions = options;
+    indexValid = false;
+    matches.clear();
+    if (editor) editor->setSearchSelections({});
+    emitState();
+    debounceTimer->start();
+}
+
+bool IncrementalSearch::isReady() const
+{
+    return indexValid && editor;
+}
+
+void IncrementalSearch::startScan()
+{
+    if (!editor) return;
+
+    if (watcher->isRunning()) {
+        // The running scan is stale; restart as soon as it is done
+        scanPending = true;
+        return;
+    }
+    scanPending = false;
+
+    matches.clear();
+    indexValid = false;
+    if (!searchOptions.isValid()) {
+        editor->setSearchSelections({});
+        emitState();
+        return;
+    }
+
+    // One copy of the text, then the whole count runs off the GUI thread
+    QString snapshot = editor->toPlainText();
+    SearchOptions options = searchOptions;
+    watcher->setFuture(QtConcurrent::run([snapshot, options]() {
+        return SearchEngine::findAll(snapshot, options);
+    }));
+    emitState();
+}
+
+void IncrementalSearch::onScanFinished()
+{
+    if (!editor) return;
+    if (scanPending) {
+        startScan();
+        return;
+    }
+
+    matches = watcher->result();
+    indexValid = true;
+    refreshVisibleHighlights();
+    emitState();
+}
+
+void IncrementalSearch::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if (!editor) return;
+    if (!indexValid) {
+        // The snapshot being scanned is outdated now
+        if (watcher->isRunning()) scanPending = true;
+        return;
+    }
+
+    QTextDocument *doc = editor->document();
+    // A regex match depends on the text around it (^, \b, lookbehinds...),
+    // which a window cut out of the document does not have: count again
+    if (searchOptions.useRegex
+        || charsAdded > MaxIncrementalEdit || charsRemoved > MaxIncrementalEdit) {
+        indexValid = false;
+        debounceTimer->start();
+        return;
+    }
+
+    // Rescan the touched blocks plus one block on each side (for matches
+    // spanning a line break), in new document coordinates.
+    const int delta = charsAdded - charsRemoved;
+    auto matchEnd = [this](int i) { return matches.at(i).start + matches.at(i).length; };
+    QTextBlock first = doc->findBlock(position);
+    if (first.previous().isValid()) first = first.previous();
+    QTextBlock last = doc->findBlock(position + charsAdded);
+    if (!last.isValid()) last = doc->lastBlock();
+    if (last.next().isValid()) last = last.next();
+
+    // Matches running into the window from either side are found again with it
+    int i0 = lowerBound(first.position());
+    while (i0 > 0 && matchEnd(i0 - 1) > first.position()) {
+        first = doc->findBlock(matches.at(i0 - 1).start);
+        i0 = lowerBound(first.position());
+    }
+    int i1 = lowerBound(last.position() + last.length() - 1 - delta);
+    while (i1 > i0 && matchEnd(i1 - 1) > last.position() + last.length() - 1 - delta) {
+        last = doc->findBlock(matchEnd(i1 - 1) + delta);
+        if (!last.isValid()) last = doc->lastBlock();
+        i1 = lowerBound(last.position() + last.length() - 1 - delta);
+    }
+
+    const int windowStart = first.position();
+
+    QString windowText;
+    for (QTextBlock b = first; b.isValid(); b = b.next()) {
+        windowText += b.text();
+        if (b == last) break;
+        windowText += QLatin1Char('\n');
+    }
+
+    QVector<TextMatch> found = SearchEngine::findAll(windowText, searchOptions);
+    for (TextMatch &m : found) m.start += windowStart;
+
+    // Matches before the window are kept, the window is replaced, the tail is shifted
+    QVector<TextMatch> merged = matches.first(i0);
+    merged.reserve(matches.size() - (i1 - i0) + found.size());
+    merged.append(found);
+    for (int i = i1; i < matches.size(); ++i) {
+        merged.append({ matches.at(i).start + delta, matches.at(i).length });
+    }
+    matches.swap(merged);
+
+    viewportTimer->start();
+    emitState();
+}
+
+void IncrementalSearch::refreshVisibleHighlights()
+{
+    if (!editor) return;
+
+    QList<QTextEdit::ExtraSelection> selections;
+    if (indexValid && !matches.isEmpty()) {
+        QTextDocument *doc = editor->document();
+        const int first = editor->firstVisibleBlock().position();
+        QTextCursor bottom = editor->cursorForPosition(QPoint(editor->viewport()->width(),
+                                                              editor->viewport()->height()));
+        const int last = bottom.block().position() + bottom.block().length();
+
+        QColor matchColor(229, 192, 123, 90);
+        for (int i = lowerBound(first);
+             i < matches.size() && matches.at(i).start < last && selections.size() < MaxVisibleHighlights;
+             ++i) {
+            QTextEdit::ExtraSelection selection;
+            selection.format.setBackground(matchColor);
+            selection.cursor = QTextCursor(doc);
+            selection.cursor.setPosition(matches.at(i).start);
+            selection.cursor.setPosition(matches.at(i).start + matches.at(i).length, QTextCursor::KeepAnchor);
+            selections.append(selection);
+        }
+    }
+    editor->setSearchSelections(selections);
+}
+
+int IncrementalSearch::lowerBound(int position) const
+{
+    auto it = std::lower_bound(matches.cbegin(), matches.cend(), position,
+                               [](const TextMatch &m, int pos) { return m.start < pos; });
+    return static_cast<int>(it - matches.cbegin());
+}
+
+int IncrementalSearch::currentMatch() const
+{
+    if (!isReady()) return -1;
+    QTextCursor cursor = editor->textCursor();
+    int i = lowerBound(cursor.selectionStart());
+    if (i < matches.size()
+        && matches.at(i).start == cursor.selectionStart()
+        && matches.at(i).length == cursor.selectionEnd() - cursor.selectionStart()) {
+        return i;
+    }
+    return -1;
+}
+
+bool IncrementalSearch::selectNext()
+{
+    if (!isReady()) return false;
+    QTextCursor cursor = editor->textCursor();
+    int i = lowerBound(cursor.hasSelection() ? cursor.selectionEnd() : cursor.position());
+    if (i >= matches.size()) return false;
+    selectMatch(i);
+    return true;
+}
+
+bool IncrementalSearch::selectPrevious()
+{
+    if (!isReady()) return false;
+    int i = lowerBound(editor->textCursor().selectionStart()) - 1;
+    if (i < 0) return false;
+    selectMatch(i);
+    return true;
+}
+
+void IncrementalSearch::selectMatch(int index)
+{
+    const TextMatch &m = matches.at(index);
+    QTextCursor cursor(editor->document());
+    cursor.setPosition(m.start);
+    cursor.setPosition(m.start + m.length, QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+    emitState();
+}
+
+void IncrementalSearch::emitState()
+{
+    emit matchesChanged(currentMatch(), indexValid ? matches.size() : -1);
+}
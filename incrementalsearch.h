@@ -0,0 +1,62 @@
+#ifndef INCREMENTALSEARCH_H
+#define INCREMENTALSEARCH_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QFutureWatcher>
+#include "searchengine.h"
+
+class CodeEditor;
+
+// As-you-type search over a CodeEditor.
+//
+// All matches are counted once on a background snapshot of the document, then
+// the sorted match index is patched on every edit (only the touched blocks are
+// rescanned; in regex mode an edit recounts everything), so "match i of N" and next/previous are binary searches. Only the
+// matches inside the viewport are turned into extra selections.
+class IncrementalSearch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IncrementalSearch(CodeEditor *editor, QObject *parent = nullptr);
+    ~IncrementalSearch();
+
+    void setOptions(const SearchOptions &options);
+    SearchOptions options() const { return searchOptions; }
+
+    // False while the background count is running (or the pattern is invalid)
+    bool isReady() const;
+    int matchCount() const { return matches.size(); }
+    // 0-based index of the match under the editor selection, -1 if none
+    int currentMatch() const;
+
+    // Select the next / previous match after the cursor; false if there is none
+    bool selectNext();
+    bool selectPrevious();
+
+signals:
+    void matchesChanged(int current, int total);
+
+private slots:
+    void startScan();
+    void onScanFinished();
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void refreshVisibleHighlights();
+
+private:
+    QPointer<CodeEditor> editor;
+    SearchOptions searchOptions;
+    QVector<TextMatch> matches;
+    QFutureWatcher<QVector<TextMatch>> *watcher;
+    QTimer *debounceTimer;
+    QTimer *viewportTimer;
+    bool scanPending;
+    bool indexValid;
+
+    int lowerBound(int position) const;
+    void selectMatch(int index);
+    void emitState();
+};
+
+#endif // INCREMENTALSEARCH_H
@@ -0,0 +1,121 @@
+#include "jobcontroller.h"
+#include <QThread>
+#include <QProcess>
+
+#ifndef Q_OS_WIN
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+JobController::JobController(QObject *parent)
+    : QObject(parent)
+    , thread(new QThread(this))
+    , worker(new QObject)
+    , nextId(1)
+{
+    thread->setObjectName("JobController");
+    worker->moveToThread(thread);
+    connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread->start();
+}
+
+JobController::~JobController()
+{
+    // Jobs do not outlive their tab
+    QMetaObject::invokeMethod(worker, [this]() { stopAll(); }, Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+}
+
+int JobController::start(const QString &program, const QStringList &arguments, const QString &workingDirectory)
+{
+    const int id = nextId++;
+    QMetaObject::invokeMethod(worker, [=]() { launch(id, program, arguments, workingDirectory); },
+                              Qt::QueuedConnection);
+    return id;
+}
+
+void JobController::launch(int id, const QString &program, const QStringList &arguments,
+                           const QString &workingDirectory)
+{
+    QProcess *process = new QProcess(worker);
+    process->setWorkingDirectory(workingDirectory);
+#ifndef Q_OS_WIN
+    process->setChildProcessModifier([]() { ::setpgid(0, 0); });
+#endif
+
+    connect(process, &QProcess::started, worker, [this, id, process]() {
+        emit started(id, process->processId());
+    });
+    connect(process, &QProcess::readyReadStandardOutput, worker, [this, id, process]() {
+        emit output(id, process->readAllStandardOutput(), false);
+    });
+    connect(process, &QProcess::readyReadStandardError, worker, [this, id, process]() {
+        emit output(id, process->readAllStandardError(), true);
+    });
+    connect(process, &QProcess::finished, worker, [this, id, process](int exitCode, QProcess::ExitStatus status) {
+        const QByteArray out = process->readAllStandardOutput();
+        const QByteArray err = process->readAllStandardError();
+        if (!out.isEmpty()) emit output(id, out, false);
+        if (!err.isEmpty()) emit output(id, err, true);
+        release(id, process);
+        emit finished(id, exitCode, status == QProcess::CrashExit);
+    });
+    connect(process, &QProcess::errorOccurred, worker, [this, id, process](QProcess::ProcessError error) {
+        // Only a failed start ends without finished()
+        if (error != QProcess::FailedToStart) return;
+        release(id, process);
+        emit finished(id, 127, false);
+    });
+
+    processes.insert(id, process);
+    process->start(program, arguments);
+}
+
+void JobController::release(int id, QProcess *process)
+{
+    processes.remove(id);
+    process->deleteLater();
+}
+
+void JobController::writeInput(int id, const QByteArray &data)
+{
+    QMetaObject::invokeMethod(worker, [this, id, data]() {
+        if (QProcess *process = processes.value(id)) process->write(data);
+    }, Qt::QueuedConnection);
+}
+
+void JobController::closeInput(int id)
+{
+    QMetaObject::invokeMethod(worker, [this, id]() {
+        if (QProcess *process = processes.value(id)) process->closeWriteChannel();
+    }, Qt::QueuedConnection);
+}
+
+void JobController::sendSignal(int id, int signal)
+{
+    QMetaObject::invokeMethod(worker, [this, id, signal]() {
+        QProcess *process = processes.value(id);
+        if (!process || process->state() == QProcess::NotRunning) return;
+#ifdef Q_OS_WIN
+        if (signal == 9) process->kill();
+        else process->terminate();
+#else
+        ::kill(static_cast<pid_t>(-process->processId()), signal);
+#endif
+    }, Qt::QueuedConnection);
+}
+
+void JobController::stopAll()
+{
+    for (QProcess *process : std::as_const(processes)) {
+        process->disconnect(worker);
+#ifndef Q_OS_WIN
+        ::kill(static_cast<pid_t>(-process->processId()), SIGHUP);
+#endif
+        process->kill();
+        process->waitForFinished(1000);
+        delete process;
+    }
+    processes.clear();
+}
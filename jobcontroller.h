@@ -0,0 +1,54 @@
+#ifndef JOBCONTROLLER_H
+#define JOBCONTROLLER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+class QProcess;
+QT_END_NAMESPACE
+
+// Background jobs of a terminal tab ("command &").
+//
+// Each job is a shell running one command line, in its own process group so
+// a signal reaches the whole pipeline, with stdout and stderr on pipes. The
+// processes live on a dedicated watcher thread: exits and output are
+// delivered by its event loop (no timers, no polling) and a chatty job never
+// competes with the GUI thread. All methods are called from the GUI thread;
+// the signals are emitted from the watcher thread.
+class JobController : public QObject
+{
+    Q_OBJECT
+public:
+    explicit JobController(QObject *parent = nullptr);
+    ~JobController();
+
+    // Returns the job number (1, 2, ...); started() or finished() follows
+    int start(const QString &program, const QStringList &arguments, const QString &workingDirectory);
+    void writeInput(int id, const QByteArray &data);
+    void closeInput(int id);
+    // POSIX signal number; on Windows 9 kills the process, anything else terminates it
+    void sendSignal(int id, int signal);
+
+signals:
+    void started(int id, qint64 pid);
+    void output(int id, const QByteArray &data, bool isError);
+    // exitCode is 127 when the job could not be started
+    void finished(int id, int exitCode, bool crashed);
+
+private:
+    QThread *thread;
+    QObject *worker;                    // lives on `thread`, parent of the processes
+    QHash<int, QProcess*> processes;    // only touched on `thread`
+    int nextId;
+
+    void launch(int id, const QString &program, const QStringList &arguments, const QString &workingDirectory);
+    void release(int id, QProcess *process);
+    void stopAll();
+};
+
+#endif // JOBCONTROLLER_H
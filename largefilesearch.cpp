@@ -0,0 +1,200 @@
+#include "largefilesearch.h"
+#include <QFile>
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QRegularExpression>
+#include <algorithm>
+
+// Size of one mapped window
+static const qint64 WindowSize = 64 * 1024 * 1024;
+// A line longer than a window is searched in pieces overlapping by this much
+static const qint64 LongLineOverlap = 64 * 1024;
+// Longest run of a line decoded at once for the regex
+static const qsizetype RegexChunkSize = 1024 * 1024;
+static const int MaxPreviewLength = 300;
+
+static qint64 countNewlines(const char *data, qsizetype from, qsizetype to)
+{
+    return std::count(data + from, data + to, '\n');
+}
+
+// First UTF-8 sequence start at or after `pos`
+static qsizetype utf8Boundary(const char *data, qsizetype pos, qsizetype end)
+{
+    while (pos < end && (static_cast<uchar>(data[pos]) & 0xC0) == 0x80) ++pos;
+    return pos;
+}
+
+// Whether `regex` matches the line bytes [from, end), decoded a chunk at a
+// time. Each chunk is matched with up to LongLineOverlap bytes of the line on
+// both sides (from `lineStart` on, for ^ and lookbehinds); `continues`: the
+// line goes on after `end`, so a match running into it is not trusted.
+static bool lineMatches(const QRegularExpression &regex, const char *data,
+                        qsizetype lineStart, qsizetype from, qsizetype end, bool continues)
+{
+    while (from < end) {
+        const qsizetype to = utf8Boundary(data, qMin<qsizetype>(end, from + RegexChunkSize), end);
+        const qsizetype before = utf8Boundary(data, qMax<qsizetype>(lineStart, from - LongLineOverlap), from);
+        const qsizetype after = utf8Boundary(data, qMin<qsizetype>(end, to + LongLineOverlap), end);
+        QString subject = QString::fromUtf8(data + before, from - before);
+        const qsizetype offset = subject.size();
+        subject += QString::fromUtf8(data + from, after - from);
+        const bool cut = continues || after < end;
+        QRegularExpressionMatchIterator it = regex.globalMatch(subject, offset);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch m = it.next();
+            if (!cut || m.capturedEnd() < subject.size()) return true;
+        }
+        from = to;
+    }
+    return false;
+}
+
+static QString previewOf(const char *data, qsizetype lineStart, qsizetype lineEnd)
+{
+    if (lineEnd > lineStart && data[lineEnd - 1] == '\r') --lineEnd;
+    const qsizetype length = qMin<qsizetype>(lineEnd - lineStart, MaxPreviewLength * 4);
+    QString line = QString::fromUtf8(data + lineStart, length);
+    if (line.size() > MaxPreviewLength) line = line.left(MaxPreviewLength) + QStringLiteral("...");
+    return line;
+}
+
+void LargeFileSearch::search(QPromise<LineHit> &promise, const QString &filePath,
+                             const SearchOptions &options, int maxHits)
+{
+    promise.setProgressRange(0, 1000);
+    if (!options.isValid()) return;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const qint64 fileSize = file.size();
+
+    // Case-sensitive literal search runs directly on the mapped bytes;
+    // everything else decodes the lines one at a time.
+    const bool byteSearch = options.caseSensitive && !options.useRegex;
+    const QByteArrayMatcher matcher(options.pattern.toUtf8());
+    const QRegularExpression regex = SearchEngine::buildRegex(options);
+
+    qint64 windowStart = 0;
+    qint64 lineNumber = 1;     // line number at windowStart
+    qint64 lineStart = 0;      // offset of the line windowStart is in
+    qint64 lastHitLine = 0;
+    int hits = 0;
+
+    auto addHit = [&](qint64 number, qint64 offset, const char *data, qsizetype ls, qsizetype le) {
+        if (number == lastHitLine) return; // same long line seen in the overlap
+        lastHitLine = number;
+        promise.addResult(LineHit{ number, offset, previewOf(data, ls, le) });
+        ++hits;
+    };
+
+    while (windowStart < fileSize && hits < maxHits) {
+        if (promise.isCanceled()) return;
+
+        const qint64 mapSize = qMin(WindowSize, fileSize - windowStart);
+        uchar *mapped = file.map(windowStart, mapSize);
+        if (!mapped) return;
+        const char *data = reinterpret_cast<const char *>(mapped);
+        const bool lastWindow = windowStart + mapSize >= fileSize;
+        const QByteArray window = QByteArray::fromRawData(data, mapSize);
+
+        // Only complete lines are searched; the partial last line starts the next window
+        qsizetype usable = mapSize;
+        qint64 advance = mapSize;
+        qint64 nextLineStart = lineStart;
+        if (!lastWindow) {
+            const qsizetype lastNewline = window.lastIndexOf('\n');
+            if (lastNewline >= 0) {
+                usable = lastNewline + 1;
+                advance = usable;
+                nextLineStart = windowStart + usable;
+            } else {
+                advance = mapSize - LongLineOverlap;
+            }
+        }
+        const QByteArray view = QByteArray::fromRawData(data, usable);
+        // The window starts in the middle of a line longer than a window: the
+        // previous one searched the first half of the overlap, the rest is
+        // context for the regex
+        const bool carried = windowStart > lineStart;
+        // Hits are reported at the real start of their line
+        auto offsetOf = [&](qsizetype ls) { return ls == 0 ? lineStart : windowStart + ls; };
+
+        qint64 currentLine = lineNumber;
+        if (byteSearch) {
+            qsizetype counted = 0;
+            qsizetype pos = matcher.indexIn(view, 0);
+            while (pos >= 0 && hits < maxHits) {
+                currentLine += countNewlines(data, counted, pos);
+                counted = pos;
+                const qsizetype ls = pos > 0 ? view.lastIndexOf('\n', pos - 1) + 1 : 0;
+                qsizetype le = view.indexOf('\n', pos);
+                if (le < 0) le = usable;
+                addHit(currentLine, offsetOf(ls), data, ls, le);
+                if (le >= usable) break;
+                pos = matcher.indexIn(view, le + 1);
+            }
+            currentLine += countNewlines(data, counted, usable);
+        } else {
+            qsizetype ls = 0;
+            qint64 scanned = 0;
+            while (ls < usable && hits < maxHits) {
+                qsizetype le = view.indexOf('\n', ls);
+                const bool terminated = le >= 0;
+                if (!terminated) le = usable;
+                qsizetype contentEnd = le;
+                if (contentEnd > ls && data[contentEnd - 1] == '\r') --contentEnd;
+                const qsizetype from = (ls == 0 && carried)
+                    ? utf8Boundary(data, LongLineOverlap / 2, contentEnd) : ls;
+                const bool continues = !terminated && !lastWindow;
+                if (lineMatches(regex, data, ls, from, contentEnd, continues)) {
+                    addHit(currentLine, offsetOf(ls), data, ls, le);
+                }
+                if (terminated) ++currentLine;
+                ls = le + 1;
+                if ((++scanned & 0xFFFF) == 0 && promise.isCanceled()) break;
+            }
+        }
+
+        file.unmap(mapped);
+        windowStart += advance;
+        lineNumber = currentLine;
+        lineStart = nextLineStart;
+        promise.setProgressValue(static_cast<int>(qMin<qint64>(1000, windowStart * 1000 / qMax<qint64>(1, fileSize))));
+    }
+    promise.setProgressValue(1000);
+}
+
+LargeFileSearch::TextWindow LargeFileSearch::readWindow(const QString &filePath, qint64 lineOffset,
+                                                        qint64 lineNumber, int contextBytes)
+{
+    TextWindow window;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return window;
+
+    const qint64 fileSize = file.size();
+    const qint64 start = qMax<qint64>(0, lineOffset - contextBytes);
+    const qint64 end = qMin(fileSize, lineOffset + contextBytes);
+    if (!file.seek(start)) return window;
+    const QByteArray bytes = file.read(end - start);
+    const qsizetype hitPos = lineOffset - start;
+    if (hitPos > bytes.size()) return window;
+
+    // Trim the partial first and last lines
+    qsizetype first = 0;
+    if (start > 0) {
+        const qsizetype nl = bytes.indexOf('\n');
+        first = (nl >= 0 && nl < hitPos) ? nl + 1 : hitPos;
+    }
+    qsizetype last = bytes.size();
+    if (end < fileSize) {
+        const qsizetype nl = bytes.lastIndexOf('\n');
+        if (nl >= hitPos) last = nl;
+    }
+
+    window.hitLine = static_cast<int>(countNewlines(bytes.constData(), first, hitPos));
+    window.firstLineNumber = lineNumber - window.hitLine;
+    window.text = QString::fromUtf8(bytes.constData() + first, last - first);
+    window.valid = true;
+    return window;
+}
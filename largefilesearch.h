@@ -0,0 +1,43 @@
+#ifndef LARGEFILESEARCH_H
+#define LARGEFILESEARCH_H
+
+#include <QString>
+#include <QPromise>
+#include "searchengine.h"
+
+// Line-oriented search in files too large to be loaded in an editor.
+//
+// The file is mapped window by window; each window ends on a line boundary
+// and the partial last line is the start of the next one, so no match is
+// lost at a boundary (a line longer than a window is cut into overlapping
+// windows, its hits still point at its start). Memory use is one window plus
+// the (bounded) hit list, whatever the file size. The file is read as UTF-8.
+namespace LargeFileSearch
+{
+    struct LineHit
+    {
+        qint64 lineNumber = 0;  // 1-based
+        qint64 lineOffset = 0;  // byte offset of the start of the line
+        QString preview;        // the line, truncated
+    };
+
+    // A slice of the file around a hit, for a read-only view
+    struct TextWindow
+    {
+        QString text;
+        qint64 firstLineNumber = 1;
+        int hitLine = 0;        // 0-based line of the hit inside `text`
+        bool valid = false;
+    };
+
+    // Reports one hit per matching line through `promise` (at most `maxHits`),
+    // progress is reported in per-mille. Stops early when the promise is canceled.
+    void search(QPromise<LineHit> &promise, const QString &filePath,
+                const SearchOptions &options, int maxHits);
+
+    // About `contextBytes` of text on each side of the line starting at `lineOffset`
+    TextWindow readWindow(const QString &filePath, qint64 lineOffset, qint64 lineNumber,
+                          int contextBytes = 64 * 1024);
+}
+
+#endif // LARGEFILESEARCH_H
@@ -0,0 +1,183 @@
+#include "linediff.h"
+#include <QHash>
+#include <QStringView>
+
+namespace {
+
+// A run of changed lines: [oldBegin, oldEnd) of `before` becomes [newBegin, newEnd) of `after`
+struct Hunk
+{
+    int oldBegin;
+    int oldEnd;
+    int newBegin;
+    int newEnd;
+};
+
+class MyersDiff
+{
+public:
+    MyersDiff(const QVector<int> &a, const QVector<int> &b) : a(a), b(b) {}
+
+    QVector<Hunk> run()
+    {
+        compare(0, a.size(), 0, b.size());
+        return hunks;
+    }
+
+private:
+    const QVector<int> &a;
+    const QVector<int> &b;
+    QVector<Hunk> hunks;
+
+    // Hunks come in order; touching ones are merged
+    void change(int oldBegin, int oldEnd, int newBegin, int newEnd)
+    {
+        if (!hunks.isEmpty() && hunks.last().oldEnd == oldBegin && hunks.last().newEnd == newBegin) {
+            hunks.last().oldEnd = oldEnd;
+            hunks.last().newEnd = newEnd;
+            return;
+        }
+        hunks.append(Hunk{ oldBegin, oldEnd, newBegin, newEnd });
+    }
+
+    void compare(int aBegin, int aEnd, int bBegin, int bEnd)
+    {
+        // Common head and tail
+        while (aBegin < aEnd && bBegin < bEnd && a.at(aBegin) == b.at(bBegin)) { ++aBegin; ++bBegin; }
+        while (aBegin < aEnd && bBegin < bEnd && a.at(aEnd - 1) == b.at(bEnd - 1)) { --aEnd; --bEnd; }
+        if (aBegin == aEnd || bBegin == bEnd) {
+            if (aBegin != aEnd || bBegin != bEnd) change(aBegin, aEnd, bBegin, bEnd);
+            return;
+        }
+
+        int x = 0, y = 0;
+        if (!middleSnake(aBegin, aEnd, bBegin, bEnd, x, y)) {
+            change(aBegin, aEnd, bBegin, bEnd); // nothing in common
+            return;
+        }
+        compare(aBegin, aBegin + x, bBegin, bBegin + y);
+        compare(aBegin + x, aEnd, bBegin + y, bEnd);
+    }
+
+    // Searches from both ends at once until the paths meet; (x, y) is where
+    // they do, relative to the begins. False if the ranges share no line.
+    bool middleSnake(int aBegin, int aEnd, int bBegin, int bEnd, int &x, int &y)
+    {
+        const int n = aEnd - aBegin;
+        const int m = bEnd - bBegin;
+        const int maxD = (n + m + 1) / 2;
+        const int offset = maxD;
+        QVector<int> forward(2 * maxD + 2, -1);
+        QVector<int> backward(2 * maxD + 2, -1);
+        forward[offset + 1] = 0;
+        backward[offset + 1] = 0;
+        const int delta = n - m;
+        // With an odd delta the forward path meets the backward one, else the reverse
+        const bool front = (delta % 2) != 0;
+        int k1Start = 0, k1End = 0, k2Start = 0, k2End = 0;
+
+        for (int d = 0; d < maxD; ++d) {
+            for (int k1 = -d + k1Start; k1 <= d - k1End; k1 += 2) {
+                const int k1Offset = offset + k1;
+                int x1 = (k1 == -d || (k1 != d && forward.at(k1Offset - 1) < forward.at(k1Offset + 1)))
+                             ? forward.at(k1Offset + 1)
+                             : forward.at(k1Offset - 1) + 1;
+                int y1 = x1 - k1;
+                while (x1 < n && y1 < m && a.at(aBegin + x1) == b.at(bBegin + y1)) { ++x1; ++y1; }
+                forward[k1Offset] = x1;
+                if (x1 > n) {
+                    k1End += 2;         // off the right edge
+                } else if (y1 > m) {
+                    k1Start += 2;       // off the bottom
+                } else if (front) {
+                    const int k2Offset = offset + delta - k1;
+                    if (k2Offset >= 0 && k2Offset < backward.size() && backward.at(k2Offset) != -1
+                        && x1 >= n - backward.at(k2Offset)) {
+                        x = x1;
+                        y = y1;
+                        return true;
+                    }
+                }
+            }
+            for (int k2 = -d + k2Start; k2 <= d - k2End; k2 += 2) {
+                const int k2Offset = offset + k2;
+                int x2 = (k2 == -d || (k2 != d && backward.at(k2Offset - 1) < backward.at(k2Offset + 1)))
+                             ? backward.at(k2Offset + 1)
+                             : backward.at(k2Offset - 1) + 1;
+                int y2 = x2 - k2;
+                while (x2 < n && y2 < m && a.at(aEnd - x2 - 1) == b.at(bEnd - y2 - 1)) { ++x2; ++y2; }
+                backward[k2Offset] = x2;
+                if (x2 > n) {
+                    k2End += 2;
+                } else if (y2 > m) {
+                    k2Start += 2;
+                } else if (!front) {
+                    const int k1Offset = offset + delta - k2;
+                    if (k1Offset >= 0 && k1Offset < forward.size() && forward.at(k1Offset) != -1) {
+                        const int x1 = forward.at(k1Offset);
+                        if (x1 >= n - x2) {
+                            x = x1;
+                            y = x1 - (k1Offset - offset);
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// Start offsets of the lines of `text` (a line keeps its '\n'), plus the end
+QVector<int> lineOffsets(const QString &text)
+{
+    QVector<int> offsets;
+    offsets.append(0);
+    int from = 0;
+    int newline;
+    while ((newline = int(text.indexOf(QLatin1Char('\n'), from))) >= 0) {
+        from = newline + 1;
+        offsets.append(from);
+    }
+    if (offsets.last() != text.size()) offsets.append(int(text.size()));
+    return offsets;
+}
+
+// Lines as numbers, equal lines getting equal numbers, so the diff compares ints
+QVector<int> intern(const QString &text, const QVector<int> &offsets, QHash<QStringView, int> &ids)
+{
+    QVector<int> lines;
+    lines.reserve(offsets.size() - 1);
+    for (int i = 0; i + 1 < offsets.size(); ++i) {
+        const QStringView line = QStringView(text).mid(offsets.at(i), offsets.at(i + 1) - offsets.at(i));
+        auto it = ids.constFind(line);
+        if (it == ids.constEnd()) it = ids.insert(line, int(ids.size()));
+        lines.append(it.value());
+    }
+    return lines;
+}
+
+} // namespace
+
+QVector<TextReplacement> LineDiff::replacements(const QString &before, const QString &after)
+{
+    QVector<TextReplacement> edits;
+    if (before == after) return edits;
+
+    const QVector<int> oldOffsets = lineOffsets(before);
+    const QVector<int> newOffsets = lineOffsets(after);
+    QHash<QStringView, int> ids;
+    const QVector<int> oldLines = intern(before, oldOffsets, ids);
+    const QVector<int> newLines = intern(after, newOffsets, ids);
+
+    const QVector<Hunk> hunks = MyersDiff(oldLines, newLines).run();
+    edits.reserve(hunks.size());
+    for (const Hunk &hunk : hunks) {
+        TextReplacement edit;
+        edit.start = oldOffsets.at(hunk.oldBegin);
+        edit.length = oldOffsets.at(hunk.oldEnd) - edit.start;
+        edit.text = after.mid(newOffsets.at(hunk.newBegin), newOffsets.at(hunk.newEnd) - newOffsets.at(hunk.newBegin));
+        edits.append(edit);
+    }
+    return edits;
+}
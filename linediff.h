@@ -0,0 +1,17 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QString>
+#include <QVector>
+#include "searchengine.h"
+
+namespace LineDiff
+{
+    // Edits turning `before` into `after` with as few changed lines as
+    // possible (Myers' O(ND) diff, linear space, on interned lines). Each run
+    // of changed lines is one replacement of `before`, sorted, ready for
+    // SearchEngine::applyReplacements(); unchanged lines are left alone.
+    QVector<TextReplacement> replacements(const QString &before, const QString &after);
+}
+
+#endif // LINEDIFF_H
@@ -2,6 +2,9 @@
 #include "ui_mainwindow.h"
 #include "syntaxhighlighter.h"
 #include "finddialog.h"
+#include "projectreplacedialog.h"
+#include "disksearchdialog.h"
+#include "largefilesearch.h"
 #include "gotolinedialog.h"
 #include "chatwidget.h"
 #include <QApplication>
@@ -74,6 +77,8 @@ MainWindow::MainWindow(QWidget *parent)
     if (!currentWorkingDirectory.isEmpty()) {
         chatWidget->setProjectDirectory(currentWorkingDirectory);
     }
+    // The selection of the current editor goes with the prompts
+    chatWidget->setCurrentEditor(currentEditor());
     if (ui->rightChatPlaceholder) {
         // parent the chat widget into the placeholder's parent layout
         QWidget *ph = ui->rightChatPlaceholder;
@@ -152,7 +157,9 @@ void MainWindow::connectActions()
 
     // Connection to the find dialog
     connect(ui->actionFindReplace, &QAction::triggered, this, &MainWindow::onActionFindReplace);
+    connect(ui->actionReplaceInFiles, &QAction::triggered, this, &MainWindow::onActionReplaceInFiles);
     connect(ui->actionGoToLine, &QAction::triggered, this, &MainWindow::onActionGoToLine);
+    connect(ui->actionSearchFileOnDisk, &QAction::triggered, this, &MainWindow::onActionSearchFileOnDisk);
 }
 
 void MainWindow::setupCodeEditor()
@@ -571,9 +578,22 @@ void MainWindow::onShowLinesToggled(bool checked)
     }
 }
 
+// Text files above this size are searched on disk instead of being loaded
+static const qint64 MaxEditorFileSize = 256 * 1024 * 1024;
+
 void MainWindow::openFileInEditor(const QString &filePath)
 {
     QFileInfo info(filePath);
+    if (info.size() > MaxEditorFileSize) {
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            this, tr("File too large"),
+            tr("%1 is too large to open in the editor (%2 MB).\nSearch it on disk instead?")
+                .arg(info.fileName())
+                .arg(info.size() / (1024 * 1024)));
+        if (answer == QMessageBox::Yes) openDiskSearch(filePath);
+        return;
+    }
+
     QMimeDatabase db;
     QMimeType mime = db.mimeTypeForFile(info);
     QString mimeName = mime.name();
@@ -805,6 +825,7 @@ void MainWindow::onEditorTabChanged(int index)
     } else {
         currentFileName.clear();
     }
+    if (chatWidget) chatWidget->setCurrentEditor(currentEditor());
     updateWindowTitle();
 }
 
@@ -912,11 +933,73 @@ void MainWindow::onActionFindReplace() {
     dlg.exec();
 }
 
+void MainWindow::onActionReplaceInFiles() {
+    if (currentWorkingDirectory.isEmpty()) return;
+
+    QList<CodeEditor*> editors;
+    for (int i = 0; i < editorTabs->count(); ++i) {
+        if (CodeEditor *ed = qobject_cast<CodeEditor*>(editorTabs->widget(i))) {
+            editors.append(ed);
+        }
+    }
+    ProjectReplaceDialog dlg(currentWorkingDirectory, editors, this);
+    dlg.exec();
+}
+
 void MainWindow::onActionGoToLine() {
     GoToLineDialog dlg(currentEditor(), this);
     dlg.exec();
 }
 
+void MainWindow::onActionSearchFileOnDisk() {
+    QString path;
+    if (QWidget *w = editorTabs->currentWidget()) path = w->property("filePath").toString();
+    openDiskSearch(path);
+}
+
+void MainWindow::openDiskSearch(const QString &filePath)
+{
+    // Non modal: hits can be opened one after the other while the list stays visible
+    DiskSearchDialog *dlg = new DiskSearchDialog(filePath, this);
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dlg, &DiskSearchDialog::openHitRequested, this, &MainWindow::openFileWindow);
+    dlg->show();
+}
+
+// Read-only view of the lines around a hit of a file too large to be opened
+void MainWindow::openFileWindow(const QString &filePath, qint64 lineOffset, qint64 lineNumber)
+{
+    LargeFileSearch::TextWindow window = LargeFileSearch::readWindow(filePath, lineOffset, lineNumber);
+    if (!window.valid) {
+        QMessageBox::warning(this, tr("Search File on Disk"), tr("Cannot read %1.").arg(filePath));
+        return;
+    }
+
+    CodeEditor *ed = new CodeEditor(this);
+    ed->setPlainText(window.text);
+    ed->setReadOnly(true);
+    ed->setFirstLineNumber(window.firstLineNumber);
+    ed->setStyleSheet(
+        "background-color: #1e1e1e;"
+        "color: #cccccc;"
+        "border: none;"
+        "font-family: 'Monaco', 'Consolas', monospace;"
+        "font-size: 13px;"
+        );
+    // No "filePath" property: the slice must never be saved over the real file
+    ed->setProperty("viewerType", "window");
+    ed->setToolTip(filePath);
+
+    int idx = editorTabs->addTab(ed, QString("%1:%2").arg(QFileInfo(filePath).fileName()).arg(lineNumber));
+    editorTabs->setCurrentIndex(idx);
+    ui->centralStack->setCurrentIndex(CodeViewer);
+
+    QTextCursor cursor(ed->document()->findBlockByNumber(window.hitLine));
+    cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    ed->setTextCursor(cursor);
+    ed->centerCursor();
+}
+
 void MainWindow::toggleTerminal()
 {
     // Trouver le conteneur des terminaux (parent du terminalTabs)
@@ -90,7 +90,10 @@ private slots:
 
     // Find section
     void onActionFindReplace();
+    void onActionReplaceInFiles();
     void onActionGoToLine();
+    void onActionSearchFileOnDisk();
+    void openFileWindow(const QString &filePath, qint64 lineOffset, qint64 lineNumber);
 
     // Ouvrir terminal
     void toggleTerminal();
@@ -142,6 +145,7 @@ private:
     QString getFileExtension(const QString &fileName);
     QString getFileIcon(const QString &fileName);
     void openFileInEditor(const QString &filePath);
+    void openDiskSearch(const QString &filePath);
     void saveCurrentFile();
     void promptOpenFolderOrFile();
     void setProjectDirectory(const QString &path);
@@ -0,0 +1,345 @@
+#include "projectindex.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QStringDecoder>
+#include <algorithm>
+#include <cmath>
+
+// Lines per chunk
+static const int ChunkLines = 40;
+// Bigger files are generated or data, not code worth quoting
+static const qint64 MaxIndexedFileSize = 512 * 1024;
+static const int MaxIndexedFiles = 20000;
+// Work done by one indexStep(), so a search never waits long behind it
+static const int StepDirectories = 32;
+static const int StepMilliseconds = 20;
+// Query terms considered at most
+static const int MaxQueryTerms = 32;
+static const int SearchCacheSize = 64;
+// BM25 parameters, and the weight of a symbol defined in the chunk
+static const double K1 = 1.2;
+static const double B = 0.75;
+static const double SymbolBonus = 2.0;
+
+// Identifier terms of `text`, lower case: each identifier, plus its
+// camelCase / snake_case parts when it has several
+static void collectTerms(QStringView text, QHash<QString, int> &terms)
+{
+    const qsizetype n = text.size();
+    qsizetype i = 0;
+    while (i < n) {
+        const QChar c = text.at(i);
+        if (!(c.isLetter() || c == QLatin1Char('_'))) {
+            ++i;
+            continue;
+        }
+        qsizetype end = i + 1;
+        while (end < n && (text.at(end).isLetterOrNumber() || text.at(end) == QLatin1Char('_'))) ++end;
+        const QStringView word = text.mid(i, end - i);
+        i = end;
+        if (word.size() < 2) continue;
+        terms[word.toString().toLower()]++;
+
+        // Parts: split on '_' and before an upper case letter following a lower case one
+        QVector<QStringView> parts;
+        qsizetype start = 0;
+        for (qsizetype k = 1; k <= word.size(); ++k) {
+            const bool atEnd = k == word.size();
+            const bool split = atEnd || word.at(k) == QLatin1Char('_') || word.at(k - 1) == QLatin1Char('_')
+                               || (word.at(k).isUpper() && word.at(k - 1).isLower());
+            if (!split) continue;
+            const QStringView part = word.mid(start, k - start);
+            if (part != QLatin1String("_")) parts.append(part);
+            start = k;
+        }
+        if (parts.size() < 2) continue;
+        for (QStringView part : std::as_const(parts)) {
+            if (part.size() >= 2 && part != QLatin1String("_")) terms[part.toString().toLower()]++;
+        }
+    }
+}
+
+// Name defined by a line of code, if it looks like a definition
+static QString definedSymbol(const QString &line)
+{
+    static const QRegularExpression declaration(
+        "\\b(?:class|struct|enum|union|namespace|interface|def|fn|func|function|type)\\s+([A-Za-z_]\\w*)");
+    static const QRegularExpression function("([A-Za-z_]\\w*)\\s*\\(");
+
+    QRegularExpressionMatch m = declaration.match(line);
+    if (m.hasMatch()) return m.captured(1).toLower();
+    // Top-level function definition: starts at column 0, is not a statement
+    if (line.isEmpty() || line.at(0).isSpace() || line.trimmed().endsWith(QLatin1Char(';'))) return QString();
+    m = function.match(line);
+    if (!m.hasMatch()) return QString();
+    const QString name = m.captured(1);
+    if (name == "if" || name == "for" || name == "while" || name == "switch" || name == "return") return QString();
+    return name.toLower();
+}
+
+void ProjectIndex::setRoot(const QString &root)
+{
+    rootPath = root;
+    files.clear();
+    fileByPath.clear();
+    chunks.clear();
+    postings.clear();
+    documentFrequency.clear();
+    liveChunks = deadChunks = 0;
+    totalLength = 0;
+    queue.clear();
+    searchCache.setMaxCost(SearchCacheSize);
+    searchCache.clear();
+    ++revision;
+    rescan();
+}
+
+void ProjectIndex::rescan()
+{
+    if (rootPath.isEmpty()) return;
+    pendingDirectories = QStringList() << QString();
+    for (File &file : files) file.seen = false;
+    scanDone = false;
+}
+
+bool ProjectIndex::indexStep()
+{
+    if (!pendingDirectories.isEmpty()) {
+        for (int i = 0; i < StepDirectories && !pendingDirectories.isEmpty(); ++i) {
+            scanDirectory(pendingDirectories.takeLast());
+        }
+        return true;
+    }
+    if (!scanDone) {
+        finishScan();
+        return !queue.isEmpty();
+    }
+    if (queue.isEmpty()) return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!queue.isEmpty() && timer.elapsed() < StepMilliseconds) {
+        indexFile(queue.takeLast());
+    }
+    ++revision;
+    if (deadChunks > 1000 && deadChunks > liveChunks) compact();
+    return !queue.isEmpty();
+}
+
+void ProjectIndex::scanDirectory(const QString &relative)
+{
+    const QDir dir(relative.isEmpty() ? rootPath : rootPath + QLatin1Char('/') + relative);
+    const QFileInfoList entries = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+    for (const QFileInfo &info : entries) {
+        const QString name = info.fileName();
+        // Hidden directories (.git, .editerako, ...) and build trees are not the project's code
+        if (name.startsWith(QLatin1Char('.'))) continue;
+        const QString path = relative.isEmpty() ? name : relative + QLatin1Char('/') + name;
+        if (info.isDir()) {
+            if (name == "node_modules" || QFileInfo::exists(info.filePath() + "/CMakeCache.txt")) continue;
+            pendingDirectories.append(path);
+            continue;
+        }
+        if (info.size() > MaxIndexedFileSize) continue;
+
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        auto it = fileByPath.constFind(path);
+        if (it != fileByPath.cend()) {
+            File &file = files[it.value()];
+            file.seen = true;
+            if (file.size != info.size() || file.modified != modified) {
+                file.size = info.size();
+                file.modified = modified;
+                queue.append(it.value());
+            }
+            continue;
+        }
+        if (fileByPath.size() >= MaxIndexedFiles) continue;
+        File file;
+        file.path = path;
+        file.size = info.size();
+        file.modified = modified;
+        file.seen = true;
+        fileByPath.insert(path, files.size());
+        queue.append(files.size());
+        files.append(file);
+    }
+}
+
+// The files not seen by the scan are gone
+void ProjectIndex::finishScan()
+{
+    scanDone = true;
+    for (int i = 0; i < files.size(); ++i) {
+        File &file = files[i];
+        if (file.seen || file.path.isEmpty()) continue;
+        removeChunks(file);
+        fileByPath.remove(file.path);
+        file.path.clear();
+    }
+    ++revision;
+}
+
+void ProjectIndex::indexFile(int index)
+{
+    File &file = files[index];
+    removeChunks(file);
+    if (file.path.isEmpty()) return;
+
+    QFile f(rootPath + QLatin1Char('/') + file.path);
+    if (!f.open(QIODevice::ReadOnly)) return;
+    const QByteArray data = f.readAll();
+    // Binary file
+    if (data.left(4096).contains('\0')) return;
+
+    QStringDecoder decoder(QStringDecoder::Utf8);
+    const QString text = decoder.decode(data);
+    const QStringList lines = text.split(QLatin1Char('\n'));
+
+    for (int first = 0; first < lines.size(); first += ChunkLines) {
+        const int last = qMin<int>(lines.size(), first + ChunkLines);
+        QHash<QString, int> counts;
+        Chunk chunk;
+        chunk.file = index;
+        chunk.firstLine = first + 1;
+        chunk.lastLine = last;
+        chunk.alive = true;
+        chunk.length = 0;
+        for (int i = first; i < last; ++i) {
+            collectTerms(lines.at(i), counts);
+            const QString symbol = definedSymbol(lines.at(i));
+            if (!symbol.isEmpty()) chunk.symbols.insert(symbol);
+        }
+        if (counts.isEmpty()) continue;
+
+        const int id = chunks.size();
+        chunk.terms.reserve(counts.size());
+        for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+            chunk.terms.append({ it.key(), it.value() });
+            chunk.length += it.value();
+            postings[it.key()].append({ id, it.value() });
+            documentFrequency[it.key()]++;
+        }
+        totalLength += chunk.length;
+        ++liveChunks;
+        file.chunks.append(id);
+        chunks.append(std::move(chunk));
+    }
+}
+
+// The postings of dead chunks stay until compact(); searches skip them
+void ProjectIndex::removeChunks(File &file)
+{
+    for (int id : std::as_const(file.chunks)) {
+        Chunk &chunk = chunks[id];
+        for (const auto &term : std::as_const(chunk.terms)) {
+            auto df = documentFrequency.find(term.first);
+            if (df != documentFrequency.end() && --df.value() <= 0) documentFrequency.erase(df);
+        }
+        totalLength -= chunk.length;
+        chunk.alive = false;
+        chunk.terms.clear();
+        chunk.symbols.clear();
+        --liveChunks;
+        ++deadChunks;
+    }
+    file.chunks.clear();
+}
+
+void ProjectIndex::compact()
+{
+    QVector<Chunk> live;
+    live.reserve(liveChunks);
+    postings.clear();
+    for (File &file : files) {
+        for (int &id : file.chunks) {
+            const int newId = live.size();
+            live.append(std::move(chunks[id]));
+            for (const auto &term : std::as_const(live.last().terms)) {
+                postings[term.first].append({ newId, term.second });
+            }
+            id = newId;
+        }
+    }
+    chunks.swap(live);
+    deadChunks = 0;
+    ++revision;
+}
+
+QVector<ProjectSnippet> ProjectIndex::search(const QString &query, int limit)
+{
+    QHash<QString, int> counts;
+    collectTerms(query, counts);
+    QStringList terms = counts.keys();
+    terms.sort();
+    if (terms.size() > MaxQueryTerms) terms = terms.mid(0, MaxQueryTerms);
+
+    const QString cacheKey = QString::number(revision) + QLatin1Char('/') + QString::number(limit)
+                             + QLatin1Char('/') + terms.join(QLatin1Char(' '));
+    if (const QVector<ProjectSnippet> *cached = searchCache.object(cacheKey)) return *cached;
+
+    QVector<ProjectSnippet> result;
+    if (liveChunks == 0 || terms.isEmpty()) return result;
+
+    const double averageLength = double(totalLength) / liveChunks;
+    QHash<int, double> scores;
+    QHash<QString, double> idfs;
+    for (const QString &term : std::as_const(terms)) {
+        const int df = documentFrequency.value(term);
+        if (df == 0) continue;
+        const double idf = std::log(1.0 + (liveChunks - df + 0.5) / (df + 0.5));
+        idfs.insert(term, idf);
+        for (const Posting &p : postings.value(term)) {
+            const Chunk &chunk = chunks.at(p.chunk);
+            if (!chunk.alive) continue;
+            const double tf = p.frequency;
+            scores[p.chunk] += idf * tf * (K1 + 1) / (tf + K1 * (1 - B + B * chunk.length / averageLength));
+        }
+    }
+    for (auto it = scores.begin(); it != scores.end(); ++it) {
+        const Chunk &chunk = chunks.at(it.key());
+        for (auto idf = idfs.cbegin(); idf != idfs.cend(); ++idf) {
+            if (chunk.symbols.contains(idf.key())) it.value() += SymbolBonus * idf.value();
+        }
+    }
+
+    QVector<QPair<double, int>> ranked;
+    ranked.reserve(scores.size());
+    for (auto it = scores.cbegin(); it != scores.cend(); ++it) ranked.append({ it.value(), it.key() });
+    const int count = qMin<int>(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                      [](const QPair<double, int> &a, const QPair<double, int> &b) { return a.first > b.first; });
+
+    // The text of the chunks, from the files as they are now
+    QHash<int, QStringList> fileLines;
+    for (int i = 0; i < count; ++i) {
+        const Chunk &chunk = chunks.at(ranked.at(i).second);
+        const File &file = files.at(chunk.file);
+        auto lines = fileLines.find(chunk.file);
+        if (lines == fileLines.end()) {
+            QFile f(rootPath + QLatin1Char('/') + file.path);
+            QStringList read;
+            if (f.open(QIODevice::ReadOnly)) {
+                QStringDecoder decoder(QStringDecoder::Utf8);
+                read = QString(decoder.decode(f.readAll())).split(QLatin1Char('\n'));
+            }
+            lines = fileLines.insert(chunk.file, read);
+        }
+        if (lines->size() < chunk.firstLine) continue;
+
+        ProjectSnippet snippet;
+        snippet.path = file.path;
+        snippet.firstLine = chunk.firstLine;
+        snippet.lastLine = qMin<int>(chunk.lastLine, lines->size());
+        snippet.text = lines->mid(chunk.firstLine - 1, snippet.lastLine - chunk.firstLine + 1).join(QLatin1Char('\n'));
+        snippet.score = ranked.at(i).first;
+        result.append(snippet);
+    }
+
+    searchCache.insert(cacheKey, new QVector<ProjectSnippet>(result));
+    return result;
+}
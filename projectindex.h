@@ -0,0 +1,90 @@
+#ifndef PROJECTINDEX_H
+#define PROJECTINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QCache>
+
+struct ProjectSnippet
+{
+    QString path;               // relative to the project root
+    int firstLine = 0;          // 1-based
+    int lastLine = 0;
+    QString text;
+    double score = 0;
+};
+
+// Search index over the text files of a project, for the chat context.
+//
+// Files are cut into chunks of a few dozen lines; chunks are ranked for a
+// query with BM25 over identifier terms (whole identifiers and their
+// camelCase / snake_case parts), with a bonus when the chunk defines a
+// symbol named in the query. Only the terms are kept in memory: the text of
+// the chosen chunks is read back from disk. Files are indexed in batches
+// (indexStep) and compared by size and modification time on a rescan, so a
+// refresh reads only what changed. Not thread-safe: one thread at a time.
+class ProjectIndex
+{
+public:
+    // Forgets everything; the files are listed by the following steps
+    void setRoot(const QString &root);
+    QString root() const { return rootPath; }
+
+    // Lists the files again (on the next steps); the unchanged ones are kept
+    void rescan();
+    // Does a bounded amount of work; false when the index is up to date
+    bool indexStep();
+    bool isComplete() const { return scanDone && queue.isEmpty(); }
+
+    QVector<ProjectSnippet> search(const QString &query, int limit);
+
+private:
+    struct Posting {
+        int chunk;
+        int frequency;
+    };
+    struct Chunk {
+        int file;
+        int firstLine;
+        int lastLine;
+        int length;             // terms
+        bool alive;
+        QVector<QPair<QString, int>> terms;
+        QSet<QString> symbols;  // names defined in the chunk
+    };
+    struct File {
+        QString path;           // relative
+        qint64 size = 0;
+        qint64 modified = 0;
+        QVector<int> chunks;
+        bool seen = false;      // by the current scan
+    };
+
+    QString rootPath;
+    QVector<File> files;
+    QHash<QString, int> fileByPath;
+    QVector<Chunk> chunks;
+    QHash<QString, QVector<Posting>> postings;
+    QHash<QString, int> documentFrequency;
+    int liveChunks = 0;
+    int deadChunks = 0;
+    qint64 totalLength = 0;
+    quint64 revision = 0;       // changes with the index (search cache key)
+
+    QStringList pendingDirectories;
+    QVector<int> queue;         // files to (re)index
+    bool scanDone = true;
+
+    QCache<QString, QVector<ProjectSnippet>> searchCache;
+
+    void scanDirectory(const QString &relative);
+    void finishScan();
+    void indexFile(int file);
+    void removeChunks(File &file);
+    void compact();
+};
+
+#endif // PROJECTINDEX_H
@@ -0,0 +1,419 @@
+#include "projectreplacedialog.h"
+#include "codeeditor.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringDecoder>
+#include <QColor>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Files bigger than this are not rewritten by a project-wide replace
+static const qint64 MaxReplaceFileSize = 8 * 1024 * 1024;
+
+// Input of the parallel scan: a file on disk or a snapshot of an open buffer
+struct FileScanJob
+{
+    QString filePath;
+    QPointer<CodeEditor> editor;
+    QString bufferText;
+    int documentRevision = -1;
+};
+
+static FileEditList scanFile(const FileScanJob &job, const SearchOptions &options, const QString &replaceWith)
+{
+    FileEditList result;
+    result.filePath = job.filePath;
+    result.editor = job.editor;
+    result.documentRevision = job.documentRevision;
+
+    QString text;
+    if (job.editor) {
+        text = job.bufferText;
+    } else {
+        QFile file(job.filePath);
+        if (!file.open(QIODevice::ReadOnly)) return result;
+        QFileInfo info(file);
+        result.lastModified = info.lastModified();
+        result.size = info.size();
+        QByteArray bytes = file.readAll();
+        file.close();
+
+        // Skip binary files and anything that is not valid UTF-8
+        if (bytes.left(8192).contains('\0')) return result;
+        QStringDecoder decoder(QStringDecoder::Utf8);
+        text = decoder.decode(bytes);
+        if (decoder.hasError()) return result;
+        result.originalBytes = bytes;
+    }
+
+    result.edits = SearchEngine::computeReplacements(text, options, replaceWith);
+    if (result.edits.isEmpty()) {
+        result.originalBytes.clear();
+        return result;
+    }
+    result.preview = SearchEngine::buildPreview(text, result.edits);
+    if (!job.editor) {
+        result.newText = SearchEngine::applyReplacements(text, result.edits);
+    }
+    return result;
+}
+
+ProjectReplaceDialog::ProjectReplaceDialog(const QString &rootPath, const QList<CodeEditor*> &editors,
+                                           QWidget *parent)
+    : QDialog(parent), rootPath(rootPath), watcher(new QFutureWatcher<FileEditList>(this))
+{
+    for (CodeEditor *ed : editors) {
+        openEditors.append(ed);
+    }
+
+    setWindowTitle(tr("Replace in Files"));
+    setMinimumSize(720, 520);
+
+    setStyleSheet(
+        "QDialog {"
+        "    background-color: #1e1e1e;"
+        "    color: #cccccc;"
+        "}"
+        "QLabel {"
+        "    color: #cccccc;"
+        "    font-size: 12px;"
+        "}"
+        "QLineEdit {"
+        "    background-color: #3e3e42;"
+        "    border: 1px solid #6f6f6f;"
+        "    border-radius: 4px;"
+        "    color: #cccccc;"
+        "    padding: 8px;"
+        "    font-size: 12px;"
+        "    selection-background-color: #264f78;"
+        "}"
+        "QLineEdit:focus {"
+        "    border: 1px solid #98c379;"
+        "}"
+        "QCheckBox {"
+        "    color: #cccccc;"
+        "    font-size: 11px;"
+        "}"
+        "QTreeWidget {"
+        "    background-color: #252526;"
+        "    border: 1px solid #3e3e42;"
+        "    color: #cccccc;"
+        "    font-family: 'Consolas', 'Monaco', monospace;"
+        "    font-size: 12px;"
+        "}"
+        "QPushButton {"
+        "    background-color: #3e3e42;"
+        "    border: 1px solid #6f6f6f;"
+        "    border-radius: 4px;"
+        "    color: #cccccc;"
+        "    padding: 8px 16px;"
+        "    font-size: 11px;"
+        "    min-width: 80px;"
+        "}"
+        "QPushButton:hover {"
+        "    background-color: #6f6f6f;"
+        "}"
+        "QPushButton:disabled {"
+        "    color: #6f6f6f;"
+        "}"
+        "QPushButton#applyButton {"
+        "    background-color: #e5c07b;"
+        "    color: #1e1e1e;"
+        "    font-weight: bold;"
+        "    border: none;"
+        "}"
+        );
+
+    searchLineEdit = new QLineEdit;
+    searchLineEdit->setPlaceholderText(tr("Search text..."));
+    replaceLineEdit = new QLineEdit;
+    replaceLineEdit->setPlaceholderText(tr("Replace with..."));
+    caseSensitiveCheckBox = new QCheckBox(tr("Case sensitive"));
+    regexCheckBox = new QCheckBox(tr("Use Regular Expression"));
+
+    previewTree = new QTreeWidget;
+    previewTree->setHeaderHidden(true);
+    previewTree->setUniformRowHeights(true);
+
+    statusLabel = new QLabel(tr("Root: %1").arg(QDir::toNativeSeparators(rootPath)));
+
+    previewButton = new QPushButton(tr("Preview"));
+    applyButton = new QPushButton(tr("Apply"));
+    applyButton->setObjectName("applyButton");
+    applyButton->setEnabled(false);
+    cancelButton = new QPushButton(tr("Cancel"));
+
+    connect(previewButton, &QPushButton::clicked, this, &ProjectReplaceDialog::startPreview);
+    connect(searchLineEdit, &QLineEdit::returnPressed, this, &ProjectReplaceDialog::startPreview);
+    connect(applyButton, &QPushButton::clicked, this, &ProjectReplaceDialog::applyChanges);
+    connect(cancelButton, &QPushButton::clicked, this, &QDialog::reject);
+    connect(watcher, &QFutureWatcher<FileEditList>::finished, this, &ProjectReplaceDialog::onPreviewFinished);
+
+    // Any change of the query invalidates the preview
+    auto invalidate = [this]() {
+        applyButton->setEnabled(false);
+    };
+    connect(searchLineEdit, &QLineEdit::textChanged, this, invalidate);
+    connect(replaceLineEdit, &QLineEdit::textChanged, this, invalidate);
+    connect(caseSensitiveCheckBox, &QCheckBox::toggled, this, invalidate);
+    connect(regexCheckBox, &QCheckBox::toggled, this, invalidate);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->setSpacing(8);
+    mainLayout->setContentsMargins(16, 16, 16, 16);
+    mainLayout->addWidget(new QLabel(tr("Find:")));
+    mainLayout->addWidget(searchLineEdit);
+    mainLayout->addWidget(new QLabel(tr("Replace:")));
+    mainLayout->addWidget(replaceLineEdit);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout;
+    optionsLayout->setSpacing(20);
+    optionsLayout->addWidget(caseSensitiveCheckBox);
+    optionsLayout->addWidget(regexCheckBox);
+    optionsLayout->addStretch();
+    mainLayout->addLayout(optionsLayout);
+
+    mainLayout->addWidget(previewTree, 1);
+    mainLayout->addWidget(statusLabel);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout;
+    buttonsLayout->setSpacing(10);
+    buttonsLayout->addWidget(previewButton);
+    buttonsLayout->addWidget(applyButton);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(cancelButton);
+    mainLayout->addLayout(buttonsLayout);
+
+    setLayout(mainLayout);
+    searchLineEdit->setFocus();
+}
+
+ProjectReplaceDialog::~ProjectReplaceDialog()
+{
+    watcher->cancel();
+    watcher->waitForFinished();
+}
+
+SearchOptions ProjectReplaceDialog::currentOptions() const
+{
+    SearchOptions options;
+    options.pattern = searchLineEdit->text();
+    options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    options.useRegex = regexCheckBox->isChecked();
+    return options;
+}
+
+QStringList ProjectReplaceDialog::collectProjectFiles() const
+{
+    QStringList files;
+    QDirIterator it(rootPath, QDir::Files | QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+        // Hidden directories (.git, .editerako, ...) are never part of a replace
+        QString relative = QDir(rootPath).relativeFilePath(path);
+        if (relative.startsWith('.') || relative.contains("/.")) continue;
+        if (it.fileInfo().size() > MaxReplaceFileSize) continue;
+        files << path;
+    }
+    return files;
+}
+
+void ProjectReplaceDialog::startPreview()
+{
+    SearchOptions options = currentOptions();
+    if (!options.isValid()) {
+        statusLabel->setText(options.pattern.isEmpty() ? tr("Nothing to search for.")
+                                                       : tr("Invalid regular expression."));
+        return;
+    }
+    if (watcher->isRunning()) {
+        watcher->cancel();
+        watcher->waitForFinished();
+    }
+
+    results.clear();
+    previewTree->clear();
+    applyButton->setEnabled(false);
+    previewButton->setEnabled(false);
+    statusLabel->setText(tr("Searching..."));
+
+    // Open tabs are scanned from their buffer (which may hold unsaved edits)
+    QHash<QString, CodeEditor*> byPath;
+    for (const QPointer<CodeEditor> &ed : openEditors) {
+        if (!ed) continue;
+        QString path = ed->property("filePath").toString();
+        if (!path.isEmpty()) byPath.insert(QFileInfo(path).absoluteFilePath(), ed);
+    }
+
+    QList<FileScanJob> jobs;
+    for (const QString &path : collectProjectFiles()) {
+        FileScanJob job;
+        job.filePath = QFileInfo(path).absoluteFilePath();
+        if (CodeEditor *ed = byPath.value(job.filePath)) {
+            job.editor = ed;
+            job.bufferText = ed->toPlainText();
+            job.documentRevision = ed->document()->revision();
+        }
+        jobs.append(job);
+    }
+
+    const QString replaceWith = replaceLineEdit->text();
+    watcher->setFuture(QtConcurrent::mapped(jobs, [options, replaceWith](const FileScanJob &job) {
+        return scanFile(job, options, replaceWith);
+    }));
+}
+
+void ProjectReplaceDialog::onPreviewFinished()
+{
+    previewButton->setEnabled(true);
+    if (watcher->isCanceled()) return;
+
+    int totalEdits = 0;
+    const QList<FileEditList> all = watcher->future().results();
+    for (const FileEditList &file : all) {
+        if (file.edits.isEmpty()) continue;
+        results.append(file);
+        totalEdits += file.edits.size();
+    }
+    std::sort(results.begin(), results.end(), [](const FileEditList &a, const FileEditList &b) {
+        return a.filePath < b.filePath;
+    });
+
+    for (int i = 0; i < results.size(); ++i) {
+        const FileEditList &file = results.at(i);
+        QTreeWidgetItem *fileItem = new QTreeWidgetItem(previewTree);
+        QString label = QString("%1 (%2)").arg(QDir(rootPath).relativeFilePath(file.filePath))
+                                           .arg(file.edits.size());
+        if (file.editor) label += tr("  [open]");
+        fileItem->setText(0, label);
+        fileItem->setData(0, Qt::UserRole, i);
+        fileItem->setFlags(fileItem->flags() | Qt::ItemIsUserCheckable);
+        fileItem->setCheckState(0, Qt::Checked);
+
+        for (const PreviewLine &line : file.preview) {
+            QTreeWidgetItem *before = new QTreeWidgetItem(fileItem);
+            before->setText(0, QString("- %1: %2").arg(line.lineNumber).arg(line.before.trimmed()));
+            before->setForeground(0, QColor(224, 108, 117));
+            QTreeWidgetItem *after = new QTreeWidgetItem(fileItem);
+            after->setText(0, QString("+ %1: %2").arg(line.lineNumber).arg(line.after.trimmed()));
+            after->setForeground(0, QColor(152, 195, 121));
+        }
+        if (file.preview.size() < file.edits.size()) {
+            QTreeWidgetItem *more = new QTreeWidgetItem(fileItem);
+            more->setText(0, tr("..."));
+        }
+    }
+    if (results.size() <= 5) previewTree->expandAll();
+
+    statusLabel->setText(tr("%1 occurrence(s) in %2 file(s).").arg(totalEdits).arg(results.size()));
+    applyButton->setEnabled(!results.isEmpty());
+}
+
+// Nothing may have changed between the preview and the apply, otherwise the
+// computed offsets would be wrong.
+bool ProjectReplaceDialog::verifyUnchanged(QString *error) const
+{
+    for (const FileEditList &file : results) {
+        if (file.documentRevision >= 0) {
+            if (!file.editor || file.editor->document()->revision() != file.documentRevision) {
+                *error = tr("%1 was edited or closed after the preview.").arg(file.filePath);
+                return false;
+            }
+            continue;
+        }
+        QFileInfo info(file.filePath);
+        if (!info.exists() || info.size() != file.size || info.lastModified() != file.lastModified) {
+            *error = tr("%1 changed on disk after the preview.").arg(file.filePath);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Closed files: every new content is staged first, then committed one by one;
+// files already committed are restored if a later commit fails.
+bool ProjectReplaceDialog::writeClosedFiles(QString *error)
+{
+    std::vector<std::unique_ptr<QSaveFile>> staged;
+    std::vector<const FileEditList*> stagedFiles;
+
+    for (const FileEditList &file : results) {
+        if (file.documentRevision >= 0) continue;
+        auto saveFile = std::make_unique<QSaveFile>(file.filePath);
+        QByteArray bytes = file.newText.toUtf8();
+        // The decoder dropped the file's byte order mark; it is written back
+        static const QByteArray Utf8Bom("\xEF\xBB\xBF");
+        if (file.originalBytes.startsWith(Utf8Bom)) bytes.prepend(Utf8Bom);
+        if (!saveFile->open(QIODevice::WriteOnly) || saveFile->write(bytes) != bytes.size()) {
+            *error = tr("Could not write %1: %2").arg(file.filePath, saveFile->errorString());
+            return false; // the staged QSaveFiles are discarded without touching the originals
+        }
+        staged.push_back(std::move(saveFile));
+        stagedFiles.push_back(&file);
+    }
+
+    for (size_t i = 0; i < staged.size(); ++i) {
+        if (staged[i]->commit()) continue;
+
+        *error = tr("Could not write %1: %2").arg(stagedFiles[i]->filePath, staged[i]->errorString());
+        for (size_t k = 0; k < i; ++k) {
+            QSaveFile restore(stagedFiles[k]->filePath);
+            if (!restore.open(QIODevice::WriteOnly)
+                || restore.write(stagedFiles[k]->originalBytes) != stagedFiles[k]->originalBytes.size()
+                || !restore.commit()) {
+                *error += "\n" + tr("Could not restore %1!").arg(stagedFiles[k]->filePath);
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+void ProjectReplaceDialog::applyChanges()
+{
+    // Only the files still checked in the preview take part
+    QList<FileEditList> selected;
+    for (int i = 0; i < previewTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = previewTree->topLevelItem(i);
+        if (item->checkState(0) == Qt::Checked) {
+            selected.append(results.at(item->data(0, Qt::UserRole).toInt()));
+        }
+    }
+    results = selected;
+    if (results.isEmpty()) return;
+
+    QString error;
+    if (!verifyUnchanged(&error) || !writeClosedFiles(&error)) {
+        QMessageBox::warning(this, tr("Replace in Files"),
+                             tr("No file was modified.\n%1").arg(error));
+        applyButton->setEnabled(false);
+        return;
+    }
+
+    // Open buffers: one undo step per tab, nothing is written to disk
+    int count = 0;
+    for (const FileEditList &file : results) {
+        if (file.documentRevision >= 0 && file.editor) {
+            SearchEngine::applyReplacements(file.editor->document(), file.edits);
+        }
+        count += file.edits.size();
+    }
+
+    QMessageBox::information(this, tr("Replace in Files"),
+                             tr("Replaced %1 occurrence(s) in %2 file(s).").arg(count).arg(results.size()));
+    accept();
+}
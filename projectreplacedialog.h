@@ -0,0 +1,70 @@
+#ifndef PROJECTREPLACEDIALOG_H
+#define PROJECTREPLACEDIALOG_H
+
+#include <QDialog>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QList>
+#include <QPointer>
+#include "searchengine.h"
+
+QT_BEGIN_NAMESPACE
+class QLineEdit;
+class QCheckBox;
+class QPushButton;
+class QTreeWidget;
+class QLabel;
+QT_END_NAMESPACE
+
+class CodeEditor;
+
+// Edits computed for one file of the project
+struct FileEditList
+{
+    QString filePath;
+    QPointer<CodeEditor> editor;   // set when the file is open in a tab
+    int documentRevision = -1;     // revision of the open buffer when it was scanned
+    QByteArray originalBytes;      // closed files only: content on disk when scanned
+    QDateTime lastModified;
+    qint64 size = -1;
+    QString newText;               // closed files only: content after replacement
+    QVector<TextReplacement> edits;
+    QVector<PreviewLine> preview;
+};
+
+class ProjectReplaceDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    ProjectReplaceDialog(const QString &rootPath, const QList<CodeEditor*> &openEditors,
+                         QWidget *parent = nullptr);
+    ~ProjectReplaceDialog();
+
+private slots:
+    void startPreview();
+    void onPreviewFinished();
+    void applyChanges();
+
+private:
+    QString rootPath;
+    QList<QPointer<CodeEditor>> openEditors;
+    QList<FileEditList> results;
+    QFutureWatcher<FileEditList> *watcher;
+
+    QLineEdit *searchLineEdit;
+    QLineEdit *replaceLineEdit;
+    QCheckBox *caseSensitiveCheckBox;
+    QCheckBox *regexCheckBox;
+    QTreeWidget *previewTree;
+    QLabel *statusLabel;
+    QPushButton *previewButton;
+    QPushButton *applyButton;
+    QPushButton *cancelButton;
+
+    SearchOptions currentOptions() const;
+    QStringList collectProjectFiles() const;
+    bool verifyUnchanged(QString *error) const;
+    bool writeClosedFiles(QString *error);
+};
+
+#endif // PROJECTREPLACEDIALOG_H
@@ -0,0 +1,320 @@
+#include "ptyprocess.h"
+#include <QThread>
+#include <QSocketNotifier>
+#include <QFile>
+#include <QStandardPaths>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#if defined(Q_OS_MACOS) || defined(Q_OS_FREEBSD) || defined(Q_OS_OPENBSD)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#endif
+
+// Size of one read from the master side
+static const int ReadChunkSize = 64 * 1024;
+
+PtyProcess::PtyProcess(QObject *parent)
+    : QObject(parent)
+    , masterFd(-1)
+    , childPid(-1)
+    , exitCode(-1)
+    , reaped(false)
+    , reader(nullptr)
+    , writeNotifier(nullptr)
+    , notifyPending(false)
+{
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+PtyProcess::~PtyProcess()
+{
+    terminate();
+}
+
+#ifdef Q_OS_WIN
+
+bool PtyProcess::start(const QString &, const QStringList &, const QString &, int, int)
+{
+    return false;
+}
+
+qsizetype PtyProcess::read(char *, qsizetype) { return 0; }
+void PtyProcess::write(const QByteArray &) {}
+void PtyProcess::resize(int, int) {}
+void PtyProcess::terminate() {}
+void PtyProcess::flushPendingWrites() {}
+void PtyProcess::onReaderFinished() {}
+void PtyProcess::readLoop() {}
+bool PtyProcess::queueOutput(const char *, qsizetype) { return false; }
+void PtyProcess::closeFds() {}
+
+#else
+
+bool PtyProcess::start(const QString &program, const QStringList &arguments,
+                       const QString &workingDirectory, int columns, int rows)
+{
+    if (isRunning()) return false;
+
+    // Everything the child needs is prepared before fork(): other threads
+    // run, so the child may only make async-signal-safe calls (no setenv,
+    // no PATH search in execvp)
+    const QString executable = program.contains(QLatin1Char('/'))
+                                   ? program : QStandardPaths::findExecutable(program);
+    if (executable.isEmpty()) return false;
+    const QByteArray path = QFile::encodeName(executable);
+
+    std::vector<QByteArray> argStorage;
+    argStorage.push_back(QFile::encodeName(program));
+    for (const QString &arg : arguments) argStorage.push_back(arg.toLocal8Bit());
+    std::vector<char *> argv;
+    for (QByteArray &arg : argStorage) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    const QByteArray cwd = QFile::encodeName(workingDirectory);
+
+    // Our environment, with the terminal type set and no stale size
+    std::vector<QByteArray> envStorage;
+    for (char **entry = environ; entry && *entry; ++entry) {
+        const QByteArray variable(*entry);
+        if (variable.startsWith("TERM=") || variable.startsWith("COLORTERM=")
+            || variable.startsWith("COLUMNS=") || variable.startsWith("LINES=")) {
+            continue;
+        }
+        envStorage.push_back(variable);
+    }
+    envStorage.push_back("TERM=xterm-256color");
+    envStorage.push_back("COLORTERM=truecolor");
+    std::vector<char *> envp;
+    for (QByteArray &variable : envStorage) envp.push_back(variable.data());
+    envp.push_back(nullptr);
+
+    struct winsize ws = {};
+    ws.ws_col = static_cast<unsigned short>(qMax(columns, 1));
+    ws.ws_row = static_cast<unsigned short>(qMax(rows, 1));
+
+    // Close-on-exec before forkpty(), or the shell inherits both ends
+    if (::pipe(wakePipe) != 0) return false;
+    ::fcntl(wakePipe[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(wakePipe[1], F_SETFD, FD_CLOEXEC);
+
+    int fd = -1;
+    pid_t pid = ::forkpty(&fd, nullptr, nullptr, &ws);
+    if (pid < 0) {
+        closeFds();
+        return false;
+    }
+    if (pid == 0) {
+        // Child: new session with the pty as controlling terminal (done by forkpty)
+        if (!cwd.isEmpty() && ::chdir(cwd.constData()) != 0) { /* stay where we are */ }
+        ::signal(SIGPIPE, SIG_DFL);
+        ::execve(path.constData(), argv.data(), envp.data());
+        ::_exit(127);
+    }
+
+    masterFd = fd;
+    childPid = pid;
+    exitCode = -1;
+    reaped = false;
+    output.clear();
+    notifyPending = false;
+    ::fcntl(masterFd, F_SETFL, ::fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(masterFd, F_SETFD, FD_CLOEXEC);
+
+    writeNotifier = new QSocketNotifier(masterFd, QSocketNotifier::Write, this);
+    writeNotifier->setEnabled(false);
+    connect(writeNotifier, &QSocketNotifier::activated, this, &PtyProcess::flushPendingWrites);
+
+    reader = QThread::create([this]() { readLoop(); });
+    connect(reader, &QThread::finished, this, &PtyProcess::onReaderFinished);
+    reader->start();
+    return true;
+}
+
+void PtyProcess::readLoop()
+{
+    QByteArray buffer(ReadChunkSize, Qt::Uninitialized);
+    struct pollfd fds[2];
+    fds[0].fd = masterFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakePipe[0];
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        fds[0].revents = fds[1].revents = 0;
+        int n = ::poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break; // terminate() asked us to stop
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t got = ::read(masterFd, buffer.data(), buffer.size());
+            if (got > 0) {
+                if (!queueOutput(buffer.constData(), got)) return;
+                continue;
+            }
+            if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            break; // EOF or EIO: the slave side is closed, the shell is gone
+        }
+    }
+
+    if (fds[1].revents) return;
+
+    // The slave side closes while the child exits: reap it here so the exit
+    // code is known when the thread ends (bounded, the child may linger)
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        int status = 0;
+        pid_t r = ::waitpid(static_cast<pid_t>(childPid), &status, WNOHANG);
+        if (r == childPid) {
+            exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            reaped = true;
+            return;
+        }
+        if (r < 0 && errno != EINTR) return;
+        QThread::msleep(10);
+    }
+}
+
+// Reader thread: hand the bytes to the ring, waiting while it is full.
+// Returns false when terminate() interrupted the wait.
+bool PtyProcess::queueOutput(const char *data, qsizetype size)
+{
+    qsizetype done = 0;
+    while (done < size) {
+        qsizetype n = output.write(data + done, size - done);
+        done += n;
+        if (n > 0 && !notifyPending.exchange(true)) emit readyRead();
+        if (done < size) {
+            // The GUI drains the ring once per frame; sleep on the wake pipe meanwhile
+            struct pollfd wake = { wakePipe[0], POLLIN, 0 };
+            if (::poll(&wake, 1, 4) > 0) return false;
+        }
+    }
+    return true;
+}
+
+qsizetype PtyProcess::read(char *data, qsizetype maxSize)
+{
+    // Cleared first: bytes queued from now on trigger a new readyRead()
+    notifyPending = false;
+    return output.read(data, maxSize);
+}
+
+void PtyProcess::onReaderFinished()
+{
+    // Ignore the notification of a reader already joined by terminate()
+    if (!reader || sender() != reader) return;
+    reader->deleteLater();
+    reader = nullptr;
+
+    if (reaped) {
+        childPid = -1;
+        closeFds();
+    } else {
+        terminate();
+    }
+    emit finished(exitCode);
+}
+
+void PtyProcess::write(const QByteArray &data)
+{
+    if (masterFd < 0 || data.isEmpty()) return;
+    if (!pendingWrite.isEmpty()) {
+        pendingWrite += data;
+        return;
+    }
+
+    ssize_t written = ::write(masterFd, data.constData(), data.size());
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EINTR) return;
+        written = 0;
+    }
+    if (written < data.size()) {
+        pendingWrite = data.mid(written);
+        writeNotifier->setEnabled(true);
+    }
+}
+
+void PtyProcess::flushPendingWrites()
+{
+    if (masterFd < 0) {
+        pendingWrite.clear();
+        return;
+    }
+    ssize_t written = ::write(masterFd, pendingWrite.constData(), pendingWrite.size());
+    if (written > 0) pendingWrite.remove(0, written);
+    else if (written < 0 && errno != EAGAIN && errno != EINTR) pendingWrite.clear();
+    writeNotifier->setEnabled(!pendingWrite.isEmpty());
+}
+
+void PtyProcess::resize(int columns, int rows)
+{
+    if (masterFd < 0) return;
+    struct winsize ws = {};
+    ws.ws_col = static_cast<unsigned short>(qMax(columns, 1));
+    ws.ws_row = static_cast<unsigned short>(qMax(rows, 1));
+    ::ioctl(masterFd, TIOCSWINSZ, &ws); // the kernel sends SIGWINCH to the foreground group
+}
+
+void PtyProcess::terminate()
+{
+    if (reader) {
+        char wake = 1;
+        if (::write(wakePipe[1], &wake, 1) < 0) { /* the reader is already done */ }
+        reader->wait();
+        delete reader;
+        reader = nullptr;
+    }
+    if (childPid > 0 && !reaped) {
+        // Hang up the whole session, then force it if it does not go away
+        ::kill(static_cast<pid_t>(-childPid), SIGHUP);
+        ::kill(static_cast<pid_t>(childPid), SIGHUP);
+        int status = 0;
+        pid_t r = ::waitpid(static_cast<pid_t>(childPid), &status, WNOHANG);
+        for (int attempt = 0; r == 0 && attempt < 5; ++attempt) {
+            QThread::msleep(10);
+            r = ::waitpid(static_cast<pid_t>(childPid), &status, WNOHANG);
+        }
+        if (r == 0) {
+            ::kill(static_cast<pid_t>(-childPid), SIGKILL);
+            ::kill(static_cast<pid_t>(childPid), SIGKILL);
+            ::waitpid(static_cast<pid_t>(childPid), &status, 0);
+        }
+        if (r == childPid || r == 0) {
+            exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+    }
+    childPid = -1;
+    reaped = false;
+    closeFds();
+}
+
+void PtyProcess::closeFds()
+{
+    delete writeNotifier;
+    writeNotifier = nullptr;
+    pendingWrite.clear();
+    if (masterFd >= 0) ::close(masterFd);
+    masterFd = -1;
+    for (int &fd : wakePipe) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef PTYPROCESS_H
+#define PTYPROCESS_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include "bytering.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+class QSocketNotifier;
+QT_END_NAMESPACE
+
+// A child process attached to a pseudo-terminal (forkpty).
+//
+// The master side is read on a dedicated thread (poll + read) into a lock-free
+// ring; the GUI thread drains it with read() after readyRead(). While the
+// ring is full the reader stops reading, so a fast writer is throttled by the
+// tty instead of growing memory. Writes never block: what the tty does not
+// accept right away is queued and flushed when the fd is writable.
+// Not available on Windows: start() returns false there.
+class PtyProcess : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PtyProcess(QObject *parent = nullptr);
+    ~PtyProcess();
+
+    bool start(const QString &program, const QStringList &arguments,
+               const QString &workingDirectory, int columns, int rows);
+    bool isRunning() const { return childPid > 0; }
+    qint64 pid() const { return childPid; }
+
+    // Takes queued output (GUI thread)
+    qsizetype read(char *data, qsizetype maxSize);
+    bool hasPendingOutput() const { return !output.isEmpty(); }
+
+    void write(const QByteArray &data);
+    void resize(int columns, int rows);
+    // Hang up the session and reap the child
+    void terminate();
+
+signals:
+    // Emitted from the reader thread when output is queued; not emitted again
+    // until read() is called
+    void readyRead();
+    void finished(int exitCode);
+
+private slots:
+    void flushPendingWrites();
+    void onReaderFinished();
+
+private:
+    int masterFd;
+    int wakePipe[2];
+    qint64 childPid;
+    int exitCode;
+    bool reaped;      // written by the reader thread before it ends
+    QThread *reader;
+    QSocketNotifier *writeNotifier;
+    QByteArray pendingWrite;
+    ByteRing output;
+    std::atomic<bool> notifyPending;
+
+    void readLoop();
+    bool queueOutput(const char *data, qsizetype size);
+    void closeFds();
+};
+
+#endif // PTYPROCESS_H
@@ -0,0 +1,64 @@
+#include "regexcache.h"
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+
+// Enough for the patterns of a session (find dialog history, terminal, highlighter)
+static const int CacheCapacity = 64;
+
+namespace {
+struct CacheState
+{
+    QMutex mutex;
+    QCache<QString, QRegularExpression> entries{CacheCapacity};
+    quint64 hits = 0;
+    quint64 misses = 0;
+};
+}
+
+static CacheState &state()
+{
+    static CacheState s;
+    return s;
+}
+
+QRegularExpression RegexCache::get(const QString &pattern, QRegularExpression::PatternOptions options)
+{
+    const QString key = QString::number(options.toInt()) + QLatin1Char(':') + pattern;
+
+    CacheState &s = state();
+    QMutexLocker locker(&s.mutex);
+    if (QRegularExpression *cached = s.entries.object(key)) {
+        ++s.hits;
+        return *cached;
+    }
+    ++s.misses;
+    locker.unlock();
+
+    // Compile outside the lock; a concurrent miss on the same key just inserts twice
+    QRegularExpression *regex = new QRegularExpression(pattern, options);
+    regex->optimize();
+    const QRegularExpression result = *regex;
+
+    locker.relock();
+    s.entries.insert(key, regex);
+    return result;
+}
+
+quint64 RegexCache::hits()
+{
+    QMutexLocker locker(&state().mutex);
+    return state().hits;
+}
+
+quint64 RegexCache::misses()
+{
+    QMutexLocker locker(&state().mutex);
+    return state().misses;
+}
+
+void RegexCache::clear()
+{
+    QMutexLocker locker(&state().mutex);
+    state().entries.clear();
+}
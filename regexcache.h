@@ -0,0 +1,21 @@
+#ifndef REGEXCACHE_H
+#define REGEXCACHE_H
+
+#include <QString>
+#include <QRegularExpression>
+
+// Process-wide LRU of compiled regular expressions, keyed by pattern and
+// options. Every entry is optimized (compiled + JIT) once when it is inserted,
+// so search loops that reuse the same pattern never pay for recompilation.
+// Returned objects are implicitly shared copies; safe to use from any thread.
+namespace RegexCache
+{
+    QRegularExpression get(const QString &pattern,
+                           QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption);
+
+    quint64 hits();
+    quint64 misses();
+    void clear();
+}
+
+#endif // REGEXCACHE_H
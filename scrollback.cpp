@@ -0,0 +1,223 @@
+#include "scrollback.h"
+#include <cstring>
+
+// Pages unpacked at the same time for reading (a screenful spans one or two)
+static const int UnpackedPageCache = 8;
+// Bytes per cell in a packed page: char, foreground, background, flags, width
+static const int PackedCellSize = 16;
+
+Scrollback::Scrollback(int maxLines)
+    : firstPage(0)
+    , pageCount(0)
+    , firstLine(0)
+    , lineCount(0)
+    , lineCap(qMax(0, maxLines))
+    , compression(true)
+    , nextSerial(0)
+{
+    unpackedPages.setMaxCost(UnpackedPageCache);
+    clear();
+}
+
+void Scrollback::clear()
+{
+    // Enough slots for the cap plus a partly dropped oldest page and the page being filled
+    ring = QVector<Page>(lineCap / PageLines + 2);
+    firstPage = 0;
+    pageCount = 0;
+    firstLine = 0;
+    lineCount = 0;
+    unpackedPages.clear();
+}
+
+void Scrollback::setMaxLines(int lines)
+{
+    lines = qMax(0, lines);
+    if (lines == lineCap) return;
+
+    QVector<TerminalLine> kept;
+    const int from = qMax(0, lineCount - lines);
+    kept.reserve(lineCount - from);
+    for (int i = from; i < lineCount; ++i) kept.append(at(i));
+
+    lineCap = lines;
+    clear();
+    for (const TerminalLine &line : kept) append(line);
+}
+
+void Scrollback::setCompressionEnabled(bool enabled)
+{
+    if (compression == enabled) return;
+    compression = enabled;
+    for (int n = 0; n < pageCount; ++n) {
+        if (enabled && n < pageCount - 2) packPage(page(n));
+        else if (!enabled) unpackPage(page(n));
+    }
+}
+
+void Scrollback::append(const TerminalLine &line)
+{
+    if (lineCap <= 0) return;
+
+    if (pageCount == 0 || page(pageCount - 1).count == PageLines) {
+        if (pageCount == ring.size()) dropFirstPage();
+        Page &fresh = page(pageCount++);
+        fresh = Page();
+        fresh.serial = nextSerial++;
+        fresh.lines.reserve(PageLines);
+        // The page before the previous one is no longer likely to be viewed
+        if (compression && pageCount >= 3) packPage(page(pageCount - 3));
+    }
+
+    Page &last = page(pageCount - 1);
+    last.lines.append(line);
+    ++last.count;
+    ++lineCount;
+
+    if (lineCount > lineCap) {
+        ++firstLine;
+        --lineCount;
+        if (firstLine == page(0).count) dropFirstPage();
+    }
+}
+
+void Scrollback::dropFirstPage()
+{
+    Page &oldest = page(0);
+    unpackedPages.remove(oldest.serial);
+    lineCount -= oldest.count - firstLine;
+    oldest = Page();
+    firstPage = (firstPage + 1) % ring.size();
+    --pageCount;
+    firstLine = 0;
+}
+
+TerminalLine Scrollback::at(int index) const
+{
+    if (index < 0 || index >= lineCount) return TerminalLine();
+    const int position = firstLine + index;
+    const Page &p = page(position / PageLines);
+    const int row = position % PageLines;
+    if (p.packed.isEmpty()) return p.lines.at(row);
+
+    QVector<TerminalLine> *lines = unpackedPages.object(p.serial);
+    if (!lines) {
+        lines = new QVector<TerminalLine>(unpack(p.packed, p.count));
+        unpackedPages.insert(p.serial, lines, 1);
+    }
+    return lines->value(row);
+}
+
+qint64 Scrollback::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (int n = 0; n < pageCount; ++n) {
+        const Page &p = page(n);
+        if (!p.packed.isEmpty()) {
+            bytes += p.packed.size();
+            continue;
+        }
+        for (const TerminalLine &line : p.lines) {
+            bytes += sizeof(TerminalLine) + line.cells.size() * qint64(sizeof(TerminalCell));
+        }
+    }
+    return bytes;
+}
+
+void Scrollback::packPage(Page &p)
+{
+    if (!p.packed.isEmpty() || p.lines.isEmpty()) return;
+    p.packed = pack(p.lines);
+    p.lines = QVector<TerminalLine>();
+}
+
+void Scrollback::unpackPage(Page &p)
+{
+    if (p.packed.isEmpty()) return;
+    p.lines = unpack(p.packed, p.count);
+    p.packed = QByteArray();
+    unpackedPages.remove(p.serial);
+}
+
+// ---------------------------------------------------------------------------
+// Packed format, per line: stored cells (u16), total cells (u16), wrapped (u8),
+// then the stored cells. Blank cells at the end of a line are not stored.
+// ---------------------------------------------------------------------------
+
+template <typename T>
+static inline void put(char *&out, T value)
+{
+    std::memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+template <typename T>
+static inline T take(const char *&in)
+{
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+static inline bool isDefaultBlank(const TerminalCell &cell)
+{
+    return cell.ch == U' ' && cell.width == TerminalCell::Single && cell.attributes == CellAttributes();
+}
+
+QByteArray Scrollback::pack(const QVector<TerminalLine> &lines)
+{
+    qsizetype rawSize = 0;
+    for (const TerminalLine &line : lines) rawSize += 5 + line.cells.size() * PackedCellSize;
+    QByteArray raw(rawSize, Qt::Uninitialized);
+    char *out = raw.data();
+
+    for (const TerminalLine &line : lines) {
+        int stored = line.cells.size();
+        while (stored > 0 && isDefaultBlank(line.cells.at(stored - 1))) --stored;
+        put<quint16>(out, quint16(stored));
+        put<quint16>(out, quint16(line.cells.size()));
+        put<quint8>(out, line.wrapped ? 1 : 0);
+        for (int i = 0; i < stored; ++i) {
+            const TerminalCell &cell = line.cells.at(i);
+            put<quint32>(out, quint32(cell.ch));
+            put<quint32>(out, cell.attributes.foreground);
+            put<quint32>(out, cell.attributes.background);
+            put<quint16>(out, cell.attributes.flags);
+            put<quint16>(out, cell.width);
+        }
+    }
+    raw.truncate(out - raw.constData());
+    // Fastest level: pages are packed while output streams in
+    return qCompress(raw, 1);
+}
+
+QVector<TerminalLine> Scrollback::unpack(const QByteArray &data, int count)
+{
+    QVector<TerminalLine> lines;
+    lines.reserve(count);
+    const QByteArray raw = qUncompress(data);
+    const char *in = raw.constData();
+    const char *end = in + raw.size();
+
+    while (lines.size() < count && end - in >= 5) {
+        const int stored = take<quint16>(in);
+        const int total = take<quint16>(in);
+        TerminalLine line;
+        line.wrapped = take<quint8>(in) != 0;
+        if (end - in < qsizetype(stored) * PackedCellSize) break;
+        line.cells.resize(qMax(stored, total));
+        for (int i = 0; i < stored; ++i) {
+            TerminalCell &cell = line.cells[i];
+            cell.ch = char32_t(take<quint32>(in));
+            cell.attributes.foreground = take<quint32>(in);
+            cell.attributes.background = take<quint32>(in);
+            cell.attributes.flags = take<quint16>(in);
+            cell.width = take<quint16>(in);
+        }
+        lines.append(line);
+    }
+    // A damaged page still yields the right number of (blank) lines
+    while (lines.size() < count) lines.append(TerminalLine());
+    return lines;
+}
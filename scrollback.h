@@ -0,0 +1,64 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QCache>
+#include "terminalcell.h"
+
+// Scrollback lines of a terminal, capped to maxLines().
+//
+// Lines live in pages of PageLines lines, kept in a ring sized for the cap:
+// appending never moves existing pages and the oldest page is dropped whole.
+// Full pages older than the two newest are packed (trailing blank cells
+// dropped, then zlib) and unpacked on demand, when one of their lines is read,
+// into a small cache of recently viewed pages.
+class Scrollback
+{
+public:
+    explicit Scrollback(int maxLines = 10000);
+
+    void setMaxLines(int lines);
+    int maxLines() const { return lineCap; }
+    void setCompressionEnabled(bool enabled);
+    bool isCompressionEnabled() const { return compression; }
+
+    int size() const { return lineCount; }
+    void append(const TerminalLine &line);
+    TerminalLine at(int index) const;
+    void clear();
+
+    // Bytes held by the pages, packed or not
+    qint64 memoryUsage() const;
+
+    static const int PageLines = 256;
+
+private:
+    struct Page {
+        QVector<TerminalLine> lines;   // empty while packed
+        QByteArray packed;
+        int count = 0;
+        quint64 serial = 0;            // key in the unpacked cache
+    };
+
+    QVector<Page> ring;
+    int firstPage;      // ring slot of the oldest page
+    int pageCount;
+    int firstLine;      // lines of the oldest page already dropped
+    int lineCount;
+    int lineCap;
+    bool compression;
+    quint64 nextSerial;
+    mutable QCache<quint64, QVector<TerminalLine>> unpackedPages;
+
+    Page &page(int n) { return ring[(firstPage + n) % ring.size()]; }
+    const Page &page(int n) const { return ring.at((firstPage + n) % ring.size()); }
+    void dropFirstPage();
+    void packPage(Page &p);
+    void unpackPage(Page &p);
+
+    static QByteArray pack(const QVector<TerminalLine> &lines);
+    static QVector<TerminalLine> unpack(const QByteArray &data, int count);
+};
+
+#endif // SCROLLBACK_H
@@ -0,0 +1,188 @@
+#include "searchengine.h"
+#include "regexcache.h"
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QRegularExpressionMatchIterator>
+
+bool SearchOptions::isValid() const
+{
+    if (pattern.isEmpty()) return false;
+    if (!useRegex) return true;
+    return SearchEngine::buildRegex(*this).isValid();
+}
+
+// Expand \0 .. \99 in a replacement template (same syntax as QString::replace with a regex)
+static QString expandBackreferences(const QString &tmpl, const QRegularExpressionMatch &match)
+{
+    if (!tmpl.contains(QLatin1Char('\\'))) return tmpl;
+
+    QString out;
+    out.reserve(tmpl.size());
+    const int n = tmpl.size();
+    for (int i = 0; i < n; ++i) {
+        QChar c = tmpl.at(i);
+        if (c != QLatin1Char('\\') || i + 1 >= n) {
+            out += c;
+            continue;
+        }
+        QChar next = tmpl.at(i + 1);
+        if (next == QLatin1Char('\\')) {
+            out += next;
+            ++i;
+        } else if (next.isDigit()) {
+            int group = next.digitValue();
+            ++i;
+            if (i + 1 < n && tmpl.at(i + 1).isDigit()) {
+                int twoDigits = group * 10 + tmpl.at(i + 1).digitValue();
+                if (twoDigits <= match.lastCapturedIndex()) {
+                    group = twoDigits;
+                    ++i;
+                }
+            }
+            out += match.captured(group);
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+QRegularExpression SearchEngine::buildRegex(const SearchOptions &options)
+{
+    QRegularExpression::PatternOptions flags = QRegularExpression::NoPatternOption;
+    if (!options.caseSensitive) flags |= QRegularExpression::CaseInsensitiveOption;
+    QString pattern = options.useRegex ? options.pattern
+                                       : QRegularExpression::escape(options.pattern);
+    return RegexCache::get(pattern, flags);
+}
+
+QVector<TextMatch> SearchEngine::findAll(const QString &text, const SearchOptions &options)
+{
+    QVector<TextMatch> matches;
+    if (options.pattern.isEmpty()) return matches;
+
+    if (options.useRegex) {
+        QRegularExpression regex = buildRegex(options);
+        if (!regex.isValid()) return matches;
+        QRegularExpressionMatchIterator it = regex.globalMatch(text);
+        while (it.hasNext()) {
+            QRegularExpressionMatch m = it.next();
+            if (m.capturedLength() == 0) continue; // nothing to select
+            matches.append({ static_cast<int>(m.capturedStart()), static_cast<int>(m.capturedLength()) });
+        }
+        return matches;
+    }
+
+    const Qt::CaseSensitivity cs = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const int len = options.pattern.length();
+    int pos = text.indexOf(options.pattern, 0, cs);
+    while (pos != -1) {
+        matches.append({ pos, len });
+        pos = text.indexOf(options.pattern, pos + len, cs);
+    }
+    return matches;
+}
+
+QVector<TextReplacement> SearchEngine::computeReplacements(const QString &text,
+                                                           const SearchOptions &options,
+                                                           const QString &replaceWith)
+{
+    QVector<TextReplacement> edits;
+    if (options.pattern.isEmpty()) return edits;
+
+    if (!options.useRegex) {
+        const QVector<TextMatch> matches = findAll(text, options);
+        edits.reserve(matches.size());
+        for (const TextMatch &m : matches) {
+            edits.append({ m.start, m.length, replaceWith });
+        }
+        return edits;
+    }
+
+    QRegularExpression regex = buildRegex(options);
+    if (!regex.isValid()) return edits;
+
+    QRegularExpressionMatchIterator it = regex.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch m = it.next();
+        edits.append({ static_cast<int>(m.capturedStart()),
+                       static_cast<int>(m.capturedLength()),
+                       expandBackreferences(replaceWith, m) });
+    }
+    return edits;
+}
+
+QString SearchEngine::applyReplacements(const QString &text, const QVector<TextReplacement> &edits)
+{
+    if (edits.isEmpty()) return text;
+
+    QString out;
+    qsizetype delta = 0;
+    for (const TextReplacement &e : edits) delta += e.text.size() - e.length;
+    out.reserve(text.size() + qMax<qsizetype>(0, delta));
+
+    int last = 0;
+    for (const TextReplacement &e : edits) {
+        out += QStringView(text).mid(last, e.start - last);
+        out += e.text;
+        last = e.start + e.length;
+    }
+    out += QStringView(text).mid(last);
+    return out;
+}
+
+void SearchEngine::applyReplacements(QTextDocument *document, const QVector<TextReplacement> &edits)
+{
+    if (!document || edits.isEmpty()) return;
+
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    // Back to front: earlier offsets stay valid while later text changes
+    for (int i = edits.size() - 1; i >= 0; --i) {
+        const TextReplacement &e = edits.at(i);
+        cursor.setPosition(e.start);
+        cursor.setPosition(e.start + e.length, QTextCursor::KeepAnchor);
+        cursor.insertText(e.text);
+    }
+    cursor.endEditBlock();
+}
+
+QVector<PreviewLine> SearchEngine::buildPreview(const QString &text,
+                                                const QVector<TextReplacement> &edits,
+                                                int maxLines)
+{
+    QVector<PreviewLine> lines;
+    int lineNumber = 1;
+    int scanned = 0; // newlines are counted up to this offset
+
+    int i = 0;
+    while (i < edits.size() && lines.size() < maxLines) {
+        const int start = edits.at(i).start;
+        int lineStart = start > 0 ? text.lastIndexOf(QLatin1Char('\n'), start - 1) + 1 : 0;
+        lineNumber += QStringView(text).mid(scanned, lineStart - scanned).count(QLatin1Char('\n'));
+        scanned = lineStart;
+
+        // The edits of this line (a multi-line match extends the "line")
+        int lineEnd = text.indexOf(QLatin1Char('\n'), start + edits.at(i).length);
+        if (lineEnd == -1) lineEnd = text.size();
+        int j = i;
+        QVector<TextReplacement> local;
+        while (j < edits.size() && edits.at(j).start <= lineEnd) {
+            const TextReplacement &e = edits.at(j);
+            if (e.start + e.length > lineEnd) {
+                lineEnd = text.indexOf(QLatin1Char('\n'), e.start + e.length);
+                if (lineEnd == -1) lineEnd = text.size();
+            }
+            local.append({ e.start - lineStart, e.length, e.text });
+            ++j;
+        }
+
+        PreviewLine line;
+        line.lineNumber = lineNumber;
+        line.before = text.mid(lineStart, lineEnd - lineStart);
+        line.after = applyReplacements(line.before, local);
+        lines.append(line);
+        i = j;
+    }
+    return lines;
+}
@@ -0,0 +1,70 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QString>
+#include <QVector>
+#include <QRegularExpression>
+
+QT_BEGIN_NAMESPACE
+class QTextDocument;
+QT_END_NAMESPACE
+
+// Options shared by every search path (find dialog, project replace, ...)
+struct SearchOptions
+{
+    QString pattern;
+    bool caseSensitive = false;
+    bool useRegex = false;
+
+    bool isValid() const;
+};
+
+// A match in a text buffer, in QString (UTF-16) offsets
+struct TextMatch
+{
+    int start = 0;
+    int length = 0;
+};
+
+// A single replacement: the range [start, start + length) becomes `text`
+struct TextReplacement
+{
+    int start = 0;
+    int length = 0;
+    QString text;
+};
+
+// One line of a replace preview ("before" / "after" the edits of that line)
+struct PreviewLine
+{
+    int lineNumber = 0; // 1-based
+    QString before;
+    QString after;
+};
+
+namespace SearchEngine
+{
+    QRegularExpression buildRegex(const SearchOptions &options);
+
+    // All non-overlapping matches of `options` in `text`, in ascending order
+    QVector<TextMatch> findAll(const QString &text, const SearchOptions &options);
+
+    // Matches turned into replacements; backreferences (\1 .. \99) are expanded in regex mode
+    QVector<TextReplacement> computeReplacements(const QString &text,
+                                                 const SearchOptions &options,
+                                                 const QString &replaceWith);
+
+    // Returns `text` with all (sorted, non-overlapping) replacements applied
+    QString applyReplacements(const QString &text, const QVector<TextReplacement> &edits);
+
+    // Applies the replacements in place, in reverse order, inside a single edit block
+    // so the whole operation is one undo step and existing cursors are preserved.
+    void applyReplacements(QTextDocument *document, const QVector<TextReplacement> &edits);
+
+    // One before/after line per modified line, at most `maxLines` of them
+    QVector<PreviewLine> buildPreview(const QString &text,
+                                      const QVector<TextReplacement> &edits,
+                                      int maxLines = 200);
+}
+
+#endif // SEARCHENGINE_H
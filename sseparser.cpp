@@ -0,0 +1,64 @@
+#include "sseparser.h"
+#include <cstring>
+
+void SseParser::feed(const QByteArray &chunk, QVector<SseEvent> &events)
+{
+    pending += chunk;
+    const char *data = pending.constData();
+    const qsizetype size = pending.size();
+
+    qsizetype start = 0;
+    while (start < size) {
+        const char *newline = static_cast<const char *>(std::memchr(data + start, '\n', size - start));
+        if (!newline) break;
+        qsizetype end = newline - data;
+        qsizetype length = end - start;
+        if (length > 0 && data[end - 1] == '\r') --length;
+        processLine(data + start, length, events);
+        start = end + 1;
+    }
+    // One move of the unfinished tail, whatever the number of lines
+    pending.remove(0, start);
+}
+
+void SseParser::processLine(const char *line, qsizetype length, QVector<SseEvent> &events)
+{
+    if (length == 0) {
+        // Blank line: end of the event
+        if (hasData) {
+            if (current.data.endsWith('\n')) current.data.chop(1);
+            events.append(current);
+        }
+        current = SseEvent();
+        hasData = false;
+        return;
+    }
+    if (line[0] == ':') return; // comment / keep-alive
+
+    const char *colon = static_cast<const char *>(std::memchr(line, ':', length));
+    const qsizetype nameLength = colon ? colon - line : length;
+    const char *value = colon ? colon + 1 : line + length;
+    qsizetype valueLength = line + length - value;
+    if (valueLength > 0 && value[0] == ' ') {
+        ++value;
+        --valueLength;
+    }
+
+    const QByteArray name = QByteArray::fromRawData(line, nameLength);
+    if (name == "data") {
+        current.data.append(value, valueLength);
+        current.data.append('\n');
+        hasData = true;
+    } else if (name == "event") {
+        current.event = QByteArray(value, valueLength);
+    } else if (name == "id") {
+        current.id = QByteArray(value, valueLength);
+    }
+}
+
+void SseParser::reset()
+{
+    pending.clear();
+    current = SseEvent();
+    hasData = false;
+}
@@ -0,0 +1,32 @@
+#ifndef SSEPARSER_H
+#define SSEPARSER_H
+
+#include <QByteArray>
+#include <QVector>
+
+struct SseEvent
+{
+    QByteArray event;           // empty for the default "message" type
+    QByteArray data;            // data lines joined with '\n'
+    QByteArray id;
+};
+
+// Incremental parser for a text/event-stream body. Bytes are fed as they
+// arrive (a line or an event may be split anywhere); complete events are
+// returned as soon as their terminating blank line is in.
+class SseParser
+{
+public:
+    // Appends the events completed by `chunk` to `events`
+    void feed(const QByteArray &chunk, QVector<SseEvent> &events);
+    void reset();
+
+private:
+    QByteArray pending;         // start of an incomplete line
+    SseEvent current;
+    bool hasData = false;
+
+    void processLine(const char *line, qsizetype length, QVector<SseEvent> &events);
+};
+
+#endif // SSEPARSER_H
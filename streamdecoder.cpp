@@ -0,0 +1,173 @@
+#include "streamdecoder.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STREAMDECODER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define STREAMDECODER_NEON
+#endif
+
+#ifdef Q_OS_WIN
+
+StreamDecoder::StreamDecoder()
+    : decoder(QStringDecoder::System)
+{
+}
+
+void StreamDecoder::decode(const char *data, qsizetype size, QString &out)
+{
+    out = decoder.decode(QByteArrayView(data, size));
+}
+
+void StreamDecoder::reset()
+{
+    decoder.resetState();
+}
+
+#else
+
+static const char16_t ReplacementCharacter = 0xFFFD;
+
+// Copies the leading ASCII bytes of src, widened to UTF-16; returns how many
+static inline qsizetype widenAscii(const uchar *src, qsizetype n, char16_t *dst)
+{
+    qsizetype i = 0;
+#if defined(STREAMDECODER_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        if (_mm_movemask_epi8(bytes)) break; // a byte >= 0x80 in this block
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+#elif defined(STREAMDECODER_NEON)
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t bytes = vld1q_u8(src + i);
+        if (vmaxvq_u8(bytes) >= 0x80) break;
+        vst1q_u16(reinterpret_cast<uint16_t *>(dst + i), vmovl_u8(vget_low_u8(bytes)));
+        vst1q_u16(reinterpret_cast<uint16_t *>(dst + i + 8), vmovl_high_u8(bytes));
+    }
+#endif
+    for (; i < n && src[i] < 0x80; ++i) dst[i] = src[i];
+    return i;
+}
+
+// Decodes one sequence. Returns its length, or the length of the invalid part
+// (with *cp = U+FFFD), or 0 when the sequence is valid so far but needs more
+// bytes than `available`.
+static inline int decodeSequence(const uchar *p, qsizetype available, char32_t *cp)
+{
+    const uchar b = p[0];
+    int length;
+    char32_t c;
+    uchar low = 0x80;
+    uchar high = 0xBF;
+    if (b < 0x80) {
+        *cp = b;
+        return 1;
+    } else if (b >= 0xC2 && b <= 0xDF) {
+        length = 2;
+        c = b & 0x1F;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+        length = 3;
+        c = b & 0x0F;
+        if (b == 0xE0) low = 0xA0;         // overlong
+        else if (b == 0xED) high = 0x9F;   // surrogates
+    } else if (b >= 0xF0 && b <= 0xF4) {
+        length = 4;
+        c = b & 0x07;
+        if (b == 0xF0) low = 0x90;         // overlong
+        else if (b == 0xF4) high = 0x8F;   // above U+10FFFF
+    } else {
+        *cp = ReplacementCharacter;
+        return 1;
+    }
+
+    for (int i = 1; i < length; ++i) {
+        if (i >= available) return 0;
+        const uchar t = p[i];
+        if (t < (i == 1 ? low : 0x80) || t > (i == 1 ? high : 0xBF)) {
+            *cp = ReplacementCharacter;
+            return i;
+        }
+        c = (c << 6) | (t & 0x3F);
+    }
+    *cp = c;
+    return length;
+}
+
+static inline char16_t *put(char16_t *dst, char32_t cp)
+{
+    if (cp >= 0x10000) {
+        *dst++ = QChar::highSurrogate(cp);
+        *dst++ = QChar::lowSurrogate(cp);
+    } else {
+        *dst++ = static_cast<char16_t>(cp);
+    }
+    return dst;
+}
+
+StreamDecoder::StreamDecoder()
+    : carryLength(0)
+{
+}
+
+void StreamDecoder::reset()
+{
+    carryLength = 0;
+}
+
+void StreamDecoder::decode(const char *data, qsizetype size, QString &out)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+
+    // Never more UTF-16 units than bytes; shrinking later keeps the capacity
+    out.resize(size + carryLength);
+    char16_t *begin = reinterpret_cast<char16_t *>(out.data());
+    char16_t *dst = begin;
+
+    if (carryLength > 0) {
+        uchar sequence[4];
+        std::memcpy(sequence, carry, carryLength);
+        const int taken = static_cast<int>(qMin<qsizetype>(4 - carryLength, size));
+        std::memcpy(sequence + carryLength, p, taken);
+
+        char32_t cp;
+        const int length = decodeSequence(sequence, carryLength + taken, &cp);
+        if (length == 0) {
+            // Still incomplete: everything read so far belongs to this character
+            std::memcpy(carry + carryLength, p, taken);
+            carryLength += taken;
+            out.resize(0);
+            return;
+        }
+        dst = put(dst, cp);
+        p += qMax(0, length - carryLength);
+        carryLength = 0;
+    }
+
+    while (p < end) {
+        const qsizetype ascii = widenAscii(p, end - p, dst);
+        p += ascii;
+        dst += ascii;
+        if (p == end) break;
+
+        char32_t cp;
+        const int length = decodeSequence(p, end - p, &cp);
+        if (length == 0) {
+            // Cut by the end of this read: completed by the next one
+            carryLength = static_cast<int>(end - p);
+            std::memcpy(carry, p, carryLength);
+            break;
+        }
+        dst = put(dst, cp);
+        p += length;
+    }
+
+    out.resize(dst - begin);
+}
+
+#endif
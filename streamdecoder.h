@@ -0,0 +1,32 @@
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include <QString>
+#include <QStringDecoder>
+
+// Incremental decoder for the output of a process, one per stream.
+//
+// A character split between two reads is kept and completed by the next
+// call instead of turning into replacement characters. On Unix the output is
+// UTF-8 (decoded here, with a SIMD fast path for runs of ASCII); on Windows
+// the system code page is used through a stateful QStringDecoder.
+class StreamDecoder
+{
+public:
+    StreamDecoder();
+
+    // Decodes `size` bytes into `out`, replacing its content. The capacity of
+    // `out` is reused, so passing the same string every time avoids allocations.
+    void decode(const char *data, qsizetype size, QString &out);
+    void reset();
+
+private:
+#ifdef Q_OS_WIN
+    QStringDecoder decoder;
+#else
+    uchar carry[4];     // start of a sequence cut by the end of the previous read
+    int carryLength;
+#endif
+};
+
+#endif // STREAMDECODER_H
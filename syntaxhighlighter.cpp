@@ -1,6 +1,9 @@
 #include "syntaxhighlighter.h"
+#include "regexcache.h"
 #include <QDebug>
 #include <QRegularExpression>
+#include <QTextBlock>
+#include <QTextLayout>
 
 // Importer Tree-sitter en C (évite le name mangling en C++)
 extern "C" {
@@ -25,6 +28,16 @@ static const QStringList& cppKeywords() {
     return keywords;
 }
 
+// Remembers which text a block was highlighted for. A block whose text did not
+// change since (e.g. the untouched lines between two edits of a Replace All)
+// keeps the formats already stored in its layout instead of being reparsed.
+class BlockHighlightData : public QTextBlockUserData
+{
+public:
+    explicit BlockHighlightData(size_t hash) : textHash(hash) {}
+    size_t textHash;
+};
+
 SyntaxHighlighter::SyntaxHighlighter(CodeEditor *editor, Language lang)
     : QSyntaxHighlighter(editor ? editor->document() : nullptr), language(lang), parser(nullptr), tree(nullptr)
 {
@@ -32,7 +45,17 @@ SyntaxHighlighter::SyntaxHighlighter(CodeEditor *editor, Language lang)
         qWarning() << "SyntaxHighlighter: editor is nullptr!";
         return;
     }
+    setupParser();
+}
+
+SyntaxHighlighter::SyntaxHighlighter(QTextDocument *document, Language lang)
+    : QSyntaxHighlighter(document), language(lang), parser(nullptr), tree(nullptr)
+{
+    setupParser();
+}
 
+void SyntaxHighlighter::setupParser()
+{
     parser = ts_parser_new();
     if (!parser) {
         qWarning() << "Tree-sitter parser could not be created!";
@@ -95,10 +118,25 @@ void SyntaxHighlighter::setupFormats() {
 }
 
 void SyntaxHighlighter::highlightBlock(const QString &text) {
+    const size_t hash = qHash(text);
+    auto *data = static_cast<BlockHighlightData*>(currentBlockUserData());
+    if (data && data->textHash == hash) {
+        // Unchanged block: reapply the previous result, no tree-sitter parse
+        const QList<QTextLayout::FormatRange> formats = currentBlock().layout()->formats();
+        for (const QTextLayout::FormatRange &range : formats)
+            setFormat(range.start, range.length, range.format);
+        return;
+    }
+
     if (language == CPP)
         highlightCpp(text);
     else
         highlightHtml(text);
+
+    if (data)
+        data->textHash = hash;
+    else
+        setCurrentBlockUserData(new BlockHighlightData(hash));
 }
 
 void SyntaxHighlighter::highlightCpp(const QString &text) {
@@ -180,7 +218,7 @@ void SyntaxHighlighter::highlightCpp(const QString &text) {
     visit(root);
 
     // Coloration explicite des mots-clés (if, return, public, ...)
-    QRegularExpression wordRegex("\\b([a-zA-Z_][a-zA-Z0-9_]*)\\b");
+    const QRegularExpression wordRegex = RegexCache::get(QStringLiteral("\\b([a-zA-Z_][a-zA-Z0-9_]*)\\b"));
     auto it = wordRegex.globalMatch(text);
     while (it.hasNext()) {
         auto match = it.next();
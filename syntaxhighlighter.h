@@ -15,6 +15,8 @@ public:
     enum Language { CPP, HTML };
 
     SyntaxHighlighter(CodeEditor *editor, Language lang);
+    // Highlights a plain document (code blocks of the chat)
+    SyntaxHighlighter(QTextDocument *document, Language lang);
     ~SyntaxHighlighter();
 
 protected:
@@ -28,6 +30,7 @@ private:
     void highlightCpp(const QString &text);
     void highlightHtml(const QString &text);
 
+    void setupParser();
     void setupFormats();
 
     QTextCharFormat keywordFormat;
@@ -1,5 +1,14 @@
 #include "terminal.h"
 #include "ui_terminal.h"
+#include "regexcache.h"
+#include "ptyprocess.h"
+#include "terminalscreen.h"
+#include "terminalview.h"
+#include "jobcontroller.h"
+#include "completionindex.h"
+#include "completionstore.h"
+#include "commandhistory.h"
+#include "directorylistingcache.h"
 #include <QDir>
 #include <QTextCursor>
 #include <QScrollBar>
@@ -14,6 +23,9 @@
 #include <QSet>
 #include <QDirIterator>
 #include <QRegularExpression>
+#include <QTimer>
+#include <algorithm>
+#include <csignal>
 
 // ============================================================================
 // AutoCompletePopup Implementation
@@ -126,7 +138,7 @@ void AutoCompletePopup::focusOutEvent(QFocusEvent *event)
 // ============================================================================
 
 TerminalTextEdit::TerminalTextEdit(QWidget *parent)
-    : QTextEdit(parent), promptPosition(0)
+    : QTextEdit(parent), promptPosition(0), searchMode(false)
 {
     setAcceptRichText(false);
     setUndoRedoEnabled(false);
@@ -202,6 +214,63 @@ void TerminalTextEdit::keyPressEvent(QKeyEvent *event)
         
     }
     
+#ifdef Q_OS_MACOS
+    const Qt::KeyboardModifier controlKey = Qt::MetaModifier;
+#else
+    const Qt::KeyboardModifier controlKey = Qt::ControlModifier;
+#endif
+    const bool control = event->modifiers() & controlKey;
+
+    // Recherche dans l'historique (Ctrl+R) : le texte tapé complète la requête
+    if (searchMode) {
+        if (control && event->key() == Qt::Key_R) {
+            emit reverseSearchRequested();
+            return;
+        }
+        if (event->key() == Qt::Key_Escape
+            || (control && (event->key() == Qt::Key_G || event->key() == Qt::Key_C))) {
+            emit searchFinished(false);
+            return;
+        }
+        if (event->key() == Qt::Key_Backspace) {
+            emit searchBackspacePressed();
+            return;
+        }
+        if (!control && !event->text().isEmpty() && event->text().at(0).isPrint()) {
+            emit searchTextEntered(event->text());
+            return;
+        }
+        // Toute autre touche (Entrée, flèches...) garde la ligne trouvée et s'applique normalement
+        emit searchFinished(true);
+    } else if (control && event->key() == Qt::Key_R) {
+        hideAutoComplete();
+        emit reverseSearchRequested();
+        return;
+    }
+
+    // Historique : flèches haut / bas
+    if (event->key() == Qt::Key_Up && !autoCompletePopup->isVisible()) {
+        emit upPressed();
+        return;
+    }
+    if (event->key() == Qt::Key_Down && !autoCompletePopup->isVisible()) {
+        emit downPressed();
+        return;
+    }
+
+    // Ctrl+C sans sélection = interruption, Ctrl+D = fin d'entrée
+    if (control) {
+        if (event->key() == Qt::Key_C && !textCursor().hasSelection()) {
+            hideAutoComplete();
+            emit interruptRequested();
+            return;
+        }
+        if (event->key() == Qt::Key_D) {
+            emit endOfInputRequested();
+            return;
+        }
+    }
+
     // Gestion de l'entrée commande standard
     bool isEnter = (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter);
 
@@ -319,7 +388,17 @@ Terminal::Terminal(QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::Terminal)
     , process(nullptr)
+    , pty(nullptr)
+    , usePty(false)
+    , shellReady(false)
+    , silentCommands(0)
+    , screen(nullptr)
+    , flushTimer(nullptr)
+    , jobs(nullptr)
+    , foregroundJob(0)
     , historyIndex(-1)
+    , reverseSearching(false)
+    , searchMatch(0)
     , isProcessRunning(false)
 {
     ui->setupUi(this);
@@ -330,6 +409,8 @@ Terminal::Terminal(QWidget *parent)
     // Set default working directory
     workingDirectory = QDir::currentPath();
 
+    usePty = startShell();
+    updateOutputSuppression();
     displayPrompt();
     isDragging = false;
 
@@ -341,6 +422,12 @@ Terminal::Terminal(QWidget *parent)
 
 Terminal::~Terminal()
 {
+    jobs->disconnect(this);
+    delete jobs;
+    if (pty) {
+        pty->disconnect(this);
+        pty->terminate();
+    }
     if (process && process->state() == QProcess::Running) {
         process->kill();
         process->waitForFinished();
@@ -357,8 +444,18 @@ void Terminal::setupTerminal()
             this, &Terminal::onUpPressed);
     connect(ui->terminalOutput, &TerminalTextEdit::downPressed,
             this, &Terminal::onDownPressed);
+    connect(ui->terminalOutput, &TerminalTextEdit::reverseSearchRequested,
+            this, &Terminal::onReverseSearchRequested);
+    connect(ui->terminalOutput, &TerminalTextEdit::searchTextEntered,
+            this, &Terminal::onSearchTextEntered);
+    connect(ui->terminalOutput, &TerminalTextEdit::searchBackspacePressed,
+            this, &Terminal::onSearchBackspacePressed);
+    connect(ui->terminalOutput, &TerminalTextEdit::searchFinished,
+            this, &Terminal::onSearchFinished);
     connect(ui->terminalOutput, &TerminalTextEdit::textChangedForAutoComplete,
             this, &Terminal::onTextChangedForAutoComplete);
+    connect(&DirectoryListingCache::instance(), &DirectoryListingCache::listingUpdated,
+            this, &Terminal::onDirectoryListingUpdated);
 
     // Connect toolbar buttons
     connect(ui->clearButton, &QPushButton::clicked,
@@ -376,6 +473,40 @@ void Terminal::setupTerminal()
             this, &Terminal::onProcessFinished);
     connect(process, &QProcess::errorOccurred,
             this, &Terminal::onProcessError);
+
+    connect(ui->terminalOutput, &TerminalTextEdit::interruptRequested,
+            this, &Terminal::onInterruptRequested);
+    connect(ui->terminalOutput, &TerminalTextEdit::endOfInputRequested,
+            this, &Terminal::onEndOfInputRequested);
+
+    // Output grid, painted by the view above the command line
+    screen = new TerminalScreen(80, 24, this);
+    ui->terminalView->setScreen(screen);
+    connect(screen, &TerminalScreen::oscReceived, this, &Terminal::onScreenOsc);
+    connect(screen, &TerminalScreen::alternateScreenChanged,
+            this, &Terminal::onAlternateScreenChanged);
+    connect(screen, &TerminalScreen::response, this, [this](const QByteArray &data) {
+        if (usePty) pty->write(data);
+    });
+    connect(ui->terminalView, &TerminalView::keyInput, this, &Terminal::onViewKeyInput);
+    connect(ui->terminalView, &TerminalView::sizeChanged, this, &Terminal::onViewSizeChanged);
+
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setTimerType(Qt::PreciseTimer);
+    connect(flushTimer, &QTimer::timeout, this, &Terminal::flushOutput);
+    readBuffer.resize(64 * 1024);
+
+    // Background jobs, watched on their own thread
+    jobs = new JobController(this);
+    connect(jobs, &JobController::started, this, &Terminal::onJobStarted);
+    connect(jobs, &JobController::output, this, &Terminal::onJobOutput);
+    connect(jobs, &JobController::finished, this, &Terminal::onJobFinished);
+
+    // Setup pseudo-terminal (started by startShell)
+    pty = new PtyProcess(this);
+    connect(pty, &PtyProcess::readyRead, this, &Terminal::scheduleFlush);
+    connect(pty, &PtyProcess::finished, this, &Terminal::onPtyFinished);
 }
 
 void Terminal::initializeShell()
@@ -396,8 +527,253 @@ QString Terminal::getSystemShell()
     return shell;
 }
 
+static QByteArray shellQuote(const QString &text)
+{
+    QByteArray quoted = text.toLocal8Bit();
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+
+// Start the interactive shell of this tab on a pseudo-terminal.
+// The shell runs without line editing and echo (this widget edits the line),
+// and its prompt is replaced by an OSC 777 marker carrying the exit code of
+// the last command and the current directory: every time the marker shows up
+// (see onScreenOsc), the shell is waiting for a new command.
+bool Terminal::startShell()
+{
+#ifdef Q_OS_WIN
+    return false;
+#else
+    QString program = currentShell;
+    QStringList args;
+    QByteArray init = "stty -echo 2>/dev/null; PS2=''; ";
+
+    if (QFileInfo(program).fileName() == "zsh") {
+        args << "-i" << "+Z";
+        init += "unsetopt prompt_cr prompt_sp 2>/dev/null; precmd_functions=(); RPROMPT=''; "
+                "PS1=$'\\e]777;done;%?;%/\\a'";
+    } else {
+        if (QFileInfo(program).fileName() != "bash") {
+            program = QStandardPaths::findExecutable("bash");
+            if (program.isEmpty()) return false;
+        }
+        args << "--noediting" << "-i";
+        init += "PROMPT_COMMAND=''; PS1='\\033]777;done;$?;$PWD\\007'";
+    }
+
+    shellReady = false;
+    silentCommands = 0;
+    ptyDecoder.reset();
+    if (!pty->start(program, args, workingDirectory, screen->columns(), screen->rows())) return false;
+    pty->write(init + "\n");
+    return true;
+#endif
+}
+
+// Output is applied at most once per display frame
+static const int FrameInterval = 16;
+// Bytes parsed in one frame; the rest waits for the next one (the pty reader
+// is throttled meanwhile), so a flood of output keeps the UI responsive
+static const int MaxOutputPerFrame = 2 * 1024 * 1024;
+
+void Terminal::scheduleFlush()
+{
+    if (flushTimer->isActive()) return;
+    const qint64 elapsed = lastFlush.isValid() ? lastFlush.elapsed() : FrameInterval;
+    flushTimer->start(static_cast<int>(qMax<qint64>(0, FrameInterval - elapsed)));
+}
+
+void Terminal::flushOutput()
+{
+    lastFlush.start();
+    bool changed = false;
+
+    qsizetype budget = MaxOutputPerFrame;
+    while (budget > 0) {
+        qsizetype n = pty->read(readBuffer.data(), qMin<qsizetype>(budget, readBuffer.size()));
+        if (n <= 0) break;
+        ptyDecoder.decode(readBuffer.constData(), n, decodeBuffer);
+        screen->feed(decodeBuffer);
+        budget -= n;
+        changed = true;
+    }
+    if (!pendingStdout.isEmpty()) {
+        // stdout may carry colors too
+        stdoutDecoder.decode(pendingStdout.constData(), pendingStdout.size(), decodeBuffer);
+        screen->feed(decodeBuffer);
+        pendingStdout.clear();
+        changed = true;
+    }
+    if (!pendingStderr.isEmpty()) {
+        stderrDecoder.decode(pendingStderr.constData(), pendingStderr.size(), decodeBuffer);
+        screen->appendText(decodeBuffer, QColor(224, 108, 117));
+        pendingStderr.clear();
+        changed = true;
+    }
+    for (const JobChunk &chunk : std::as_const(pendingJobOutput)) {
+        auto it = backgroundJobs.find(chunk.id);
+        if (it == backgroundJobs.end()) continue;
+        BackgroundJob &job = it->second;
+        StreamDecoder &decoder = chunk.isError ? job.stderrDecoder : job.stdoutDecoder;
+        decoder.decode(chunk.data.constData(), chunk.data.size(), decodeBuffer);
+        appendJobOutput(chunk.id, job, decodeBuffer, chunk.isError);
+        changed = true;
+    }
+    pendingJobOutput.clear();
+
+    // One scroll to the bottom and one repaint for everything of this frame
+    if (changed) ui->terminalView->screenUpdated();
+    if (pty->hasPendingOutput()) scheduleFlush();
+}
+
+// Apply all queued output now (before a prompt or a restart)
+void Terminal::drainOutput()
+{
+    do {
+        flushOutput();
+    } while (pty->hasPendingOutput());
+    flushTimer->stop();
+}
+
+void Terminal::onScreenOsc(int code, const QString &data)
+{
+    if (code == 777) handleShellMarker(data);
+}
+
+void Terminal::updateOutputSuppression()
+{
+    // Startup noise (rc files, the echoed init line) and the output of
+    // internal commands are not shown
+    screen->setOutputSuppressed(usePty && (!shellReady || silentCommands > 0));
+}
+
+void Terminal::handleShellMarker(const QString &payload)
+{
+    // payload: done;<exit code>;<cwd>
+    if (!payload.startsWith(QLatin1String("done;"))) return;
+    int sep = payload.indexOf(QLatin1Char(';'), 5);
+    if (sep < 0) return;
+    bool ok = false;
+    int exitCode = payload.mid(5, sep - 5).toInt(&ok);
+    QString cwd = payload.mid(sep + 1);
+    if (!cwd.isEmpty()) {
+        workingDirectory = cwd;
+    }
+
+    if (!shellReady) {
+        shellReady = true;
+        updateOutputSuppression();
+        return;
+    }
+    if (silentCommands > 0) {
+        --silentCommands;
+        updateOutputSuppression();
+        return;
+    }
+    if (!isProcessRunning) return;
+
+    isProcessRunning = false;
+    if (ok) recordExitCode(exitCode);
+    // Output without a final newline: the next lines start on their own
+    if (screen->cursorX() != 0) {
+        appendOutput("\n", QColor(204, 204, 204));
+    }
+    if (ok && exitCode != 0) {
+        appendOutput(QString("\nProcess exited with code %1\n").arg(exitCode),
+                     QColor(229, 192, 123));
+    }
+    displayPrompt();
+}
+
+void Terminal::onPtyFinished(int exitCode)
+{
+    drainOutput();
+    isProcessRunning = false;
+    if (!shellReady) {
+        // The shell died before its first prompt: fall back to one process per command
+        appendError(QString("\nCould not start %1 (exit code %2)\n").arg(currentShell).arg(exitCode));
+        usePty = false;
+        updateOutputSuppression();
+        displayPrompt();
+        return;
+    }
+    // The shell exited (`exit`, killed, ...): start a fresh one
+    appendInfo("\nShell exited, starting a new one.\n");
+    usePty = startShell();
+    updateOutputSuppression();
+    displayPrompt();
+}
+
+void Terminal::onInterruptRequested()
+{
+    if (foregroundJob) {
+        jobs->sendSignal(foregroundJob, SIGINT);
+        return;
+    }
+    if (usePty && isProcessRunning) {
+        pty->write("\x03"); // the line discipline sends SIGINT to the foreground job
+        return;
+    }
+    if (!usePty && isProcessRunning && process->state() != QProcess::NotRunning) {
+        process->kill();
+        return;
+    }
+    // Nothing running: drop the current line
+    appendOutput(ui->terminalOutput->prompt(), QColor(152, 195, 121));
+    appendOutput(ui->terminalOutput->getCurrentCommand() + "^C\n", QColor(204, 204, 204));
+    displayPrompt();
+}
+
+void Terminal::onEndOfInputRequested()
+{
+    if (foregroundJob) {
+        jobs->closeInput(foregroundJob);
+    } else if (usePty && isProcessRunning) {
+        pty->write("\x04");
+    } else if (!usePty && isProcessRunning) {
+        process->closeWriteChannel();
+    }
+}
+
+void Terminal::onViewSizeChanged(int columns, int rows)
+{
+    if (pty && pty->isRunning()) pty->resize(columns, rows);
+}
+
+void Terminal::onViewKeyInput(const QByteArray &data)
+{
+    // Keys typed on the output go to the running program (full-screen programs, prompts)
+    if (usePty && isProcessRunning) {
+        pty->write(data);
+        return;
+    }
+    // Otherwise printable text continues the command line
+    ui->terminalOutput->setFocus();
+    if (!data.isEmpty() && static_cast<unsigned char>(data.at(0)) >= 0x20 && data.at(0) != 0x7f) {
+        ui->terminalOutput->moveCursor(QTextCursor::End);
+        ui->terminalOutput->insertPlainText(QString::fromUtf8(data));
+    }
+}
+
+void Terminal::onAlternateScreenChanged(bool active)
+{
+    // Full-screen programs (vim, less, top) take the keyboard and the whole area
+    ui->terminalOutput->setVisible(!active);
+    if (active) {
+        ui->terminalView->setFocus();
+    } else {
+        ui->terminalOutput->setFocus();
+    }
+}
+
 void Terminal::displayPrompt()
 {
+    if (reverseSearching) {
+        // A command finished meanwhile: the search ends with the new prompt
+        reverseSearching = false;
+        ui->terminalOutput->setSearchMode(false);
+    }
+
     QString prompt;
     QDir dir(workingDirectory);
 
@@ -407,13 +783,20 @@ void Terminal::displayPrompt()
     prompt = QString("%1$ ").arg(dir.dirName());
 #endif
 
+    resetInputLine(prompt);
+}
+
+// The command line below the output only holds the prompt and the line being typed
+void Terminal::resetInputLine(const QString &prompt)
+{
+    ui->terminalOutput->clear();
     QTextCursor cursor = ui->terminalOutput->textCursor();
-    cursor.movePosition(QTextCursor::End);
 
     QTextCharFormat format;
-    format.setForeground(QColor(152, 195, 121)); 
+    format.setForeground(QColor(152, 195, 121));
     cursor.setCharFormat(format);
     cursor.insertText(prompt);
+    cursor.setCharFormat(QTextCharFormat());
 
     ui->terminalOutput->setTextCursor(cursor);
     ui->terminalOutput->setPrompt(prompt);
@@ -421,21 +804,31 @@ void Terminal::displayPrompt()
 
 void Terminal::appendOutput(const QString &text, const QColor &color)
 {
-    QTextCursor cursor = ui->terminalOutput->textCursor();
-    cursor.movePosition(QTextCursor::End);
-
-    QTextCharFormat format;
-    format.setForeground(color);
-    cursor.setCharFormat(format);
-    cursor.insertText(text);
-
-    ui->terminalOutput->setTextCursor(cursor);
-    ui->terminalOutput->verticalScrollBar()->setValue(
-        ui->terminalOutput->verticalScrollBar()->maximum());
+    screen->appendText(text, color);
+    ui->terminalView->screenUpdated();
 }
 
 void Terminal::onCommandEntered(const QString &command)
 {
+    // Echo the line into the output, the command line starts over
+    appendOutput(ui->terminalOutput->prompt(), QColor(152, 195, 121));
+    appendOutput(command + "\n", QColor(204, 204, 204));
+    resetInputLine(QString());
+
+    // While a command runs, lines typed are its standard input
+    if (foregroundJob) {
+        jobs->writeInput(foregroundJob, command.toLocal8Bit() + "\n");
+        return;
+    }
+    if (usePty && isProcessRunning) {
+        pty->write(command.toLocal8Bit() + "\n");
+        return;
+    }
+    if (isProcessRunning && process->state() == QProcess::Running) {
+        process->write(command.toLocal8Bit() + "\n");
+        return;
+    }
+
     QString trimmedCommand = command.trimmed();
 
     if (trimmedCommand.isEmpty()) {
@@ -443,12 +836,12 @@ void Terminal::onCommandEntered(const QString &command)
         return;
     }
 
-    // Add to history
-    if (!trimmedCommand.isEmpty() &&
-        (commandHistory.isEmpty() || commandHistory.last() != trimmedCommand)) {
-        commandHistory.append(trimmedCommand);
-    }
-    historyIndex = commandHistory.size();
+    // Add to history (shared by all tabs, saved with its directory and, once
+    // known, its exit code)
+    CompletionStore::instance().saveHistory(CommandHistory::shared().add(trimmedCommand, workingDirectory));
+    lastHistoryCommand = trimmedCommand;
+    historyIndex = -1;
+    CompletionStore::instance().saveUsage(CompletionIndex::instance().recordCommandLine(trimmedCommand));
 
     // Process internal commands
     if (trimmedCommand == "clear" || trimmedCommand == "cls") {
@@ -456,7 +849,11 @@ void Terminal::onCommandEntered(const QString &command)
         return;
     }
 
-    if (trimmedCommand.startsWith("cd ")) {
+    if (handleJobCommand(trimmedCommand)) return;
+
+    // cd / pwd only need emulating when each command runs in its own process;
+    // the shell of the pseudo-terminal keeps its directory and environment.
+    if (!usePty && trimmedCommand.startsWith("cd ")) {
         QString path = trimmedCommand.mid(3).trimmed();
         if (path.startsWith("\"") && path.endsWith("\"")) {
             path = path.mid(1, path.length() - 2);
@@ -481,7 +878,7 @@ void Terminal::onCommandEntered(const QString &command)
         return;
     }
 
-    if (trimmedCommand == "pwd") {
+    if (!usePty && trimmedCommand == "pwd") {
         appendOutput(workingDirectory + "\n", QColor(204, 204, 204));
         displayPrompt();
         return;
@@ -494,14 +891,24 @@ void Terminal::onCommandEntered(const QString &command)
 void Terminal::executeCommand(const QString &command)
 {
     if (isProcessRunning) {
-        appendOutput("A command is already running. Please wait...\n",
-                     QColor(229, 192, 123));
-        displayPrompt();
+        // The foreground is busy: run it next to the current command
+        appendInfo("A command is already running, starting this one in the background.\n");
+        startJob(command);
         return;
     }
 
+    // Not typed in this tab (run from the editor): not in the history
+    if (command != lastHistoryCommand) lastHistoryCommand.clear();
     isProcessRunning = true;
+
+    if (usePty) {
+        pty->write(command.toLocal8Bit() + "\n");
+        return;
+    }
+
     process->setWorkingDirectory(workingDirectory);
+    stdoutDecoder.reset();
+    stderrDecoder.reset();
 
 #ifdef Q_OS_WIN
     process->start("cmd.exe", QStringList() << "/c" << command);
@@ -518,21 +925,17 @@ void Terminal::executeCommand(const QString &command)
 
 void Terminal::onProcessReadyRead()
 {
-    QByteArray output = process->readAllStandardOutput();
-    QByteArray error = process->readAllStandardError();
-
-    if (!output.isEmpty()) {
-        appendOutput(QString::fromLocal8Bit(output), QColor(204, 204, 204)); // Default color for stdout
-    }
-
-    if (!error.isEmpty()) {
-        appendOutput(QString::fromLocal8Bit(error), QColor(224, 108, 117)); // Red for stderr
-    }
+    pendingStdout += process->readAllStandardOutput();
+    pendingStderr += process->readAllStandardError();
+    scheduleFlush();
 }
 
 void Terminal::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
+    onProcessReadyRead();
+    drainOutput();
     isProcessRunning = false;
+    recordExitCode(exitStatus == QProcess::CrashExit ? -1 : exitCode);
 
     if (exitStatus == QProcess::CrashExit) {
         appendOutput("\nProcess crashed\n", QColor(224, 108, 117));
@@ -552,6 +955,7 @@ void Terminal::onProcessError(QProcess::ProcessError error)
     switch (error) {
     case QProcess::FailedToStart:
         errorMsg = "Failed to start process";
+        recordExitCode(127);
         break;
     case QProcess::Crashed:
         errorMsg = "Process crashed";
@@ -573,6 +977,227 @@ void Terminal::onProcessError(QProcess::ProcessError error)
     displayPrompt();
 }
 
+// ----------------------------------------------------------------------------
+// Background jobs
+// ----------------------------------------------------------------------------
+
+// Built-ins of the job control: `command &`, jobs, fg, kill %n
+bool Terminal::handleJobCommand(const QString &command)
+{
+    if (command.endsWith(QLatin1Char('&')) && !command.endsWith(QLatin1String("&&"))
+        && !command.endsWith(QLatin1String("\\&"))) {
+        QString job = command.chopped(1).trimmed();
+        if (job.isEmpty()) {
+            appendError("syntax error near unexpected token '&'\n");
+        } else {
+            startJob(job);
+        }
+        displayPrompt();
+        return true;
+    }
+
+    QStringList args = command.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    const QString name = args.takeFirst();
+    if (name == "jobs" && args.isEmpty()) {
+        listJobs();
+        displayPrompt();
+        return true;
+    }
+    if (name == "fg" && args.size() <= 1) {
+        foregroundJobCommand(args.value(0));
+        return true;
+    }
+    // `kill <pid>` still goes to the shell, `kill %n` targets a job of this tab
+    if (name == "kill" && std::any_of(args.cbegin(), args.cend(),
+                                      [](const QString &a) { return a.startsWith(QLatin1Char('%')); })) {
+        killJobCommand(args);
+        displayPrompt();
+        return true;
+    }
+    return false;
+}
+
+void Terminal::startJob(const QString &command)
+{
+#ifdef Q_OS_WIN
+    const int id = jobs->start("cmd.exe", QStringList() << "/c" << command, workingDirectory);
+#else
+    // Jobs do not share the pseudo-terminal: each one runs in a shell of its own
+    const int id = jobs->start(currentShell, QStringList() << "-c" << command, workingDirectory);
+#endif
+    backgroundJobs[id].command = command;
+}
+
+// "%n", "n", or "%%" / "%+" / nothing for the most recent job; 0 if there is no such job
+int Terminal::parseJobSpec(const QString &spec) const
+{
+    if (backgroundJobs.empty()) return 0;
+    if (spec.isEmpty() || spec == "%%" || spec == "%+") return backgroundJobs.rbegin()->first;
+
+    bool ok = false;
+    const int id = (spec.startsWith(QLatin1Char('%')) ? spec.mid(1) : spec).toInt(&ok);
+    return ok && backgroundJobs.count(id) ? id : 0;
+}
+
+void Terminal::listJobs()
+{
+    for (const auto &[id, job] : backgroundJobs) {
+        appendOutput(QString("[%1]  ").arg(id), QColor(86, 182, 194));
+        appendOutput(QString("Running    %1  (pid %2)\n").arg(job.command).arg(job.pid),
+                     QColor(204, 204, 204));
+    }
+}
+
+void Terminal::foregroundJobCommand(const QString &spec)
+{
+    const int id = parseJobSpec(spec);
+    if (id == 0) {
+        appendError(QString("fg: %1: no such job\n").arg(spec.isEmpty() ? "current" : spec));
+        displayPrompt();
+        return;
+    }
+
+    // Its output loses the prefix, the lines typed and Ctrl+C / Ctrl+D go to it
+    BackgroundJob &job = backgroundJobs[id];
+    drainOutput();
+    if (!job.atLineStart) appendOutput("\n", QColor(204, 204, 204));
+    appendOutput(job.command + "\n", QColor(204, 204, 204));
+    foregroundJob = id;
+    isProcessRunning = true;
+}
+
+static int signalNumber(QString name)
+{
+    bool ok = false;
+    const int number = name.toInt(&ok);
+    if (ok) return number;
+
+    name = name.toUpper();
+    if (name.startsWith(QLatin1String("SIG"))) name.remove(0, 3);
+    static const struct { const char *name; int number; } signalTable[] = {
+#ifdef Q_OS_WIN
+        { "INT", 2 }, { "KILL", 9 }, { "TERM", 15 },
+#else
+        { "HUP", SIGHUP }, { "INT", SIGINT }, { "QUIT", SIGQUIT }, { "KILL", SIGKILL },
+        { "USR1", SIGUSR1 }, { "USR2", SIGUSR2 }, { "TERM", SIGTERM },
+        { "CONT", SIGCONT }, { "STOP", SIGSTOP },
+#endif
+    };
+    for (const auto &entry : signalTable) {
+        if (name == QLatin1String(entry.name)) return entry.number;
+    }
+    return -1;
+}
+
+// kill [-SIGNAL | -s SIGNAL] %n...
+void Terminal::killJobCommand(const QStringList &args)
+{
+    int signal = SIGTERM;
+    for (int i = 0; i < args.size(); ++i) {
+        QString arg = args.at(i);
+        if (!arg.startsWith(QLatin1Char('-'))) {
+            const int id = parseJobSpec(arg);
+            if (id == 0) {
+                appendError(QString("kill: %1: no such job\n").arg(arg));
+            } else {
+                jobs->sendSignal(id, signal);
+            }
+            continue;
+        }
+        arg = (arg == "-s" && i + 1 < args.size()) ? args.at(++i) : arg.mid(1);
+        signal = signalNumber(arg);
+        if (signal < 0) {
+            appendError(QString("kill: %1: invalid signal specification\n").arg(arg));
+            return;
+        }
+    }
+}
+
+void Terminal::onJobStarted(int id, qint64 pid)
+{
+    auto it = backgroundJobs.find(id);
+    if (it == backgroundJobs.end()) return;
+    it->second.pid = pid;
+    if (foregroundJob == id) return;
+    appendOutput(QString("[%1] %2\n").arg(id).arg(pid), QColor(86, 182, 194));
+}
+
+void Terminal::onJobOutput(int id, const QByteArray &data, bool isError)
+{
+    // Consecutive reads of one stream are applied in one go
+    if (!pendingJobOutput.isEmpty() && pendingJobOutput.last().id == id
+        && pendingJobOutput.last().isError == isError) {
+        pendingJobOutput.last().data += data;
+    } else {
+        pendingJobOutput.append({ id, isError, data });
+    }
+    scheduleFlush();
+}
+
+// Background output is shown line by line behind a "[n] " prefix; a job in
+// the foreground prints like any command.
+void Terminal::appendJobOutput(int id, BackgroundJob &job, const QString &text, bool isError)
+{
+    const QColor textColor = isError ? QColor(224, 108, 117) : QColor(204, 204, 204);
+    if (foregroundJob == id) {
+        if (isError) screen->appendText(text, textColor);
+        else screen->feed(text);
+        return;
+    }
+
+    // Interleaved with other output, cursor moves and colors would only garble it
+    QString plain = text;
+    plain.remove(RegexCache::get(QStringLiteral(R"(\x1b(?:\[[0-?]*[ -/]*[@-~]|\][^\x07\x1b]*(?:\x07|\x1b\\)?|[@-Z\\-_])|\r)")));
+
+    qsizetype pos = 0;
+    while (pos < plain.size()) {
+        if (job.atLineStart) {
+            if (screen->cursorX() != 0) screen->appendText(QStringLiteral("\n"), textColor);
+            screen->appendText(QString("[%1] ").arg(id), QColor(86, 182, 194));
+            job.atLineStart = false;
+        }
+        qsizetype newline = plain.indexOf(QLatin1Char('\n'), pos);
+        if (newline < 0) {
+            screen->appendText(plain.mid(pos), textColor);
+            break;
+        }
+        screen->appendText(plain.mid(pos, newline + 1 - pos), textColor);
+        job.atLineStart = true;
+        pos = newline + 1;
+    }
+}
+
+void Terminal::onJobFinished(int id, int exitCode, bool crashed)
+{
+    auto it = backgroundJobs.find(id);
+    if (it == backgroundJobs.end()) return;
+    // Everything the job printed comes before its status
+    drainOutput();
+    const BackgroundJob &job = it->second;
+
+    if (foregroundJob == id) {
+        foregroundJob = 0;
+        isProcessRunning = false;
+        if (screen->cursorX() != 0) appendOutput("\n", QColor(204, 204, 204));
+        if (crashed) {
+            appendOutput("\nProcess crashed\n", QColor(224, 108, 117));
+        } else if (exitCode != 0) {
+            appendOutput(QString("\nProcess exited with code %1\n").arg(exitCode),
+                         QColor(229, 192, 123));
+        }
+        backgroundJobs.erase(it);
+        displayPrompt();
+        return;
+    }
+
+    QString status = crashed ? QString("Killed") : exitCode == 0 ? QString("Done")
+                                                               : QString("Exit %1").arg(exitCode);
+    if (screen->cursorX() != 0) appendOutput("\n", QColor(204, 204, 204));
+    appendOutput(QString("[%1]  ").arg(id), QColor(86, 182, 194));
+    appendOutput(status.leftJustified(11) + job.command + "\n", QColor(229, 192, 123));
+    backgroundJobs.erase(it);
+}
+
 void Terminal::onUpPressed()
 {
     navigateHistory(-1);
@@ -585,22 +1210,106 @@ void Terminal::onDownPressed()
 
 void Terminal::navigateHistory(int direction)
 {
-    if (commandHistory.isEmpty()) {
+    const CommandHistory &history = CommandHistory::shared();
+    if (history.isEmpty()) {
         return;
     }
 
-    historyIndex += direction;
-
-    if (historyIndex < 0) {
-        historyIndex = 0;
-    } else if (historyIndex >= commandHistory.size()) {
-        historyIndex = commandHistory.size();
+    // Lines run again later left an empty position behind: skip them
+    const int position = historyIndex < 0 ? history.end() : historyIndex;
+    const int target = direction < 0 ? history.previous(position) : history.next(position);
+    if (target < 0) {
+        return; // already on the oldest line
+    }
+    if (target >= history.end()) {
+        historyIndex = -1;
         ui->terminalOutput->clearCurrentCommand();
         return;
     }
 
+    historyIndex = target;
     ui->terminalOutput->clearCurrentCommand();
-    ui->terminalOutput->insertPlainText(commandHistory[historyIndex]);
+    ui->terminalOutput->insertPlainText(history.at(target).command);
+}
+
+void Terminal::recordExitCode(int exitCode)
+{
+    HistoryEntry entry;
+    if (!lastHistoryCommand.isEmpty()
+        && CommandHistory::shared().setExitCode(lastHistoryCommand, exitCode, &entry)) {
+        CompletionStore::instance().saveHistory(entry);
+    }
+    lastHistoryCommand.clear();
+}
+
+// ----------------------------------------------------------------------------
+// Reverse search (Ctrl+R)
+// ----------------------------------------------------------------------------
+
+void Terminal::onReverseSearchRequested()
+{
+    if (!reverseSearching) {
+        reverseSearching = true;
+        searchQuery.clear();
+        searchMatch = CommandHistory::shared().end();
+        searchSavedPrompt = ui->terminalOutput->prompt();
+        searchSavedLine = ui->terminalOutput->getCurrentCommand();
+        ui->terminalOutput->setSearchMode(true);
+        showSearchLine(QString(), false);
+        return;
+    }
+    // Ctrl+R again: the next older match
+    findHistoryMatch(searchMatch);
+}
+
+void Terminal::onSearchTextEntered(const QString &text)
+{
+    searchQuery += text;
+    // The line shown may still match the longer query
+    findHistoryMatch(searchMatch + 1);
+}
+
+void Terminal::onSearchBackspacePressed()
+{
+    if (searchQuery.isEmpty()) return;
+    searchQuery.chop(1);
+    searchMatch = CommandHistory::shared().end();
+    if (searchQuery.isEmpty()) {
+        showSearchLine(QString(), false);
+    } else {
+        findHistoryMatch(searchMatch);
+    }
+}
+
+void Terminal::onSearchFinished(bool accepted)
+{
+    if (!reverseSearching) return;
+    const QString line = accepted ? ui->terminalOutput->getCurrentCommand() : searchSavedLine;
+    reverseSearching = false;
+    ui->terminalOutput->setSearchMode(false);
+    resetInputLine(searchSavedPrompt);
+    ui->terminalOutput->insertPlainText(line);
+    historyIndex = -1;
+}
+
+// Most recent line before `before` containing the query
+void Terminal::findHistoryMatch(int before)
+{
+    const CommandHistory &history = CommandHistory::shared();
+    const int found = searchQuery.isEmpty() ? -1 : history.searchBackward(searchQuery, before);
+    if (found >= 0) {
+        searchMatch = found;
+        showSearchLine(history.at(found).command, false);
+    } else {
+        // Keep the last match on the line
+        showSearchLine(ui->terminalOutput->getCurrentCommand(), !searchQuery.isEmpty());
+    }
+}
+
+void Terminal::showSearchLine(const QString &match, bool failed)
+{
+    resetInputLine(QString("(%1reverse-i-search)`%2': ").arg(failed ? "failed " : "", searchQuery));
+    ui->terminalOutput->insertPlainText(match);
 }
 
 void Terminal::setWorkingDirectory(const QString &path)
@@ -608,6 +1317,12 @@ void Terminal::setWorkingDirectory(const QString &path)
     QDir dir(path);
     if (dir.exists()) {
         workingDirectory = dir.absolutePath();
+        // Move the shell too; the leading space keeps it out of the shell history
+        if (usePty && !isProcessRunning) {
+            ++silentCommands;
+            updateOutputSuppression();
+            pty->write(" cd -- " + shellQuote(workingDirectory) + "\n");
+        }
     }
 }
 
@@ -618,7 +1333,8 @@ QString Terminal::getWorkingDirectory() const
 
 void Terminal::clearTerminal()
 {
-    ui->terminalOutput->clear();
+    screen->clearAll();
+    ui->terminalView->screenUpdated();
     displayPrompt();
 }
 
@@ -634,12 +1350,21 @@ void Terminal::onCloseClicked()
 
 void Terminal::focusTerminal()
 {
+    if (screen->isAlternateScreen()) {
+        ui->terminalView->setFocus();
+        return;
+    }
     ui->terminalOutput->setFocus();
     ui->terminalOutput->moveCursor(QTextCursor::End);
 }
 
+// Entries shown in the completion popup
+static const int MaxSuggestions = 15;
+
 void Terminal::initializeCommandDatabase()
 {
+    QStringList commonCommands;
+    QMap<QString, QStringList> commandArguments;
 #ifdef Q_OS_WIN
     // Common Windows commands
     commonCommands << "cd" << "dir" << "cls" << "copy" << "move" << "del" << "mkdir"
@@ -682,82 +1407,33 @@ void Terminal::initializeCommandDatabase()
                                             << "add" << "status" << "log" << "branch"
                                             << "checkout" << "merge" << "rebase" << "init";
 #endif
-    // Load cached commands (if any) for instant suggestions
-    loadCommandCache();
-
-    // Kick off an asynchronous system scan to find all executables in PATH
-    scanSystemCommandsAsync();
-}
-
-QStringList Terminal::getCommandSuggestions(const QString &partial)
-{
-    QStringList suggestions;
-    QString lowerPartial = partial.toLower();
-    
-    // Search in common commands
-    for (const QString &cmd : commonCommands) {
-        if (cmd.startsWith(lowerPartial, Qt::CaseInsensitive)) {
-            suggestions << cmd;
-        }
+    CompletionIndex &index = CompletionIndex::instance();
+    index.addCommands(commonCommands);
+    for (auto it = commandArguments.cbegin(); it != commandArguments.cend(); ++it) {
+        if (!index.hasArguments(it.key())) index.setArguments(it.key(), it.value());
     }
-    
-    // Search in command history
-    for (const QString &histCmd : commandHistory) {
-        QString firstWord = histCmd.split(' ').first();
-        if (firstWord.startsWith(lowerPartial, Qt::CaseInsensitive) && !suggestions.contains(firstWord)) {
-            suggestions << firstWord;
-        }
-    }
-    
-    suggestions.sort(Qt::CaseInsensitive);
-    return suggestions;
-}
 
-// Load cached commands from a simple cache file to provide instant suggestions
-void Terminal::loadCommandCache()
-{
-    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    if (cacheDir.isEmpty()) return;
-    QDir().mkpath(cacheDir);
-    QString cacheFile = cacheDir + QDir::separator() + "commands_cache.txt";
+    // Saved commands, arguments and ranking: read once per process, in the background
+    CompletionStore::instance();
 
-    QFile f(cacheFile);
-    if (!f.exists()) return;
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return;
-
-    QTextStream in(&f);
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (!line.isEmpty() && !commonCommands.contains(line)) {
-            commonCommands << line;
-        }
+    // Kick off an asynchronous system scan to find all executables in PATH (once per process)
+    static bool systemCommandsScanned = false;
+    if (!systemCommandsScanned) {
+        systemCommandsScanned = true;
+        scanSystemCommandsAsync();
     }
-    f.close();
-    commonCommands.removeDuplicates();
-    commonCommands.sort(Qt::CaseInsensitive);
 }
 
-// Save current command list to cache file
-void Terminal::saveCommandCache()
+// Commands seen in the history are in the index too (see onCommandEntered)
+QStringList Terminal::getCommandSuggestions(const QString &partial)
 {
-    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    if (cacheDir.isEmpty()) return;
-    QDir().mkpath(cacheDir);
-    QString cacheFile = cacheDir + QDir::separator() + "commands_cache.txt";
-
-    QFile f(cacheFile);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) return;
-    QTextStream out(&f);
-    for (const QString &cmd : commonCommands) {
-        out << cmd << "\n";
-    }
-    f.close();
+    return CompletionIndex::instance().completeCommand(partial, MaxSuggestions);
 }
 
-// Asynchronously scan system PATH for executables and merge into commonCommands
+// Asynchronously scan system PATH for executables and merge them into the completion index
 void Terminal::scanSystemCommandsAsync()
 {
-    auto future = QtConcurrent::run([this]() -> QStringList {
+    auto future = QtConcurrent::run([]() -> QStringList {
         QStringList result;
         QString pathEnv = qEnvironmentVariable("PATH");
         QStringList paths = pathEnv.split(QDir::listSeparator(), Qt::SkipEmptyParts);
@@ -795,75 +1471,18 @@ void Terminal::scanSystemCommandsAsync()
         return result;
     });
 
-    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(this);
-    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher]() {
-        QStringList found = watcher->result();
-        bool changed = false;
-        for (const QString &c : found) {
-            if (!commonCommands.contains(c)) {
-                commonCommands << c;
-                changed = true;
-            }
-        }
-        if (changed) {
-            commonCommands.removeDuplicates();
-            commonCommands.sort(Qt::CaseInsensitive);
-            saveCommandCache();
+    // Owned by the store: the result is kept even if this tab is closed first
+    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(&CompletionStore::instance());
+    connect(watcher, &QFutureWatcher<QStringList>::finished, watcher, [watcher]() {
+        const QStringList found = watcher->result();
+        if (CompletionIndex::instance().addCommands(found) > 0) {
+            CompletionStore::instance().addCommands(found);
         }
         watcher->deleteLater();
     });
     watcher->setFuture(future);
 }
 
-// Load cached arguments for a specific command
-QStringList Terminal::loadCachedArguments(const QString &command)
-{
-    QStringList result;
-    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    if (cacheDir.isEmpty()) return result;
-    QDir().mkpath(cacheDir);
-    QString safeName = command;
-    // sanitize filename
-    safeName.remove(QRegularExpression("[^A-Za-z0-9_.-]"));
-    if (safeName.isEmpty()) return result;
-    QString cacheFile = cacheDir + QDir::separator() + QString("args_%1.txt").arg(safeName);
-
-    QFile f(cacheFile);
-    if (!f.exists()) return result;
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return result;
-    QTextStream in(&f);
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (!line.isEmpty()) result << line;
-    }
-    f.close();
-    result.removeDuplicates();
-    result.sort(Qt::CaseInsensitive);
-    return result;
-}
-
-// Save cached arguments for a specific command
-void Terminal::saveCachedArguments(const QString &command)
-{
-    if (!commandArguments.contains(command)) return;
-    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    if (cacheDir.isEmpty()) return;
-    QDir().mkpath(cacheDir);
-    QString safeName = command;
-    safeName.remove(QRegularExpression("[^A-Za-z0-9_.-]"));
-    if (safeName.isEmpty()) return;
-    QString cacheFile = cacheDir + QDir::separator() + QString("args_%1.txt").arg(safeName);
-
-    QFile f(cacheFile);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) return;
-    QTextStream out(&f);
-    const QStringList &args = commandArguments[command];
-    for (const QString &a : args) {
-        out << a << "\n";
-    }
-    f.close();
-}
-
 // Asynchronously discover possible arguments for a given command by parsing its help output
 void Terminal::scanCommandArgumentsAsync(const QString &command)
 {
@@ -905,7 +1524,7 @@ void Terminal::scanCommandArgumentsAsync(const QString &command)
         QString snippet = lines.join('\n');
 
         // regex to extract flags: -a, --long, /option and options with =VALUE
-        QRegularExpression re(R"((?:^|[\s,;()\[\]])(-{1,2}[A-Za-z0-9][A-Za-z0-9._-]*(?:[= ][A-Za-z0-9_<>\\[\]-]+)?|/[A-Za-z0-9._-]+))");
+        const QRegularExpression re = RegexCache::get(QStringLiteral(R"((?:^|[\s,;()\[\]])(-{1,2}[A-Za-z0-9][A-Za-z0-9._-]*(?:[= ][A-Za-z0-9_<>\\[\]-]+)?|/[A-Za-z0-9._-]+))"));
         QSet<QString> seen;
         QRegularExpressionMatchIterator it = re.globalMatch(snippet);
         while (it.hasNext()) {
@@ -934,12 +1553,11 @@ void Terminal::scanCommandArgumentsAsync(const QString &command)
     });
 
     QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(this);
-    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, command]() {
-        QStringList found = watcher->result();
-        if (!found.isEmpty()) {
-            commandArguments[command] = found;
-            saveCachedArguments(command);
-        }
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [watcher, command]() {
+        // Saved even when nothing was found: the scan is not repeated
+        const QStringList found = watcher->result();
+        CompletionIndex::instance().setArguments(command, found);
+        CompletionStore::instance().setArguments(command, found);
         watcher->deleteLater();
     });
     watcher->setFuture(future);
@@ -947,18 +1565,7 @@ void Terminal::scanCommandArgumentsAsync(const QString &command)
 
 QStringList Terminal::getArgumentSuggestions(const QString &command, const QString &partial)
 {
-    QStringList suggestions;
-    
-    if (commandArguments.contains(command)) {
-        const QStringList &args = commandArguments[command];
-        for (const QString &arg : args) {
-            if (arg.startsWith(partial, Qt::CaseInsensitive)) {
-                suggestions << arg;
-            }
-        }
-    }
-    
-    return suggestions;
+    return CompletionIndex::instance().completeArgument(command, partial, MaxSuggestions);
 }
 
 QStringList Terminal::getPathSuggestions(const QString &partial)
@@ -966,7 +1573,7 @@ QStringList Terminal::getPathSuggestions(const QString &partial)
     QStringList suggestions;
     
     QString basePath = partial;
-    QString searchPattern = "*";
+    QString searchPattern;
     
     // Extract directory and filename pattern
     int lastSlash = partial.lastIndexOf('/');
@@ -976,10 +1583,10 @@ QStringList Terminal::getPathSuggestions(const QString &partial)
     
     if (lastSlash != -1) {
         basePath = partial.left(lastSlash + 1);
-        searchPattern = partial.mid(lastSlash + 1) + "*";
+        searchPattern = partial.mid(lastSlash + 1);
     } else {
         basePath = "";
-        searchPattern = partial + "*";
+        searchPattern = partial;
     }
     
     // Determine search directory
@@ -992,24 +1599,20 @@ QStringList Terminal::getPathSuggestions(const QString &partial)
         searchDir = QDir(workingDirectory + "/" + basePath);
     }
     
-    if (!searchDir.exists()) {
-        return suggestions;
-    }
-    
-    // Get matching entries
-    QStringList entries = searchDir.entryList(
-        QStringList() << searchPattern,
-        QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot,
-        QDir::Name
-    );
-    
-    for (const QString &entry : entries) {
-        QString fullPath = basePath + entry;
-        QFileInfo info(searchDir.absoluteFilePath(entry));
-        if (info.isDir()) {
-            fullPath += "/";
-        }
-        suggestions << fullPath;
+    // Cached listing, typed without a stat per entry. A directory never read
+    // yet is read in the background and the popup is updated once it is in
+    // (see onDirectoryListingUpdated).
+    const QString directory = QDir::cleanPath(searchDir.absolutePath());
+    bool ready = false;
+    const QVector<DirectoryEntry> entries = DirectoryListingCache::instance().entries(directory, &ready);
+    pendingListing = ready ? QString() : directory;
+
+    // Hidden entries only when asked for, like the shell
+    const bool showHidden = searchPattern.startsWith(QLatin1Char('.'));
+    for (const DirectoryEntry &entry : entries) {
+        if (!entry.name.startsWith(searchPattern, Qt::CaseInsensitive)) continue;
+        if (!showHidden && entry.name.startsWith(QLatin1Char('.'))) continue;
+        suggestions << basePath + entry.name + (entry.isDirectory ? "/" : "");
     }
     
     return suggestions;
@@ -1041,15 +1644,12 @@ void Terminal::updateAutoComplete()
         QString command = parts[0];
         QString lastPart = parts.last();
 
-        // Ensure we have cached arguments for this command; if not, try loading cache and schedule async scan
-        if (!commandArguments.contains(command)) {
-            QStringList cached = loadCachedArguments(command);
-            if (!cached.isEmpty()) {
-                commandArguments[command] = cached;
-            } else {
-                // Launch async scan to populate arguments for this command
-                scanCommandArgumentsAsync(command);
-            }
+        // Arguments never looked for (neither built in nor saved): scan the help
+        // of the command, once; wait for the saved ones to be loaded first
+        CompletionIndex &index = CompletionIndex::instance();
+        if (!index.hasArguments(command) && CompletionStore::instance().isLoaded()) {
+            index.setArguments(command, QStringList());
+            scanCommandArgumentsAsync(command);
         }
 
         // Try argument suggestions first
@@ -1062,8 +1662,8 @@ void Terminal::updateAutoComplete()
     }
     
     // Limit suggestions to avoid overwhelming the user
-    if (suggestions.size() > 15) {
-        suggestions = suggestions.mid(0, 15);
+    if (suggestions.size() > MaxSuggestions) {
+        suggestions = suggestions.mid(0, MaxSuggestions);
     }
     
     if (!suggestions.isEmpty()) {
@@ -1073,6 +1673,14 @@ void Terminal::updateAutoComplete()
     }
 }
 
+void Terminal::onDirectoryListingUpdated(const QString &path)
+{
+    // The listing the popup is waiting for
+    if (path != pendingListing) return;
+    pendingListing.clear();
+    if (ui->terminalOutput->hasFocus()) updateAutoComplete();
+}
+
 void Terminal::onTextChangedForAutoComplete()
 {
     updateAutoComplete();
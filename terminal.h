@@ -9,6 +9,17 @@
 #include <QListWidget>
 #include <QMap>
 #include <QStringList>
+#include <QElapsedTimer>
+#include <QVector>
+#include <map>
+#include "streamdecoder.h"
+
+class PtyProcess;
+class JobController;
+class TerminalScreen;
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 namespace Ui {
 class Terminal;
@@ -39,8 +50,11 @@ class TerminalTextEdit : public QTextEdit
 public:
     explicit TerminalTextEdit(QWidget *parent = nullptr);
     void setPrompt(const QString &prompt);
+    QString prompt() const { return currentPrompt; }
     QString getCurrentCommand() const;
     void clearCurrentCommand();
+    // While searching the history, typed text goes to the search query
+    void setSearchMode(bool on) { searchMode = on; }
     void showAutoComplete(const QStringList &suggestions);
     void hideAutoComplete();
     void acceptSuggestion(const QString &suggestion);
@@ -51,6 +65,12 @@ signals:
     void downPressed();
     void tabPressed();
     void textChangedForAutoComplete();
+    void interruptRequested();
+    void endOfInputRequested();
+    void reverseSearchRequested();
+    void searchTextEntered(const QString &text);
+    void searchBackspacePressed();
+    void searchFinished(bool accepted);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -60,6 +80,7 @@ protected:
 private:
     int promptPosition;
     QString currentPrompt;
+    bool searchMode;
     AutoCompletePopup *autoCompletePopup;
 
     void ensureCursorInEditableArea();
@@ -87,31 +108,90 @@ signals:
 
 private slots:
     void onCommandEntered(const QString &command);
+    void scheduleFlush();
+    void flushOutput();
+    void onPtyFinished(int exitCode);
+    void onScreenOsc(int code, const QString &data);
+    void onViewKeyInput(const QByteArray &data);
+    void onViewSizeChanged(int columns, int rows);
+    void onAlternateScreenChanged(bool active);
+    void onInterruptRequested();
+    void onEndOfInputRequested();
     void onProcessReadyRead();
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onProcessError(QProcess::ProcessError error);
+    void onJobStarted(int id, qint64 pid);
+    void onJobOutput(int id, const QByteArray &data, bool isError);
+    void onJobFinished(int id, int exitCode, bool crashed);
     void onUpPressed();
     void onDownPressed();
+    void onReverseSearchRequested();
+    void onSearchTextEntered(const QString &text);
+    void onSearchBackspacePressed();
+    void onSearchFinished(bool accepted);
     void onClearClicked();
     void onCloseClicked();
     void onTextChangedForAutoComplete();
+    void onDirectoryListingUpdated(const QString &path);
     void onSuggestionSelected(const QString &suggestion);
 
 private:
     Ui::Terminal *ui;
     QProcess *process;
+    // Long-lived interactive shell; when it cannot be started (Windows, no
+    // bash/zsh) every command runs through `process` instead.
+    PtyProcess *pty;
+    bool usePty;
+    bool shellReady;
+    int silentCommands;
+    // Everything shown above the command line goes through this cell grid
+    TerminalScreen *screen;
+    // Output is collected between frames and applied by flushOutput()
+    QTimer *flushTimer;
+    QElapsedTimer lastFlush;
+    QByteArray readBuffer;
+    QByteArray pendingStdout;
+    QByteArray pendingStderr;
+    // One decoder per stream: characters split between reads stay whole
+    StreamDecoder ptyDecoder;
+    StreamDecoder stdoutDecoder;
+    StreamDecoder stderrDecoder;
+    QString decodeBuffer;
+
+    // Background jobs ("command &"), numbered like shell jobs
+    struct BackgroundJob {
+        QString command;
+        qint64 pid = 0;
+        bool atLineStart = true;    // the next output starts with the "[n] " prefix
+        StreamDecoder stdoutDecoder;
+        StreamDecoder stderrDecoder;
+    };
+    struct JobChunk {
+        int id;
+        bool isError;
+        QByteArray data;
+    };
+    JobController *jobs;
+    std::map<int, BackgroundJob> backgroundJobs;
+    QVector<JobChunk> pendingJobOutput;
+    int foregroundJob;              // job brought back with `fg`, 0 if none
+
     QString workingDirectory;
     QString currentShell;
-    QStringList commandHistory;
+    // Position in CommandHistory::shared() while stepping with Up/Down, -1 past the end
     int historyIndex;
+    QString lastHistoryCommand;     // line waiting for its exit code
+    // Ctrl+R search state
+    bool reverseSearching;
+    QString searchQuery;
+    int searchMatch;
+    QString searchSavedPrompt;
+    QString searchSavedLine;
+    QString pendingListing;         // directory the completion popup waits for
     bool isProcessRunning;
     bool isDragging;
     QPoint dragStartPosition;
     
-    // Autocomplete data structures
-    QMap<QString, QStringList> commandArguments;
-    QStringList commonCommands;
-    
     void setupTerminal();
     void displayPrompt();
     void appendOutput(const QString &text, const QColor &color);
@@ -120,8 +200,23 @@ private:
     void appendInfo(const QString &text);
     void initializeShell();
     QString getSystemShell();
+    bool startShell();
+    void drainOutput();
+    void handleShellMarker(const QString &payload);
+    void updateOutputSuppression();
+    void resetInputLine(const QString &prompt);
     void navigateHistory(int direction);
+    void recordExitCode(int exitCode);
+    void findHistoryMatch(int before);
+    void showSearchLine(const QString &match, bool failed);
     void processInternalCommand(const QString &command);
+    bool handleJobCommand(const QString &command);
+    void startJob(const QString &command);
+    void listJobs();
+    void foregroundJobCommand(const QString &spec);
+    void killJobCommand(const QStringList &args);
+    int parseJobSpec(const QString &spec) const;
+    void appendJobOutput(int id, BackgroundJob &job, const QString &text, bool isError);
     
     // Autocomplete helper methods
     void initializeCommandDatabase();
@@ -129,14 +224,10 @@ private:
     QStringList getArgumentSuggestions(const QString &command, const QString &partial);
     QStringList getPathSuggestions(const QString &partial);
     void updateAutoComplete();
-    // Command argument discovery & cache
+    // Command argument discovery (results go to the CompletionIndex and CompletionStore)
     void scanCommandArgumentsAsync(const QString &command);
-    QStringList loadCachedArguments(const QString &command);
-    void saveCachedArguments(const QString &command);
-    // System command scanning & cache
+    // System command scanning
     void scanSystemCommandsAsync();
-    void loadCommandCache();
-    void saveCommandCache();
 };
 
 #endif // TERMINAL_H
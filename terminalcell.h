@@ -0,0 +1,68 @@
+#ifndef TERMINALCELL_H
+#define TERMINALCELL_H
+
+#include <QVector>
+#include <QString>
+#include <QColor>
+
+// Colors are packed in 32 bits: the top byte tells how to read the rest
+namespace TerminalColor
+{
+    enum Kind : quint32 {
+        Default = 0x00000000,
+        Indexed = 0x01000000,   // low byte: xterm 256-color palette index
+        Rgb     = 0x02000000    // low 24 bits: 0xRRGGBB
+    };
+    inline quint32 indexed(int index) { return Indexed | quint32(index & 0xff); }
+    inline quint32 rgb(int r, int g, int b) { return Rgb | (quint32(r & 0xff) << 16) | (quint32(g & 0xff) << 8) | quint32(b & 0xff); }
+    inline quint32 fromQColor(const QColor &c) { return rgb(c.red(), c.green(), c.blue()); }
+}
+
+// Attributes shared by consecutive cells; compared as a whole when painting runs
+struct CellAttributes
+{
+    enum Flag : quint16 {
+        Bold      = 0x0001,
+        Faint     = 0x0002,
+        Italic    = 0x0004,
+        Underline = 0x0008,
+        Blink     = 0x0010,
+        Inverse   = 0x0020,
+        Hidden    = 0x0040,
+        Strike    = 0x0080
+    };
+
+    quint32 foreground = TerminalColor::Default;
+    quint32 background = TerminalColor::Default;
+    quint16 flags = 0;
+
+    bool operator==(const CellAttributes &o) const
+    {
+        return foreground == o.foreground && background == o.background && flags == o.flags;
+    }
+    bool operator!=(const CellAttributes &o) const { return !(*this == o); }
+};
+
+// One character cell; lines are plain arrays of them
+struct TerminalCell
+{
+    enum Width : quint16 {
+        Single = 0,
+        WideHead = 1,   // first half of a double-width character
+        WideTail = 2    // second half: nothing to draw
+    };
+
+    char32_t ch = U' ';
+    CellAttributes attributes;
+    quint16 width = Single;
+};
+
+struct TerminalLine
+{
+    QVector<TerminalCell> cells;
+    bool wrapped = false;   // continues on the next line (soft wrap)
+
+    QString text() const;
+};
+
+#endif // TERMINALCELL_H
@@ -0,0 +1,782 @@
+#include "terminalscreen.h"
+#include <algorithm>
+
+static const int TabWidth = 8;
+
+// DEC special graphics, characters 0x60 .. 0x7e (line drawing used by ncurses, mc, ...)
+static const char16_t DecGraphics[31] = {
+    0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0, 0x00B1,
+    0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C, 0x23BA,
+    0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534, 0x252C,
+    0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7
+};
+
+// East Asian wide and emoji ranges: these take two cells
+static bool isWide(char32_t ch)
+{
+    if (ch < 0x1100) return false;
+    return (ch <= 0x115F)
+        || (ch >= 0x2E80 && ch <= 0xA4CF && ch != 0x303F)
+        || (ch >= 0xAC00 && ch <= 0xD7A3)
+        || (ch >= 0xF900 && ch <= 0xFAFF)
+        || (ch >= 0xFE30 && ch <= 0xFE4F)
+        || (ch >= 0xFF00 && ch <= 0xFF60)
+        || (ch >= 0xFFE0 && ch <= 0xFFE6)
+        || (ch >= 0x1F300 && ch <= 0x1F64F)
+        || (ch >= 0x1F900 && ch <= 0x1F9FF)
+        || (ch >= 0x20000 && ch <= 0x3FFFD);
+}
+
+static bool isZeroWidth(char32_t ch)
+{
+    if (ch < 0x300) return false;
+    if (ch >= 0x200B && ch <= 0x200F) return true;
+    if (ch >= 0xFE00 && ch <= 0xFE0F) return true; // variation selectors
+    QChar::Category cat = QChar::category(ch);
+    return cat == QChar::Mark_NonSpacing || cat == QChar::Mark_Enclosing;
+}
+
+QString TerminalLine::text() const
+{
+    QString out;
+    out.reserve(cells.size());
+    for (const TerminalCell &cell : cells) {
+        if (cell.width == TerminalCell::WideTail) continue;
+        if (QChar::requiresSurrogates(cell.ch)) {
+            out += QChar(QChar::highSurrogate(cell.ch));
+            out += QChar(QChar::lowSurrogate(cell.ch));
+        } else {
+            out += QChar(static_cast<char16_t>(cell.ch));
+        }
+    }
+    return out;
+}
+
+TerminalScreen::TerminalScreen(int columns, int rows, QObject *parent)
+    : QObject(parent)
+    , parser(this)
+    , cols(qMax(1, columns))
+    , screenRows(qMax(1, rows))
+    , alternateActive(false)
+    , outputSuppressed(false)
+    , allDirty(true)
+{
+    fullReset();
+}
+
+void TerminalScreen::fullReset()
+{
+    attributes = CellAttributes();
+    cursorCol = 0;
+    cursorRow = 0;
+    pendingWrap = false;
+    scrollTop = 0;
+    scrollBottom = screenRows - 1;
+    autoWrap = true;
+    insertMode = false;
+    originMode = false;
+    cursorVisible = true;
+    appCursorKeys = false;
+    bracketedPasteMode = false;
+    lineDrawing = false;
+    lastChar = U' ';
+    savedCursor = SavedCursor();
+    savedMainCursor = SavedCursor();
+
+    if (alternateActive) {
+        alternateActive = false;
+        emit alternateScreenChanged(false);
+    }
+    savedMainLines.clear();
+    screenLines.fill(blankLine(), screenRows);
+    dirtyRows.fill(false, screenRows);
+    markAllDirty();
+}
+
+void TerminalScreen::feed(QStringView text)
+{
+    parser.feed(text);
+}
+
+void TerminalScreen::appendText(const QString &text, const QColor &color)
+{
+    const CellAttributes saved = attributes;
+    const bool wasSuppressed = outputSuppressed;
+    attributes = CellAttributes();
+    attributes.foreground = TerminalColor::fromQColor(color);
+    outputSuppressed = false;
+
+    const QChar *data = text.constData();
+    const int n = text.size();
+    int runStart = 0;
+    for (int i = 0; i <= n; ++i) {
+        if (i < n && data[i].unicode() >= 0x20) continue;
+        if (i > runStart) print(data + runStart, i - runStart);
+        if (i < n) {
+            const char16_t c = data[i].unicode();
+            if (c == '\n') {
+                carriageReturn();
+                lineFeed();
+            } else if (c == '\t') {
+                execute(c);
+            }
+        }
+        runStart = i + 1;
+    }
+
+    attributes = saved;
+    outputSuppressed = wasSuppressed;
+}
+
+void TerminalScreen::clearAll()
+{
+    history.clear();
+    screenLines.fill(blankLine(), screenRows);
+    cursorCol = 0;
+    cursorRow = 0;
+    pendingWrap = false;
+    markAllDirty();
+}
+
+int TerminalScreen::historySize() const
+{
+    // The scrollback belongs to the main screen
+    return alternateActive ? 0 : history.size();
+}
+
+TerminalLine TerminalScreen::lineAt(int index) const
+{
+    const int h = historySize();
+    if (index < h) return history.at(index);
+    return screenLines.at(qBound(0, index - h, screenRows - 1));
+}
+
+void TerminalScreen::setHistoryLimit(int lines)
+{
+    history.setMaxLines(lines);
+}
+
+void TerminalScreen::clearDirty()
+{
+    std::fill(dirtyRows.begin(), dirtyRows.end(), false);
+    allDirty = false;
+}
+
+void TerminalScreen::markDirty(int row)
+{
+    if (row >= 0 && row < dirtyRows.size()) dirtyRows[row] = true;
+}
+
+void TerminalScreen::markAllDirty()
+{
+    allDirty = true;
+}
+
+TerminalCell TerminalScreen::blankCell() const
+{
+    // Erased cells take the current background (xterm "bce")
+    TerminalCell cell;
+    cell.attributes.background = attributes.background;
+    return cell;
+}
+
+TerminalLine TerminalScreen::blankLine() const
+{
+    TerminalLine line;
+    line.cells.fill(blankCell(), cols);
+    return line;
+}
+
+void TerminalScreen::pushHistory(const TerminalLine &line)
+{
+    history.append(line);
+}
+
+// ---------------------------------------------------------------------------
+// Printing and cursor movement
+// ---------------------------------------------------------------------------
+
+void TerminalScreen::print(const QChar *text, int length)
+{
+    if (outputSuppressed) return;
+    for (int i = 0; i < length; ++i) {
+        char32_t ch = text[i].unicode();
+        if (QChar::isHighSurrogate(ch) && i + 1 < length && text[i + 1].isLowSurrogate()) {
+            ch = QChar::surrogateToUcs4(text[i], text[i + 1]);
+            ++i;
+        } else if (QChar::isSurrogate(ch)) {
+            ch = 0xFFFD;
+        }
+        putChar(ch);
+    }
+}
+
+void TerminalScreen::putChar(char32_t ch)
+{
+    if (lineDrawing && ch >= 0x60 && ch <= 0x7e) ch = DecGraphics[ch - 0x60];
+    if (isZeroWidth(ch)) return;
+    const bool wide = isWide(ch) && cols > 1;
+
+    if (pendingWrap) {
+        if (autoWrap) {
+            screenLines[cursorRow].wrapped = true;
+            carriageReturn();
+            lineFeed();
+        }
+        pendingWrap = false;
+    }
+    if (wide && cursorCol == cols - 1) {
+        // No room for both halves on this line
+        if (!autoWrap) return;
+        eraseCells(cursorRow, cursorCol, cols);
+        screenLines[cursorRow].wrapped = true;
+        carriageReturn();
+        lineFeed();
+    }
+    if (insertMode) insertCells(wide ? 2 : 1);
+
+    QVector<TerminalCell> &cells = screenLines[cursorRow].cells;
+    // Overwriting half of a wide character erases the other half
+    auto breakWide = [&](int col) {
+        if (col < 0 || col >= cols) return;
+        if (cells[col].width == TerminalCell::WideTail && col > 0) cells[col - 1] = blankCell();
+        if (cells[col].width == TerminalCell::WideHead && col + 1 < cols) cells[col + 1] = blankCell();
+    };
+    breakWide(cursorCol);
+    if (wide) breakWide(cursorCol + 1);
+
+    TerminalCell &cell = cells[cursorCol];
+    cell.ch = ch;
+    cell.attributes = attributes;
+    cell.width = wide ? TerminalCell::WideHead : TerminalCell::Single;
+    if (wide) {
+        TerminalCell &tail = cells[cursorCol + 1];
+        tail.ch = 0;
+        tail.attributes = attributes;
+        tail.width = TerminalCell::WideTail;
+    }
+    markDirty(cursorRow);
+    lastChar = ch;
+
+    cursorCol += wide ? 2 : 1;
+    if (cursorCol >= cols) {
+        cursorCol = cols - 1;
+        pendingWrap = autoWrap;
+    }
+}
+
+void TerminalScreen::execute(char16_t control)
+{
+    if (control == 0x07) {
+        emit bell();
+        return;
+    }
+    if (outputSuppressed) return;
+
+    switch (control) {
+    case '\r':
+        carriageReturn();
+        break;
+    case '\n':
+    case 0x0b:
+    case 0x0c:
+        lineFeed();
+        break;
+    case 0x08:
+        if (cursorCol > 0) --cursorCol;
+        pendingWrap = false;
+        break;
+    case '\t':
+        cursorCol = qMin(cols - 1, (cursorCol / TabWidth + 1) * TabWidth);
+        pendingWrap = false;
+        break;
+    case 0x0e: // SO / SI: G1 is never designated, stay on G0
+    case 0x0f:
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::carriageReturn()
+{
+    cursorCol = 0;
+    pendingWrap = false;
+}
+
+void TerminalScreen::lineFeed()
+{
+    pendingWrap = false;
+    if (cursorRow == scrollBottom) {
+        scrollUp(scrollTop, scrollBottom, 1, scrollTop == 0 && !alternateActive);
+    } else if (cursorRow < screenRows - 1) {
+        ++cursorRow;
+    }
+}
+
+void TerminalScreen::reverseIndex()
+{
+    pendingWrap = false;
+    if (cursorRow == scrollTop) {
+        scrollDown(scrollTop, scrollBottom, 1);
+    } else if (cursorRow > 0) {
+        --cursorRow;
+    }
+}
+
+void TerminalScreen::scrollUp(int top, int bottom, int count, bool toHistory)
+{
+    count = qMin(count, bottom - top + 1);
+    if (count <= 0) return;
+    for (int i = 0; i < count; ++i) {
+        if (toHistory) pushHistory(screenLines.at(top));
+        screenLines.remove(top);
+        screenLines.insert(bottom, blankLine());
+    }
+    if (top == 0 && bottom == screenRows - 1) {
+        markAllDirty();
+    } else {
+        for (int r = top; r <= bottom; ++r) markDirty(r);
+    }
+}
+
+void TerminalScreen::scrollDown(int top, int bottom, int count)
+{
+    count = qMin(count, bottom - top + 1);
+    if (count <= 0) return;
+    for (int i = 0; i < count; ++i) {
+        screenLines.remove(bottom);
+        screenLines.insert(top, blankLine());
+    }
+    for (int r = top; r <= bottom; ++r) markDirty(r);
+}
+
+void TerminalScreen::eraseCells(int row, int from, int to)
+{
+    if (row < 0 || row >= screenRows) return;
+    from = qBound(0, from, cols);
+    to = qBound(0, to, cols);
+    if (from >= to) return;
+    QVector<TerminalCell> &cells = screenLines[row].cells;
+    // Never leave half of a wide character behind
+    if (from > 0 && cells[from].width == TerminalCell::WideTail) cells[from - 1] = blankCell();
+    if (to < cols && cells[to].width == TerminalCell::WideTail) cells[to] = blankCell();
+    const TerminalCell blank = blankCell();
+    std::fill(cells.begin() + from, cells.begin() + to, blank);
+    if (to == cols) screenLines[row].wrapped = false;
+    markDirty(row);
+}
+
+void TerminalScreen::eraseDisplay(int mode)
+{
+    switch (mode) {
+    case 0:
+        eraseCells(cursorRow, cursorCol, cols);
+        for (int r = cursorRow + 1; r < screenRows; ++r) eraseCells(r, 0, cols);
+        break;
+    case 1:
+        for (int r = 0; r < cursorRow; ++r) eraseCells(r, 0, cols);
+        eraseCells(cursorRow, 0, cursorCol + 1);
+        break;
+    case 2:
+        for (int r = 0; r < screenRows; ++r) eraseCells(r, 0, cols);
+        break;
+    case 3:
+        history.clear();
+        markAllDirty();
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::eraseLine(int mode)
+{
+    switch (mode) {
+    case 0: eraseCells(cursorRow, cursorCol, cols); break;
+    case 1: eraseCells(cursorRow, 0, cursorCol + 1); break;
+    case 2: eraseCells(cursorRow, 0, cols); break;
+    default: break;
+    }
+}
+
+void TerminalScreen::insertCells(int count)
+{
+    QVector<TerminalCell> &cells = screenLines[cursorRow].cells;
+    count = qMin(count, cols - cursorCol);
+    if (count <= 0) return;
+    std::move_backward(cells.begin() + cursorCol, cells.end() - count, cells.end());
+    std::fill(cells.begin() + cursorCol, cells.begin() + cursorCol + count, blankCell());
+    if (cells[cols - 1].width == TerminalCell::WideHead) cells[cols - 1] = blankCell();
+    markDirty(cursorRow);
+}
+
+void TerminalScreen::deleteCells(int count)
+{
+    QVector<TerminalCell> &cells = screenLines[cursorRow].cells;
+    count = qMin(count, cols - cursorCol);
+    if (count <= 0) return;
+    std::move(cells.begin() + cursorCol + count, cells.end(), cells.begin() + cursorCol);
+    std::fill(cells.end() - count, cells.end(), blankCell());
+    if (cells[cursorCol].width == TerminalCell::WideTail) cells[cursorCol] = blankCell();
+    markDirty(cursorRow);
+}
+
+void TerminalScreen::setCursor(int col, int row)
+{
+    if (originMode) {
+        row = qBound(scrollTop, row + scrollTop, scrollBottom);
+    } else {
+        row = qBound(0, row, screenRows - 1);
+    }
+    cursorCol = qBound(0, col, cols - 1);
+    cursorRow = row;
+    pendingWrap = false;
+}
+
+void TerminalScreen::saveCursorState()
+{
+    savedCursor.col = cursorCol;
+    savedCursor.row = cursorRow;
+    savedCursor.attributes = attributes;
+    savedCursor.lineDrawing = lineDrawing;
+}
+
+void TerminalScreen::restoreCursorState()
+{
+    cursorCol = qBound(0, savedCursor.col, cols - 1);
+    cursorRow = qBound(0, savedCursor.row, screenRows - 1);
+    attributes = savedCursor.attributes;
+    lineDrawing = savedCursor.lineDrawing;
+    pendingWrap = false;
+}
+
+// ---------------------------------------------------------------------------
+// Escape sequences
+// ---------------------------------------------------------------------------
+
+void TerminalScreen::csiDispatch(const int *params, int count, const QByteArray &intermediates, char16_t final)
+{
+    auto param = [&](int i, int def) { return (i < count && params[i] > 0) ? params[i] : def; };
+    const bool privateMode = intermediates.startsWith('?');
+
+    // Answers are sent even while the output is hidden
+    if (final == 'c' && (intermediates.isEmpty() || intermediates == ">")) {
+        if (intermediates.isEmpty()) emit response("\x1b[?62;22c");   // VT220 with ANSI color
+        else emit response("\x1b[>1;10;0c");
+        return;
+    }
+    if (final == 'n' && intermediates.isEmpty()) {
+        if (param(0, 0) == 5) {
+            emit response("\x1b[0n");
+        } else if (param(0, 0) == 6) {
+            const int row = originMode ? cursorRow - scrollTop : cursorRow;
+            emit response(QByteArray("\x1b[") + QByteArray::number(row + 1) + ';'
+                          + QByteArray::number(cursorCol + 1) + 'R');
+        }
+        return;
+    }
+    if (outputSuppressed) return;
+
+    if (final == 'h' || final == 'l') {
+        if (intermediates.isEmpty() || privateMode) setMode(params, count, privateMode, final == 'h');
+        return;
+    }
+    if (final == 'p' && intermediates == "!") { // DECSTR soft reset
+        attributes = CellAttributes();
+        insertMode = originMode = appCursorKeys = false;
+        autoWrap = cursorVisible = true;
+        scrollTop = 0;
+        scrollBottom = screenRows - 1;
+        return;
+    }
+    // Remaining sequences with intermediates (cursor style, key modifiers, ...) are ignored
+    if (!intermediates.isEmpty() && !(privateMode && (final == 'J' || final == 'K'))) return;
+
+    switch (final) {
+    case '@': insertCells(param(0, 1)); break;
+    case 'A': {
+        const int top = cursorRow >= scrollTop ? scrollTop : 0;
+        cursorRow = qMax(top, cursorRow - param(0, 1));
+        pendingWrap = false;
+        break;
+    }
+    case 'B':
+    case 'e': {
+        const int bottom = cursorRow <= scrollBottom ? scrollBottom : screenRows - 1;
+        cursorRow = qMin(bottom, cursorRow + param(0, 1));
+        pendingWrap = false;
+        break;
+    }
+    case 'C':
+    case 'a':
+        cursorCol = qMin(cols - 1, cursorCol + param(0, 1));
+        pendingWrap = false;
+        break;
+    case 'D':
+        cursorCol = qMax(0, cursorCol - param(0, 1));
+        pendingWrap = false;
+        break;
+    case 'E':
+        cursorRow = qMin(screenRows - 1, cursorRow + param(0, 1));
+        carriageReturn();
+        break;
+    case 'F':
+        cursorRow = qMax(0, cursorRow - param(0, 1));
+        carriageReturn();
+        break;
+    case 'G':
+    case '`':
+        cursorCol = qBound(0, param(0, 1) - 1, cols - 1);
+        pendingWrap = false;
+        break;
+    case 'H':
+    case 'f':
+        setCursor(param(1, 1) - 1, param(0, 1) - 1);
+        break;
+    case 'I':
+        for (int i = param(0, 1); i > 0; --i) execute('\t');
+        break;
+    case 'J': eraseDisplay(count > 0 ? params[0] : 0); break;
+    case 'K': eraseLine(count > 0 ? params[0] : 0); break;
+    case 'L':
+        if (cursorRow >= scrollTop && cursorRow <= scrollBottom) {
+            scrollDown(cursorRow, scrollBottom, param(0, 1));
+            carriageReturn();
+        }
+        break;
+    case 'M':
+        if (cursorRow >= scrollTop && cursorRow <= scrollBottom) {
+            scrollUp(cursorRow, scrollBottom, param(0, 1));
+            carriageReturn();
+        }
+        break;
+    case 'P': deleteCells(param(0, 1)); break;
+    case 'S': scrollUp(scrollTop, scrollBottom, param(0, 1)); break;
+    case 'T': scrollDown(scrollTop, scrollBottom, param(0, 1)); break;
+    case 'X': eraseCells(cursorRow, cursorCol, cursorCol + param(0, 1)); break;
+    case 'Z':
+        for (int i = param(0, 1); i > 0 && cursorCol > 0; --i) {
+            cursorCol = ((cursorCol - 1) / TabWidth) * TabWidth;
+        }
+        pendingWrap = false;
+        break;
+    case 'b':
+        for (int i = qMin(param(0, 1), cols * screenRows); i > 0; --i) putChar(lastChar);
+        break;
+    case 'd':
+        setCursor(cursorCol, param(0, 1) - 1);
+        break;
+    case 'm': selectGraphicRendition(params, count); break;
+    case 'r': {
+        const int top = param(0, 1) - 1;
+        const int bottom = qMin(param(1, screenRows), screenRows) - 1;
+        if (top < bottom) {
+            scrollTop = top;
+            scrollBottom = bottom;
+            setCursor(0, 0);
+        }
+        break;
+    }
+    case 's': saveCursorState(); break;
+    case 'u': restoreCursorState(); break;
+    default:
+        break; // tab stops, window operations, ...
+    }
+}
+
+void TerminalScreen::selectGraphicRendition(const int *params, int count)
+{
+    if (count == 0) {
+        attributes = CellAttributes();
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        const int p = params[i];
+        switch (p) {
+        case 0: attributes = CellAttributes(); break;
+        case 1: attributes.flags |= CellAttributes::Bold; break;
+        case 2: attributes.flags |= CellAttributes::Faint; break;
+        case 3: attributes.flags |= CellAttributes::Italic; break;
+        case 4: attributes.flags |= CellAttributes::Underline; break;
+        case 5:
+        case 6: attributes.flags |= CellAttributes::Blink; break;
+        case 7: attributes.flags |= CellAttributes::Inverse; break;
+        case 8: attributes.flags |= CellAttributes::Hidden; break;
+        case 9: attributes.flags |= CellAttributes::Strike; break;
+        case 21:
+        case 22: attributes.flags &= ~(CellAttributes::Bold | CellAttributes::Faint); break;
+        case 23: attributes.flags &= ~CellAttributes::Italic; break;
+        case 24: attributes.flags &= ~CellAttributes::Underline; break;
+        case 25: attributes.flags &= ~CellAttributes::Blink; break;
+        case 27: attributes.flags &= ~CellAttributes::Inverse; break;
+        case 28: attributes.flags &= ~CellAttributes::Hidden; break;
+        case 29: attributes.flags &= ~CellAttributes::Strike; break;
+        case 39: attributes.foreground = TerminalColor::Default; break;
+        case 49: attributes.background = TerminalColor::Default; break;
+        case 38:
+        case 48: {
+            // 38;5;n (palette) or 38;2;r;g;b (true color)
+            quint32 color = TerminalColor::Default;
+            if (i + 2 < count && params[i + 1] == 5) {
+                color = TerminalColor::indexed(params[i + 2]);
+                i += 2;
+            } else if (i + 4 < count && params[i + 1] == 2) {
+                color = TerminalColor::rgb(params[i + 2], params[i + 3], params[i + 4]);
+                i += 4;
+            } else {
+                i = count; // malformed: ignore the rest
+                break;
+            }
+            if (p == 38) attributes.foreground = color;
+            else attributes.background = color;
+            break;
+        }
+        default:
+            if (p >= 30 && p <= 37) attributes.foreground = TerminalColor::indexed(p - 30);
+            else if (p >= 40 && p <= 47) attributes.background = TerminalColor::indexed(p - 40);
+            else if (p >= 90 && p <= 97) attributes.foreground = TerminalColor::indexed(p - 90 + 8);
+            else if (p >= 100 && p <= 107) attributes.background = TerminalColor::indexed(p - 100 + 8);
+            break;
+        }
+    }
+}
+
+void TerminalScreen::setMode(const int *params, int count, bool privateMode, bool enable)
+{
+    for (int i = 0; i < count; ++i) {
+        const int mode = params[i];
+        if (!privateMode) {
+            if (mode == 4) insertMode = enable;
+            continue;
+        }
+        switch (mode) {
+        case 1: appCursorKeys = enable; break;
+        case 6:
+            originMode = enable;
+            setCursor(0, 0);
+            break;
+        case 7: autoWrap = enable; break;
+        case 25:
+            cursorVisible = enable;
+            markDirty(cursorRow);
+            break;
+        case 47:
+        case 1047: setAlternateScreen(enable, false); break;
+        case 1049: setAlternateScreen(enable, true); break;
+        case 2004: bracketedPasteMode = enable; break;
+        default: break; // mouse reporting, focus events, ...
+        }
+    }
+}
+
+void TerminalScreen::setAlternateScreen(bool enable, bool saveCursor)
+{
+    if (enable == alternateActive) return;
+    if (enable) {
+        if (saveCursor) {
+            saveCursorState();
+            savedMainCursor = savedCursor;
+        }
+        savedMainLines = screenLines;
+        alternateActive = true;
+        screenLines.fill(blankLine(), screenRows);
+    } else {
+        screenLines = savedMainLines;
+        savedMainLines.clear();
+        alternateActive = false;
+        if (saveCursor) {
+            savedCursor = savedMainCursor;
+            restoreCursorState();
+        }
+    }
+    markAllDirty();
+    emit alternateScreenChanged(enable);
+}
+
+void TerminalScreen::escDispatch(const QByteArray &intermediates, char16_t final)
+{
+    if (outputSuppressed) return;
+
+    if (intermediates == "(") {
+        lineDrawing = (final == '0');
+        return;
+    }
+    if (!intermediates.isEmpty()) return; // other charsets, DECALN, ...
+
+    switch (final) {
+    case '7': saveCursorState(); break;
+    case '8': restoreCursorState(); break;
+    case 'D': lineFeed(); break;
+    case 'E':
+        carriageReturn();
+        lineFeed();
+        break;
+    case 'M': reverseIndex(); break;
+    case 'c': fullReset(); break;
+    default: break; // keypad modes, tab set, ...
+    }
+}
+
+void TerminalScreen::oscDispatch(const QString &data)
+{
+    const int sep = data.indexOf(QLatin1Char(';'));
+    bool ok = false;
+    const int code = (sep < 0 ? data : data.left(sep)).toInt(&ok);
+    if (!ok) return;
+    const QString payload = sep < 0 ? QString() : data.mid(sep + 1);
+    if (code == 0 || code == 2) emit titleChanged(payload);
+    emit oscReceived(code, payload);
+}
+
+// ---------------------------------------------------------------------------
+// Resize
+// ---------------------------------------------------------------------------
+
+void TerminalScreen::resizeLines(QVector<TerminalLine> &lines, int newColumns, int newRows, bool keepCursor)
+{
+    for (TerminalLine &line : lines) {
+        line.cells.resize(newColumns);
+        if (newColumns > 0 && line.cells.last().width == TerminalCell::WideHead) {
+            line.cells.last() = TerminalCell();
+        }
+    }
+
+    int excess = static_cast<int>(lines.size()) - newRows;
+    if (excess > 0) {
+        // First drop the lines below the cursor, then scroll the top ones out
+        int below = keepCursor ? qMin(excess, static_cast<int>(lines.size()) - 1 - cursorRow) : excess;
+        below = qMax(0, below);
+        lines.resize(lines.size() - below);
+        excess -= below;
+        for (int i = 0; i < excess; ++i) {
+            if (keepCursor && !alternateActive) pushHistory(lines.first());
+            lines.removeFirst();
+        }
+        if (keepCursor) cursorRow = qMax(0, cursorRow - excess);
+    }
+    while (lines.size() < newRows) {
+        TerminalLine line;
+        line.cells.resize(newColumns);
+        lines.append(line);
+    }
+}
+
+void TerminalScreen::resize(int columns, int rows)
+{
+    columns = qMax(1, columns);
+    rows = qMax(1, rows);
+    if (columns == cols && rows == screenRows) return;
+
+    resizeLines(screenLines, columns, rows, true);
+    if (alternateActive) resizeLines(savedMainLines, columns, rows, false);
+
+    cols = columns;
+    screenRows = rows;
+    scrollTop = 0;
+    scrollBottom = screenRows - 1;
+    cursorCol = qBound(0, cursorCol, cols - 1);
+    cursorRow = qBound(0, cursorRow, screenRows - 1);
+    pendingWrap = false;
+    dirtyRows.fill(false, screenRows);
+    markAllDirty();
+}
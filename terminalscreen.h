@@ -0,0 +1,127 @@
+#ifndef TERMINALSCREEN_H
+#define TERMINALSCREEN_H
+
+#include <QObject>
+#include <QVector>
+#include <QColor>
+#include "terminalcell.h"
+#include "scrollback.h"
+#include "vtparser.h"
+
+// The cell grid of a terminal: screen, alternate screen, scrollback, cursor,
+// modes. Fed by a VtParser (feed()) or with plain local text (appendText()).
+class TerminalScreen : public QObject, private VtHandler
+{
+    Q_OBJECT
+public:
+    explicit TerminalScreen(int columns = 80, int rows = 24, QObject *parent = nullptr);
+
+    void feed(QStringView text);
+    // Text written by the widget itself (prompt, messages): no escape parsing, '\n' is CR LF
+    void appendText(const QString &text, const QColor &color);
+
+    void resize(int columns, int rows);
+    void clearAll();
+
+    int columns() const { return cols; }
+    int rows() const { return screenRows; }
+    int cursorX() const { return cursorCol; }
+    int cursorY() const { return cursorRow; }
+    bool isCursorVisible() const { return cursorVisible; }
+    bool isAlternateScreen() const { return alternateActive; }
+    bool applicationCursorKeys() const { return appCursorKeys; }
+    bool bracketedPaste() const { return bracketedPasteMode; }
+
+    // Lines are addressed from the oldest scrollback line: [0, historySize()) is
+    // the scrollback, [historySize(), historySize() + rows()) the screen.
+    int historySize() const;
+    TerminalLine lineAt(int index) const;
+    // Maximum number of scrollback lines (older ones are dropped)
+    void setHistoryLimit(int lines);
+
+    // Dirty tracking for the view: rows of the screen changed since the last clearDirty()
+    bool isRowDirty(int row) const { return allDirty || dirtyRows.at(row); }
+    bool isAllDirty() const { return allDirty; }
+    void clearDirty();
+
+    // While suppressed, printing and screen changes are dropped; OSC strings still dispatch
+    void setOutputSuppressed(bool suppressed) { outputSuppressed = suppressed; }
+
+signals:
+    void oscReceived(int code, const QString &data);
+    void titleChanged(const QString &title);
+    // Answer to send back to the application (device status, attributes, ...)
+    void response(const QByteArray &data);
+    void bell();
+    void alternateScreenChanged(bool active);
+
+private:
+    VtParser parser;
+    int cols;
+    int screenRows;
+    QVector<TerminalLine> screenLines;
+    QVector<TerminalLine> savedMainLines;   // main screen while the alternate one is shown
+    Scrollback history;
+
+    int cursorCol;
+    int cursorRow;
+    bool pendingWrap;
+    CellAttributes attributes;
+    int scrollTop;
+    int scrollBottom;
+
+    struct SavedCursor {
+        int col = 0;
+        int row = 0;
+        CellAttributes attributes;
+        bool lineDrawing = false;
+    } savedCursor, savedMainCursor;
+
+    bool autoWrap;
+    bool insertMode;
+    bool originMode;
+    bool cursorVisible;
+    bool appCursorKeys;
+    bool bracketedPasteMode;
+    bool alternateActive;
+    bool lineDrawing;       // DEC special graphics in G0
+    bool outputSuppressed;
+    char32_t lastChar;      // for REP
+
+    QVector<bool> dirtyRows;
+    bool allDirty;
+
+    // VtHandler
+    void print(const QChar *text, int length) override;
+    void execute(char16_t control) override;
+    void csiDispatch(const int *params, int count, const QByteArray &intermediates, char16_t final) override;
+    void escDispatch(const QByteArray &intermediates, char16_t final) override;
+    void oscDispatch(const QString &data) override;
+
+    void putChar(char32_t ch);
+    void lineFeed();
+    void reverseIndex();
+    void carriageReturn();
+    void scrollUp(int top, int bottom, int count, bool toHistory = false);
+    void scrollDown(int top, int bottom, int count);
+    void eraseCells(int row, int from, int to);
+    void eraseDisplay(int mode);
+    void eraseLine(int mode);
+    void insertCells(int count);
+    void deleteCells(int count);
+    void setCursor(int col, int row);
+    void selectGraphicRendition(const int *params, int count);
+    void setMode(const int *params, int count, bool privateMode, bool enable);
+    void setAlternateScreen(bool enable, bool saveCursor);
+    void saveCursorState();
+    void restoreCursorState();
+    void fullReset();
+    TerminalCell blankCell() const;
+    TerminalLine blankLine() const;
+    void resizeLines(QVector<TerminalLine> &lines, int newColumns, int newRows, bool keepCursor);
+    void markDirty(int row);
+    void markAllDirty();
+    void pushHistory(const TerminalLine &line);
+};
+
+#endif // TERMINALSCREEN_H
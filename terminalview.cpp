@@ -0,0 +1,499 @@
+#include "terminalview.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QApplication>
+#include <QClipboard>
+#include <QFontMetrics>
+
+TerminalView::TerminalView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , cellWidth(1)
+    , cellHeight(1)
+    , ascent(0)
+    , defaultForeground(204, 204, 204)
+    , defaultBackground(30, 30, 30)
+    , paintedTop(-1)
+    , selecting(false)
+    , hasSelection(false)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setFrameShape(QFrame::NoFrame);
+    viewport()->setCursor(Qt::IBeamCursor);
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+
+    // Same colors as the rest of the UI for the 16 base colors, xterm for the rest
+    static const QRgb baseColors[16] = {
+        qRgb(30, 30, 30),    qRgb(224, 108, 117), qRgb(152, 195, 121), qRgb(229, 192, 123),
+        qRgb(97, 175, 239),  qRgb(198, 120, 221), qRgb(86, 182, 194),  qRgb(204, 204, 204),
+        qRgb(92, 99, 112),   qRgb(240, 135, 143), qRgb(175, 215, 145), qRgb(240, 210, 150),
+        qRgb(130, 195, 250), qRgb(215, 150, 235), qRgb(115, 205, 215), qRgb(255, 255, 255)
+    };
+    for (int i = 0; i < 16; ++i) colorTable[i] = QColor(baseColors[i]);
+    static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+    for (int i = 0; i < 216; ++i) {
+        colorTable[16 + i] = QColor(levels[i / 36], levels[(i / 6) % 6], levels[i % 6]);
+    }
+    for (int i = 0; i < 24; ++i) {
+        const int gray = 8 + i * 10;
+        colorTable[232 + i] = QColor(gray, gray, gray);
+    }
+
+    QFont base;
+    base.setFamilies({ "Consolas", "Monaco", "Courier New" });
+    base.setStyleHint(QFont::Monospace);
+    base.setFixedPitch(true);
+    base.setPixelSize(12);
+    for (int i = 0; i < 4; ++i) {
+        fonts[i] = base;
+        fonts[i].setBold(i & 1);
+        fonts[i].setItalic(i & 2);
+    }
+    updateMetrics();
+}
+
+void TerminalView::setScreen(TerminalScreen *screen)
+{
+    terminalScreen = screen;
+    paintedTop = -1;
+    hasSelection = false;
+    updateScreenSize();
+    updateScrollBar();
+    viewport()->update();
+}
+
+void TerminalView::updateMetrics()
+{
+    QFontMetrics fm(fonts[0]);
+    cellWidth = qMax(1, fm.horizontalAdvance(QLatin1Char('M')));
+    cellHeight = qMax(1, fm.height());
+    ascent = fm.ascent();
+    paintedTop = -1;
+}
+
+int TerminalView::visibleRows() const
+{
+    return (viewport()->height() + cellHeight - 1) / cellHeight;
+}
+
+void TerminalView::updateScreenSize()
+{
+    if (!terminalScreen) return;
+    const int columns = qMax(2, viewport()->width() / cellWidth);
+    const int rows = qMax(1, viewport()->height() / cellHeight);
+    if (columns == terminalScreen->columns() && rows == terminalScreen->rows()) return;
+    terminalScreen->resize(columns, rows);
+    emit sizeChanged(columns, rows);
+}
+
+void TerminalView::updateScrollBar()
+{
+    QScrollBar *bar = verticalScrollBar();
+    const int history = terminalScreen ? terminalScreen->historySize() : 0;
+    const bool follow = bar->value() == bar->maximum();
+    bar->setPageStep(terminalScreen ? terminalScreen->rows() : 1);
+    bar->setSingleStep(1);
+    bar->setRange(0, history);
+    if (follow) bar->setValue(history);
+}
+
+void TerminalView::screenUpdated()
+{
+    updateScrollBar();
+    viewport()->update();
+}
+
+void TerminalView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScreenSize();
+    updateScrollBar();
+    paintedTop = -1;
+}
+
+void TerminalView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+bool TerminalView::focusNextPrevChild(bool next)
+{
+    Q_UNUSED(next);
+    return false; // Tab belongs to the application
+}
+
+void TerminalView::focusInEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusInEvent(event);
+    viewport()->update();
+}
+
+void TerminalView::focusOutEvent(QFocusEvent *event)
+{
+    QAbstractScrollArea::focusOutEvent(event);
+    viewport()->update();
+}
+
+// ---------------------------------------------------------------------------
+// Painting
+// ---------------------------------------------------------------------------
+
+QColor TerminalView::resolveColor(quint32 color, bool foreground) const
+{
+    switch (color & 0xff000000) {
+    case TerminalColor::Indexed:
+        return colorTable[color & 0xff];
+    case TerminalColor::Rgb:
+        return QColor((color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff);
+    default:
+        return foreground ? defaultForeground : defaultBackground;
+    }
+}
+
+void TerminalView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(viewport());
+    if (!terminalScreen) {
+        painter.fillRect(viewport()->rect(), defaultBackground);
+        return;
+    }
+
+    const qreal dpr = devicePixelRatioF();
+    const QSize pixelSize = viewport()->size() * dpr;
+    if (backing.size() != pixelSize) {
+        backing = QPixmap(pixelSize);
+        backing.setDevicePixelRatio(dpr);
+        paintedTop = -1;
+    }
+
+    const int history = terminalScreen->historySize();
+    const int top = verticalScrollBar()->value();
+    const int totalLines = history + terminalScreen->rows();
+    // Only the live screen has per-row dirty flags; a scrolled view is repainted whole
+    const bool full = paintedTop != top || top != history || terminalScreen->isAllDirty();
+
+    {
+        QPainter rows(&backing);
+        const int count = visibleRows();
+        for (int r = 0; r < count; ++r) {
+            const int index = top + r;
+            const int y = r * cellHeight;
+            if (index >= totalLines) {
+                if (full) rows.fillRect(0, y, viewport()->width(), cellHeight, defaultBackground);
+                continue;
+            }
+            if (!full && !terminalScreen->isRowDirty(index - history)) continue;
+            paintLine(rows, terminalScreen->lineAt(index), y);
+        }
+    }
+    terminalScreen->clearDirty();
+    paintedTop = top;
+
+    painter.drawPixmap(0, 0, backing);
+    paintOverlay(painter);
+}
+
+void TerminalView::paintLine(QPainter &painter, const TerminalLine &line, int y)
+{
+    painter.fillRect(0, y, viewport()->width(), cellHeight, defaultBackground);
+
+    const int n = line.cells.size();
+    int col = 0;
+    while (col < n) {
+        const TerminalCell &first = line.cells.at(col);
+        int end = col + 1;
+        if (first.width == TerminalCell::WideHead) {
+            // Double-width characters are drawn one by one to stay on the grid
+            end = qMin(n, col + 2);
+        } else {
+            while (end < n && line.cells.at(end).width == TerminalCell::Single
+                   && line.cells.at(end).attributes == first.attributes) {
+                ++end;
+            }
+        }
+        paintRun(painter, line, col, end, y);
+        col = end;
+    }
+}
+
+void TerminalView::paintRun(QPainter &painter, const TerminalLine &line, int from, int to, int y)
+{
+    const CellAttributes &attr = line.cells.at(from).attributes;
+    quint32 fgColor = attr.foreground;
+    if ((attr.flags & CellAttributes::Bold) && (fgColor & 0xff000000) == TerminalColor::Indexed
+        && (fgColor & 0xff) < 8) {
+        fgColor += 8; // bold shows as the bright color
+    }
+    QColor fg = resolveColor(fgColor, true);
+    QColor bg = resolveColor(attr.background, false);
+    if (attr.flags & CellAttributes::Inverse) std::swap(fg, bg);
+    if (attr.flags & CellAttributes::Hidden) fg = bg;
+    if (attr.flags & CellAttributes::Faint) fg.setAlpha(150);
+
+    const int x = from * cellWidth;
+    const int width = (to - from) * cellWidth;
+    if (bg != defaultBackground) painter.fillRect(x, y, width, cellHeight, bg);
+
+    QString text;
+    text.reserve(to - from);
+    bool blank = true;
+    for (int i = from; i < to; ++i) {
+        const TerminalCell &cell = line.cells.at(i);
+        if (cell.width == TerminalCell::WideTail) continue;
+        if (cell.ch != U' ') blank = false;
+        if (QChar::requiresSurrogates(cell.ch)) {
+            text += QChar(QChar::highSurrogate(cell.ch));
+            text += QChar(QChar::lowSurrogate(cell.ch));
+        } else {
+            text += QChar(static_cast<char16_t>(cell.ch));
+        }
+    }
+
+    painter.setPen(fg);
+    if (!blank) {
+        const int fontIndex = ((attr.flags & CellAttributes::Bold) ? 1 : 0)
+                            | ((attr.flags & CellAttributes::Italic) ? 2 : 0);
+        painter.setFont(fonts[fontIndex]);
+        painter.drawText(QPoint(x, y + ascent), text);
+    }
+    if (attr.flags & CellAttributes::Underline) {
+        painter.drawLine(x, y + ascent + 1, x + width - 1, y + ascent + 1);
+    }
+    if (attr.flags & CellAttributes::Strike) {
+        painter.drawLine(x, y + cellHeight / 2, x + width - 1, y + cellHeight / 2);
+    }
+}
+
+void TerminalView::paintOverlay(QPainter &painter)
+{
+    const int top = verticalScrollBar()->value();
+    const int count = visibleRows();
+
+    if (hasSelection) {
+        QPoint start = selectionAnchor;
+        QPoint end = selectionEnd;
+        if (end.y() < start.y() || (end.y() == start.y() && end.x() < start.x())) std::swap(start, end);
+        const QColor selectionColor(38, 79, 120, 150);
+        for (int line = qMax(start.y(), top); line <= end.y() && line < top + count; ++line) {
+            const int c0 = line == start.y() ? start.x() : 0;
+            const int c1 = line == end.y() ? end.x() : terminalScreen->columns();
+            if (c1 <= c0) continue;
+            painter.fillRect((c0) * cellWidth, (line - top) * cellHeight,
+                             (c1 - c0) * cellWidth, cellHeight, selectionColor);
+        }
+    }
+
+    if (terminalScreen->isCursorVisible()) {
+        const int row = terminalScreen->historySize() + terminalScreen->cursorY() - top;
+        if (row >= 0 && row < count) {
+            QRect cursorRect(terminalScreen->cursorX() * cellWidth, row * cellHeight, cellWidth, cellHeight);
+            if (hasFocus()) {
+                painter.fillRect(cursorRect, QColor(204, 204, 204, 150));
+            } else {
+                painter.setPen(QColor(204, 204, 204));
+                painter.drawRect(cursorRect.adjusted(0, 0, -1, -1));
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Selection and clipboard
+// ---------------------------------------------------------------------------
+
+QPoint TerminalView::cellAt(const QPoint &pos) const
+{
+    const int columns = terminalScreen ? terminalScreen->columns() : 0;
+    const int lines = terminalScreen ? terminalScreen->historySize() + terminalScreen->rows() : 0;
+    // Column boundaries: a click on the right half of a cell selects it
+    const int col = qBound(0, (pos.x() + cellWidth / 2) / cellWidth, columns);
+    const int line = qBound(0, verticalScrollBar()->value() + pos.y() / cellHeight, qMax(0, lines - 1));
+    return QPoint(col, line);
+}
+
+void TerminalView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !terminalScreen) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+    setFocus();
+    selectionAnchor = selectionEnd = cellAt(event->position().toPoint());
+    selecting = true;
+    if (hasSelection) {
+        hasSelection = false;
+        viewport()->update();
+    }
+}
+
+void TerminalView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!selecting) return;
+    selectionEnd = cellAt(event->position().toPoint());
+    hasSelection = selectionEnd != selectionAnchor;
+    viewport()->update();
+}
+
+void TerminalView::mouseReleaseEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    selecting = false;
+    QClipboard *clipboard = QApplication::clipboard();
+    if (hasSelection && clipboard->supportsSelection()) {
+        clipboard->setText(selectedText(), QClipboard::Selection);
+    }
+}
+
+QString TerminalView::selectedText() const
+{
+    if (!hasSelection || !terminalScreen) return QString();
+
+    QPoint start = selectionAnchor;
+    QPoint end = selectionEnd;
+    if (end.y() < start.y() || (end.y() == start.y() && end.x() < start.x())) std::swap(start, end);
+
+    const int lines = terminalScreen->historySize() + terminalScreen->rows();
+    QString out;
+    for (int index = start.y(); index <= end.y() && index < lines; ++index) {
+        const TerminalLine &line = terminalScreen->lineAt(index);
+        const int c0 = index == start.y() ? start.x() : 0;
+        const int c1 = qMin<int>(index == end.y() ? end.x() : line.cells.size(), line.cells.size());
+        QString part;
+        for (int c = c0; c < c1; ++c) {
+            const TerminalCell &cell = line.cells.at(c);
+            if (cell.width == TerminalCell::WideTail) continue;
+            if (QChar::requiresSurrogates(cell.ch)) {
+                part += QChar(QChar::highSurrogate(cell.ch));
+                part += QChar(QChar::lowSurrogate(cell.ch));
+            } else {
+                part += QChar(static_cast<char16_t>(cell.ch));
+            }
+        }
+        // Soft-wrapped lines are copied as one line
+        const bool continued = line.wrapped && c1 == line.cells.size();
+        if (!continued) {
+            while (part.endsWith(QLatin1Char(' '))) part.chop(1);
+        }
+        out += part;
+        if (index != end.y() && !continued) out += QLatin1Char('\n');
+    }
+    return out;
+}
+
+void TerminalView::copySelection()
+{
+    if (hasSelection) QApplication::clipboard()->setText(selectedText());
+}
+
+void TerminalView::paste()
+{
+    QString text = QApplication::clipboard()->text();
+    if (text.isEmpty()) return;
+    text.replace(QLatin1String("\r\n"), QLatin1String("\r"));
+    text.replace(QLatin1Char('\n'), QLatin1Char('\r'));
+    QByteArray data = text.toUtf8();
+    if (terminalScreen && terminalScreen->bracketedPaste()) {
+        data = "\x1b[200~" + data + "\x1b[201~";
+    }
+    emit keyInput(data);
+}
+
+// ---------------------------------------------------------------------------
+// Keyboard
+// ---------------------------------------------------------------------------
+
+void TerminalView::keyPressEvent(QKeyEvent *event)
+{
+    const Qt::KeyboardModifiers mods = event->modifiers();
+
+    // Local scrollback
+    if (mods == Qt::ShiftModifier && (event->key() == Qt::Key_PageUp || event->key() == Qt::Key_PageDown)) {
+        QScrollBar *bar = verticalScrollBar();
+        bar->setValue(bar->value() + (event->key() == Qt::Key_PageUp ? -bar->pageStep() : bar->pageStep()));
+        return;
+    }
+    if (mods == (Qt::ControlModifier | Qt::ShiftModifier)) {
+        if (event->key() == Qt::Key_C) {
+            copySelection();
+            return;
+        }
+        if (event->key() == Qt::Key_V) {
+            paste();
+            return;
+        }
+    }
+
+    const QByteArray data = keySequence(event);
+    if (data.isEmpty()) {
+        QAbstractScrollArea::keyPressEvent(event);
+        return;
+    }
+    // Typing brings the view back to the live screen
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    emit keyInput(data);
+}
+
+QByteArray TerminalView::keySequence(QKeyEvent *event) const
+{
+    const bool appKeys = terminalScreen && terminalScreen->applicationCursorKeys();
+    auto cursorKey = [appKeys](char final) {
+        return QByteArray(appKeys ? "\x1bO" : "\x1b[") + final;
+    };
+
+    switch (event->key()) {
+    case Qt::Key_Up: return cursorKey('A');
+    case Qt::Key_Down: return cursorKey('B');
+    case Qt::Key_Right: return cursorKey('C');
+    case Qt::Key_Left: return cursorKey('D');
+    case Qt::Key_Home: return cursorKey('H');
+    case Qt::Key_End: return cursorKey('F');
+    case Qt::Key_Return:
+    case Qt::Key_Enter: return "\r";
+    case Qt::Key_Backspace: return "\x7f";
+    case Qt::Key_Tab: return "\t";
+    case Qt::Key_Backtab: return "\x1b[Z";
+    case Qt::Key_Escape: return "\x1b";
+    case Qt::Key_Insert: return "\x1b[2~";
+    case Qt::Key_Delete: return "\x1b[3~";
+    case Qt::Key_PageUp: return "\x1b[5~";
+    case Qt::Key_PageDown: return "\x1b[6~";
+    case Qt::Key_F1: return "\x1bOP";
+    case Qt::Key_F2: return "\x1bOQ";
+    case Qt::Key_F3: return "\x1bOR";
+    case Qt::Key_F4: return "\x1bOS";
+    case Qt::Key_F5: return "\x1b[15~";
+    case Qt::Key_F6: return "\x1b[17~";
+    case Qt::Key_F7: return "\x1b[18~";
+    case Qt::Key_F8: return "\x1b[19~";
+    case Qt::Key_F9: return "\x1b[20~";
+    case Qt::Key_F10: return "\x1b[21~";
+    case Qt::Key_F11: return "\x1b[23~";
+    case Qt::Key_F12: return "\x1b[24~";
+    default:
+        break;
+    }
+
+#ifdef Q_OS_MACOS
+    const Qt::KeyboardModifier controlKey = Qt::MetaModifier;
+#else
+    const Qt::KeyboardModifier controlKey = Qt::ControlModifier;
+#endif
+    if (event->modifiers() & controlKey) {
+        const int key = event->key();
+        if (key >= Qt::Key_A && key <= Qt::Key_Z) return QByteArray(1, char(key - Qt::Key_A + 1));
+        if (key == Qt::Key_Space || key == Qt::Key_At) return QByteArray(1, '\0');
+        if (key == Qt::Key_BracketLeft) return "\x1b";
+        if (key == Qt::Key_Backslash) return "\x1c";
+        if (key == Qt::Key_BracketRight) return "\x1d";
+    }
+
+    QByteArray text = event->text().toUtf8();
+    if (!text.isEmpty() && (event->modifiers() & Qt::AltModifier)) text.prepend('\x1b');
+    return text;
+}
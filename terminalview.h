@@ -0,0 +1,78 @@
+#ifndef TERMINALVIEW_H
+#define TERMINALVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QPointer>
+#include <QPixmap>
+#include <QColor>
+#include <QFont>
+#include "terminalscreen.h"
+
+// Paints a TerminalScreen cell by cell. The visible rows are kept in a
+// backing pixmap and only the rows marked dirty by the screen are repainted;
+// cursor and selection are drawn on top of it.
+class TerminalView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit TerminalView(QWidget *parent = nullptr);
+
+    void setScreen(TerminalScreen *screen);
+    TerminalScreen *screen() const { return terminalScreen; }
+
+    // To call after the screen was fed: schedules a repaint, follows the output
+    void screenUpdated();
+
+    QString selectedText() const;
+    void copySelection();
+    void paste();
+
+signals:
+    // Bytes to send to the application for a key press or a paste
+    void keyInput(const QByteArray &data);
+    void sizeChanged(int columns, int rows);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    bool focusNextPrevChild(bool next) override;
+
+private:
+    QPointer<TerminalScreen> terminalScreen;
+    QFont fonts[4];             // regular, bold, italic, bold italic
+    int cellWidth;
+    int cellHeight;
+    int ascent;
+    QColor colorTable[256];
+    QColor defaultForeground;
+    QColor defaultBackground;
+
+    QPixmap backing;
+    int paintedTop;             // first line in the backing pixmap, -1 to repaint everything
+
+    // Selection, in (column, line index) with lines counted from the oldest scrollback line
+    QPoint selectionAnchor;
+    QPoint selectionEnd;
+    bool selecting;
+    bool hasSelection;
+
+    void updateMetrics();
+    void updateScrollBar();
+    void updateScreenSize();
+    int visibleRows() const;
+    QPoint cellAt(const QPoint &pos) const;
+    QColor resolveColor(quint32 color, bool foreground) const;
+    void paintLine(QPainter &painter, const TerminalLine &line, int y);
+    void paintRun(QPainter &painter, const TerminalLine &line, int from, int to, int y);
+    void paintOverlay(QPainter &painter);
+    QByteArray keySequence(QKeyEvent *event) const;
+};
+
+#endif // TERMINALVIEW_H
@@ -0,0 +1,197 @@
+#include "vtparser.h"
+
+// OSC strings longer than this are cut (titles, shell markers are tiny)
+static const int MaxOscLength = 4096;
+static const int MaxParamValue = 65535;
+
+static inline bool isPrintable(char16_t c)
+{
+    return c >= 0x20 && c != 0x7f && (c < 0x80 || c > 0x9f);
+}
+
+VtParser::VtParser(VtHandler *handler)
+    : handler(handler)
+{
+    reset();
+}
+
+void VtParser::reset()
+{
+    state = State::Ground;
+    stringEscape = false;
+    oscBuffer.clear();
+    clearSequence();
+}
+
+void VtParser::clearSequence()
+{
+    paramCount = 0;
+    currentParam = 0;
+    paramStarted = false;
+    intermediates.clear();
+}
+
+void VtParser::pushParam()
+{
+    if (paramCount < MaxParams) params[paramCount++] = currentParam;
+    currentParam = 0;
+    paramStarted = false;
+}
+
+void VtParser::dispatchCsi(char16_t final)
+{
+    if (paramStarted || paramCount > 0) pushParam();
+    handler->csiDispatch(params, paramCount, intermediates, final);
+    state = State::Ground;
+}
+
+void VtParser::feed(QStringView text)
+{
+    const QChar *data = text.data();
+    const qsizetype n = text.size();
+
+    for (qsizetype i = 0; i < n; ++i) {
+        const char16_t c = data[i].unicode();
+
+        // Controls that act in (almost) every state
+        if (c == 0x18 || c == 0x1a) { // CAN, SUB: abort the sequence
+            state = State::Ground;
+            continue;
+        }
+        if (c == 0x1b && state != State::OscString && state != State::StringIgnore) {
+            clearSequence();
+            state = State::Escape;
+            continue;
+        }
+
+        switch (state) {
+        case State::Ground: {
+            if (isPrintable(c)) {
+                // Hand the whole printable run over at once
+                qsizetype end = i + 1;
+                while (end < n && isPrintable(data[end].unicode())) ++end;
+                handler->print(data + i, static_cast<int>(end - i));
+                i = end - 1;
+            } else if (c < 0x20) {
+                handler->execute(c);
+            }
+            break;
+        }
+
+        case State::Escape:
+            if (c < 0x20) {
+                handler->execute(c);
+            } else if (c <= 0x2f) {
+                intermediates.append(static_cast<char>(c));
+                state = State::EscapeIntermediate;
+            } else if (c == '[') {
+                clearSequence();
+                state = State::CsiEntry;
+            } else if (c == ']') {
+                oscBuffer.clear();
+                stringEscape = false;
+                state = State::OscString;
+            } else if (c == 'P' || c == 'X' || c == '^' || c == '_') {
+                stringEscape = false;
+                state = State::StringIgnore;
+            } else if (c <= 0x7e) {
+                handler->escDispatch(intermediates, c);
+                state = State::Ground;
+            } else {
+                state = State::Ground;
+            }
+            break;
+
+        case State::EscapeIntermediate:
+            if (c < 0x20) {
+                handler->execute(c);
+            } else if (c <= 0x2f) {
+                intermediates.append(static_cast<char>(c));
+            } else if (c <= 0x7e) {
+                handler->escDispatch(intermediates, c);
+                state = State::Ground;
+            } else {
+                state = State::Ground;
+            }
+            break;
+
+        case State::CsiEntry:
+        case State::CsiParam:
+            if (c >= '0' && c <= '9') {
+                currentParam = qMin(currentParam * 10 + (c - '0'), MaxParamValue);
+                paramStarted = true;
+                state = State::CsiParam;
+            } else if (c == ';' || c == ':') {
+                pushParam();
+                state = State::CsiParam;
+            } else if (c >= 0x3c && c <= 0x3f) {
+                // Private marker: only valid right after CSI
+                if (state == State::CsiEntry) intermediates.append(static_cast<char>(c));
+                else state = State::CsiIgnore;
+            } else if (c >= 0x20 && c <= 0x2f) {
+                intermediates.append(static_cast<char>(c));
+                state = State::CsiIntermediate;
+            } else if (c >= 0x40 && c <= 0x7e) {
+                dispatchCsi(c);
+            } else if (c < 0x20) {
+                handler->execute(c);
+            } else {
+                state = State::CsiIgnore;
+            }
+            break;
+
+        case State::CsiIntermediate:
+            if (c >= 0x20 && c <= 0x2f) {
+                intermediates.append(static_cast<char>(c));
+            } else if (c >= 0x40 && c <= 0x7e) {
+                dispatchCsi(c);
+            } else if (c < 0x20) {
+                handler->execute(c);
+            } else {
+                state = State::CsiIgnore;
+            }
+            break;
+
+        case State::CsiIgnore:
+            if (c >= 0x40 && c <= 0x7e) state = State::Ground;
+            else if (c < 0x20) handler->execute(c);
+            break;
+
+        case State::OscString:
+            if (stringEscape) {
+                // ESC \ (ST) ends the string; anything else aborts it and starts a new sequence
+                stringEscape = false;
+                if (c == '\\') {
+                    handler->oscDispatch(oscBuffer);
+                    oscBuffer.clear();
+                    state = State::Ground;
+                } else {
+                    oscBuffer.clear();
+                    clearSequence();
+                    state = State::Escape;
+                    --i; // reprocess this character in the Escape state
+                }
+            } else if (c == 0x07) {
+                handler->oscDispatch(oscBuffer);
+                oscBuffer.clear();
+                state = State::Ground;
+            } else if (c == 0x1b) {
+                stringEscape = true;
+            } else if (c >= 0x20 && oscBuffer.size() < MaxOscLength) {
+                oscBuffer.append(QChar(c));
+            }
+            break;
+
+        case State::StringIgnore:
+            if (stringEscape) {
+                stringEscape = false;
+                if (c == '\\') state = State::Ground;
+            } else if (c == 0x1b) {
+                stringEscape = true;
+            } else if (c == 0x07) {
+                state = State::Ground;
+            }
+            break;
+        }
+    }
+}
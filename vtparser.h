@@ -0,0 +1,66 @@
+#ifndef VTPARSER_H
+#define VTPARSER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+
+// Receives the actions recognized by VtParser
+class VtHandler
+{
+public:
+    virtual ~VtHandler() = default;
+
+    // A run of printable characters (UTF-16, surrogate pairs are kept together)
+    virtual void print(const QChar *text, int length) = 0;
+    // C0 control character (BEL, BS, HT, LF, CR, ...)
+    virtual void execute(char16_t control) = 0;
+    // CSI sequence; `intermediates` holds the private marker (?, >, ...) and intermediate bytes.
+    // A missing parameter is 0.
+    virtual void csiDispatch(const int *params, int count, const QByteArray &intermediates, char16_t final) = 0;
+    virtual void escDispatch(const QByteArray &intermediates, char16_t final) = 0;
+    // OSC string, without the introducer and terminator ("0;title", "777;...")
+    virtual void oscDispatch(const QString &data) = 0;
+};
+
+// DEC/ANSI escape sequence state machine (after the model of the VT500 parser
+// by Paul Williams). Input may be split anywhere: the state is kept between feeds.
+class VtParser
+{
+public:
+    explicit VtParser(VtHandler *handler);
+
+    void feed(QStringView text);
+    void reset();
+
+    static const int MaxParams = 32;
+
+private:
+    enum class State {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        CsiEntry,
+        CsiParam,
+        CsiIntermediate,
+        CsiIgnore,
+        OscString,
+        StringIgnore
+    };
+
+    VtHandler *handler;
+    State state;
+    int params[MaxParams];
+    int paramCount;
+    int currentParam;
+    bool paramStarted;
+    QByteArray intermediates;
+    QString oscBuffer;
+    bool stringEscape; // ESC seen inside a string, waiting for '\' (ST)
+
+    void clearSequence();
+    void pushParam();
+    void dispatchCsi(char16_t final);
+};
+
+#endif // VTPARSER_H